@@ -2,6 +2,9 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "VL53L1XConfig.h"
+
+class VL53L1XWriteQueue;
 
 class VL53L1X
 {
@@ -1262,14 +1265,39 @@ class VL53L1X
     {
       uint16_t range_mm;
       RangeStatus range_status;
+#if VL53L1X_FEATURE_FLOAT_RATES
       float peak_signal_count_rate_MCPS;
       float ambient_count_rate_MCPS;
+#else
+      uint16_t peak_signal_count_rate_fixed; // MCPS in fixed point 9.7 format
+      uint16_t ambient_count_rate_fixed;     // MCPS in fixed point 9.7 format
+#endif
     };
 
     RangingData ranging_data;
 
     uint8_t last_status; // status of last I2C transmission
 
+#if VL53L1X_FEATURE_RESTORE
+    // Registers saved by saveConfig() and written back by restoreConfig(): the
+    // offset and DSS target registers (0x001E-0x0025) and the static/dynamic
+    // configuration block (0x002D-0x0085) that the ULD API writes in a single
+    // burst after boot. Together they hold everything init() and the setters
+    // below configure.
+    static const uint16_t ConfigOffsetsStart = 0x001E;
+    static const uint8_t ConfigOffsetsLength = 8;
+    static const uint16_t ConfigBlockStart = 0x002D;
+    static const uint8_t ConfigBlockLength = 89;
+
+    struct ConfigSnapshot
+    {
+      uint8_t offsets[ConfigOffsetsLength];
+      uint8_t config[ConfigBlockLength];
+      uint8_t address;
+      bool valid;
+    };
+#endif
+
     VL53L1X();
 
     void setBus(TwoWire * bus) { this->bus = bus; }
@@ -1278,6 +1306,9 @@ class VL53L1X
     void setAddress(uint8_t new_addr);
     uint8_t getAddress() { return address; }
 
+    // Returns 0 on success, 2 if the sensor didn't finish booting, the model
+    // ID read if the device isn't a VL53L1X, or the negated I2C status if
+    // nothing answered at the address
     int init(bool io_2v8 = true);
 
     void writeReg(uint16_t reg, uint8_t value);
@@ -1286,20 +1317,29 @@ class VL53L1X
     uint8_t readReg(regAddr reg);
     uint16_t readReg16Bit(uint16_t reg);
     uint32_t readReg32Bit(uint16_t reg);
+    void writeMulti(uint16_t reg, const uint8_t * src, uint8_t count);
+    void readMulti(uint16_t reg, uint8_t * dst, uint8_t count);
 
     bool setDistanceMode(DistanceMode mode);
-    DistanceMode getDistanceMode() { return distance_mode; }
+    DistanceMode getDistanceMode() { return (DistanceMode)distance_mode; }
 
     bool setMeasurementTimingBudget(uint32_t budget_us);
     uint32_t getMeasurementTimingBudget();
 
+    void setInterMeasurementPeriod(uint32_t period_ms);
+    uint32_t getInterMeasurementPeriod();
+
     void setROISize(uint8_t width, uint8_t height);
     void getROISize(uint8_t * width, uint8_t * height);
     void setROICenter(uint8_t spadNum);
     uint8_t getROICenter();
 
+    void setOffset(int16_t offset_mm);
+    int16_t getOffset();
+
     void startContinuous(uint32_t period_ms);
     void stopContinuous();
+    bool isContinuous() { return continuous_active; }
     uint16_t read(bool blocking = true);
     uint16_t readRangeContinuousMillimeters(bool blocking = true) { return read(blocking); } // alias of read()
     uint16_t readSingle(bool blocking = true);
@@ -1309,18 +1349,62 @@ class VL53L1X
     // assumes interrupt is active low (GPIO_HV_MUX__CTRL bit 4 is 1)
     bool dataReady() { return (readReg(GPIO__TIO_HV_STATUS) & 0x01) == 0; }
 
+    // stream count of the last reading; it changes with every new measurement,
+    // so a value that stops changing means the sensor has stopped ranging
+    uint8_t getStreamCount() { return stream_count; }
+
+    // stream count of the measurement after one with the given count: the
+    // count runs 0-255, then wraps to 128
+    static uint8_t nextStreamCount(uint8_t count) { return (count == 255) ? 128 : count + 1; }
+
+#if VL53L1X_FEATURE_STATUS_STRINGS
     static const char * rangeStatusToString(RangeStatus status);
+#endif
 
     void setTimeout(uint16_t timeout) { io_timeout = timeout; }
     uint16_t getTimeout() { return io_timeout; }
     bool timeoutOccurred();
 
+#if VL53L1X_FEATURE_RESTORE
+    // XSHUT control; the pin is only ever driven low or released (it is not
+    // level shifted on the Pololu carrier), matching main.cpp
+    static const uint8_t NoPin = 255;
+    void setXshutPin(uint8_t pin) { xshut_pin = pin; }
+    uint8_t getXshutPin() { return xshut_pin; }
+    bool powerOff();
+    // returns false, leaving the sensor in shutdown, while another sensor on
+    // the same bus is booting (powered up and not yet moved off the default
+    // address by restoreConfig() or setAddress()): every sensor boots at the
+    // default address, so this keeps two from answering there at once, even
+    // when different modules (VL53L1XSupervisor, VL53L1XPowerManager,
+    // VL53L1XRecovery) power sensors up
+    bool powerOn();
+
+    void setConfigCache(ConfigSnapshot * cache) { config_cache = cache; }
+    ConfigSnapshot * getConfigCache() { return config_cache; }
+    bool saveConfig();
+    bool restoreConfig(uint16_t timeout_ms);
+#endif
+
   private:
 
+    friend class VL53L1XWriteQueue;
+
+#if VL53L1X_FEATURE_RESTORE
+    // the sensor booting on each bus (see powerOn())
+    static const uint8_t MaxBootingBuses = 4;
+    static VL53L1X * booting[MaxBootingBuses];
+    void endBoot();
+#endif
+
     // The Arduino two-wire interface uses a 7-bit number for the address,
     // and sets the last bit correctly based on reads and writes
     static const uint8_t AddressDefault = 0b0101001;
 
+    // VL53L1_BOOT_COMPLETION_POLLING_TIMEOUT_MS in the API, used by init()
+    // when no I/O timeout is set
+    static const uint16_t BootTimeoutMs = 500;
+
     // value used in measurement timing budget calculations
     // assumes PresetMode is LOWPOWER_AUTONOMOUS
     //
@@ -1336,9 +1420,25 @@ class VL53L1X
     // calculations
     static const uint16_t TargetRate = 0x0A00;
 
+    // number of consecutive failed I2C transactions read() tolerates while
+    // waiting for data before giving up
+    static const uint8_t MaxBusErrors = 3;
+
+    // largest number of data bytes sent or received in one transaction by
+    // writeMulti() and readMulti() (Wire buffer minus the register address)
+#ifdef VL53L1X_I2C_BUFFER_LENGTH
+    static const uint8_t MaxBurstLength = VL53L1X_I2C_BUFFER_LENGTH - 2;
+#else
+    static const uint8_t MaxBurstLength = 30;
+#endif
+
     // for storing values read from RESULT__RANGE_STATUS (0x0089)
     // through RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0_LOW
     // (0x0099)
+    //
+    // Only needed while read() processes a measurement, so it lives on the
+    // stack there instead of in every instance; the one field needed between
+    // measurements (stream_count) is kept separately.
     struct ResultBuffer
     {
       uint8_t range_status;
@@ -1353,27 +1453,43 @@ class VL53L1X
       uint16_t peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
     };
 
-    // making this static would save RAM for multiple instances as long as there
-    // aren't multiple sensors being read at the same time (e.g. on separate
-    // I2C buses)
-    ResultBuffer results;
+    // Per-sensor state, ordered by size with the flags packed into one byte.
+    // The public last_status above leaves 3 bytes of padding before bus. On a
+    // 32-bit MCU an instance takes 44 bytes with the default features, 40
+    // without VL53L1X_FEATURE_FLOAT_RATES, and 4 bytes less again without
+    // VL53L1X_FEATURE_RESTORE, which matters for arrays of many sensors.
+    // tools/footprint.py reports the RAM per sensor of a build.
 
     TwoWire * bus;
 
-    uint8_t address;
+    // write queue collecting register writes, if one is active
+    VL53L1XWriteQueue * queue;
+
+#if VL53L1X_FEATURE_RESTORE
+    ConfigSnapshot * config_cache;
+#endif
 
     uint16_t io_timeout;
-    bool did_timeout;
     uint16_t timeout_start_ms;
 
     uint16_t fast_osc_frequency;
     uint16_t osc_calibrate_val;
 
-    bool calibrated;
+    uint8_t address;
+
+    uint8_t stream_count; // of the last measurement read
+
     uint8_t saved_vhv_init;
     uint8_t saved_vhv_timeout;
 
-    DistanceMode distance_mode;
+#if VL53L1X_FEATURE_RESTORE
+    uint8_t xshut_pin;
+#endif
+
+    bool did_timeout : 1;
+    bool calibrated : 1;
+    bool continuous_active : 1;
+    uint8_t distance_mode : 2; // a DistanceMode
 
     // Record the current time to check an upcoming timeout against
     void startTimeout() { timeout_start_ms = millis(); }
@@ -1382,9 +1498,9 @@ class VL53L1X
     bool checkTimeoutExpired() {return (io_timeout > 0) && ((uint16_t)(millis() - timeout_start_ms) > io_timeout); }
 
     void setupManualCalibration();
-    void readResults();
-    void updateDSS();
-    void getRangingData();
+    void readResults(ResultBuffer & results);
+    void updateDSS(const ResultBuffer & results);
+    void getRangingData(const ResultBuffer & results);
 
     static uint32_t decodeTimeout(uint16_t reg_val);
     static uint16_t encodeTimeout(uint32_t timeout_mclks);
@@ -1392,6 +1508,8 @@ class VL53L1X
     static uint32_t timeoutMicrosecondsToMclks(uint32_t timeout_us, uint32_t macro_period_us);
     uint32_t calcMacroPeriod(uint8_t vcsel_period);
 
+#if VL53L1X_FEATURE_FLOAT_RATES
     // Convert count rate from fixed point 9.7 format to float
     float countRateFixedToFloat(uint16_t count_rate_fixed) { return (float)count_rate_fixed / (1 << 7); }
+#endif
 };
\ No newline at end of file
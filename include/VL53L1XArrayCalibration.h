@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_ARRAY_CALIBRATION
+
+// Relative offset and scale calibration for an array of sensors.
+//
+// Factory calibration makes each sensor accurate on its own, but mounting
+// adds offsets (cover glass, sensors set back or forward in the enclosure)
+// that differ from sensor to sensor. This routine finds them from a target
+// that several sensors see at once: a flat target in front of the whole array,
+// or any object in the overlap of some sensors' fields of view.
+//
+// Place the target at a few positions ("poses"). For each pose, call
+// beginPose() and feed samples from every sensor that sees the target to
+// add(); samples are averaged per sensor and pose. Not every sensor has to see
+// every pose, as long as the poses link all sensors together. Then solve()
+// fits, by least squares, each sensor's reading as
+//
+//   reading = scale * (distance + geometry) + offset
+//
+// where distance is the target distance at that pose (given to beginPose() if
+// known, otherwise estimated along with the rest) and geometry is how much
+// farther from the target the sensor is mounted than the array's reference
+// plane (setGeometry(), 0 by default). With no known distances the result is
+// relative: the offsets average to 0 and the scales to 1, which is what
+// fusion needs to compare sensors with each other.
+//
+// program() writes each sensor's offset correction into its range offset
+// register (VL53L1X::setOffset()), and refreshes its configuration cache so it
+// survives recovery and power gating. The sensor has no scale setting, so the
+// scale correction is applied in software with correct().
+class VL53L1XArrayCalibration
+{
+  public:
+
+    static const uint8_t MaxPoses = 8;
+
+    struct Cell
+    {
+      int32_t sum_mm;
+      uint16_t count;
+    };
+
+    struct Result
+    {
+      int16_t offset_mm;      // fitted offset (program() subtracts it)
+      uint16_t scale_q14;     // correction factor, 1.0 = 16384
+      uint16_t residual_mm;   // RMS fit error
+      int16_t geometry_mm;    // input: mounting setback, see above
+
+      // working values of solve()
+      float fit_scale;
+      float fit_offset;
+    };
+
+    // cells holds count * MaxPoses cells; results holds count results
+    VL53L1XArrayCalibration(VL53L1X * sensors, uint8_t count, Cell * cells, Result * results);
+
+    void setGeometry(uint8_t sensor, int16_t geometry_mm) { results[sensor].geometry_mm = geometry_mm; }
+
+    // forget all samples
+    void reset();
+
+    // start collecting samples for a pose; known_mm is the distance from the
+    // reference plane to the target, or 0 if unknown. Returns false if there
+    // are no poses left.
+    bool beginPose(uint16_t known_mm = 0);
+    uint8_t getPoseCount() { return pose_count; }
+
+    // invalid samples are ignored
+    void add(uint8_t sensor, uint16_t range_mm, uint8_t range_status);
+    void add(uint8_t sensor, const VL53L1X::RangingData & data) { add(sensor, data.range_mm, data.range_status); }
+
+    // fit offsets (and scales, if fit_scale and the poses span more than one
+    // distance); returns false if some sensor has no samples
+    bool solve(bool fit_scale);
+
+    // program the offset corrections into the sensors; returns false if a
+    // sensor could not be written
+    bool program();
+
+    // apply a sensor's scale correction to a range read after program()
+    uint16_t correct(uint8_t sensor, uint16_t range_mm) { return ((uint32_t)range_mm * results[sensor].scale_q14 + 8192) >> 14; }
+
+    const Result & getResult(uint8_t sensor) { return results[sensor]; }
+
+  private:
+
+    static const uint8_t Iterations = 20;
+
+    VL53L1X * sensors;
+    uint8_t count;
+    Cell * cells;
+    Result * results;
+
+    uint8_t pose_count;
+    uint16_t known_mm[MaxPoses];
+
+    Cell & cell(uint8_t sensor, uint8_t pose) { return cells[(uint16_t)sensor * MaxPoses + pose]; }
+};
+
+#endif
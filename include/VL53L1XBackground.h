@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_BACKGROUND
+
+// Static background model for fixed installations.
+//
+// The model keeps one cell per sensor and ROI zone (a sensor read with a
+// single ROI has one zone). Each cell learns the range of whatever is normally
+// there (walls, furniture, open space) as a running mean and mean absolute
+// deviation, and classify() sorts each new sample into background or
+// foreground, so only foreground samples need to be reported.
+//
+// - A sample is foreground when it differs from the background mean by more
+//   than a multiple of the cell's deviation (and at least a fixed margin), so
+//   the threshold adapts to how noisy each zone is.
+// - The model only learns from background samples (quiet periods), so people
+//   walking by don't pull it towards them.
+// - Something that stays in the foreground for long enough (a moved chair) is
+//   absorbed: the cell starts learning again from the new range.
+// - A return with no target (signal or phase failure) is treated as open
+//   space at FarRange, so an empty zone also has a background; samples with
+//   other failures are ignored.
+//
+// Each call is constant time: a few integer operations on one cell.
+class VL53L1XBackground
+{
+  public:
+
+    enum Result : uint8_t
+    {
+      Learning,   // the cell does not have enough samples yet
+      Background,
+      Foreground,
+      Ignored,    // the sample's range status makes it unusable
+    };
+
+    struct Cell
+    {
+      uint16_t mean_q4;        // background range, 1/16 mm
+      uint16_t deviation_q4;   // mean absolute deviation, 1/16 mm
+      uint16_t samples;        // samples learned since (re)training, saturating
+      uint16_t foreground_run; // consecutive foreground samples
+    };
+
+    // range used for samples with no target
+    static const uint16_t FarRange = 4000;
+
+    // cells holds sensor_count * zone_count cells
+    VL53L1XBackground(Cell * cells, uint8_t sensor_count, uint8_t zone_count);
+
+    // the running mean and deviation follow new samples with weight
+    // 1 / 2^rate_shift; a cell classifies samples after train_samples samples
+    void setLearning(uint8_t rate_shift, uint16_t train_samples) { this->rate_shift = rate_shift; this->train_samples = train_samples; }
+
+    // foreground: more than (deviation * multiple_q2 / 4) and margin_mm away
+    // from the background
+    void setThreshold(uint8_t multiple_q2, uint16_t margin_mm) { this->multiple_q2 = multiple_q2; this->margin_mm = margin_mm; }
+
+    // consecutive foreground samples after which a cell is retrained
+    void setAbsorb(uint16_t samples) { absorb_samples = samples; }
+
+    Result classify(uint8_t sensor, uint8_t zone, uint16_t range_mm, uint8_t range_status);
+    Result classify(uint8_t sensor, const VL53L1X::RangingData & data) { return classify(sensor, 0, data.range_mm, data.range_status); }
+
+    // forget what a sensor's cells have learned (e.g. after it was moved)
+    void reset(uint8_t sensor);
+
+    uint16_t getBackground(uint8_t sensor, uint8_t zone) { return cell(sensor, zone).mean_q4 >> 4; }
+    uint16_t getThreshold(uint8_t sensor, uint8_t zone) { return threshold(cell(sensor, zone)) >> 4; }
+
+  private:
+
+    Cell * cells;
+    uint8_t sensor_count;
+    uint8_t zone_count;
+
+    uint8_t rate_shift;
+    uint16_t train_samples;
+    uint8_t multiple_q2;
+    uint16_t margin_mm;
+    uint16_t absorb_samples;
+
+    Cell & cell(uint8_t sensor, uint8_t zone) { return cells[(uint16_t)sensor * zone_count + zone]; }
+    uint32_t threshold(const Cell & c);
+    void learn(Cell & c, uint16_t range_q4);
+};
+
+#endif
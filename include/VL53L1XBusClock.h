@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_BUS_CLOCK
+
+#if VL53L1X_FEATURE_RECOVERY
+#include "VL53L1XRecovery.h"
+#endif
+
+// Adaptive I2C clock for each bus.
+//
+// Each bus gets a list of rates, fastest first (for example 1 MHz Fast-mode
+// Plus, 400 kHz and 100 kHz), and starts at the fastest. After each driver
+// call, pass its outcome to record(): the sensor's last_status and whether it
+// timed out. Outcomes are counted in windows of setWindow() transactions:
+//
+// - a window with at least setStepDownErrors() failures (NACKs, bus errors,
+//   timeouts) steps the bus down to the next slower rate right away;
+// - after setStepUpWindows() clean windows in a row, the bus steps back up.
+//   If the faster rate then fails within as many windows, the number of clean
+//   windows needed to try it again doubles (up to MaxStepUpWindows), so a
+//   marginal harness settles at the rate it can sustain instead of
+//   oscillating; once a rate has lasted that long, the count is reset.
+//
+// Record only sensors that are expected to answer: a sensor that is missing
+// NACKs every time, which says nothing about the wiring (VL53L1XRecovery
+// deals with it). The new rate is given to the bus's VL53L1XRecovery too, so
+// a bus restart keeps it.
+class VL53L1XBusClock
+{
+  public:
+
+    static const uint8_t MaxBuses = 4;
+    static const uint8_t MaxRates = 4;
+    static const uint16_t MaxStepUpWindows = 1024;
+
+    struct Stats
+    {
+      uint32_t transactions;
+      uint32_t failures;
+      uint16_t step_downs;
+      uint16_t step_ups;
+    };
+
+    VL53L1XBusClock();
+
+    // rates: rate_count clock rates in Hz, fastest first; the array must stay
+    // valid
+#if VL53L1X_FEATURE_RECOVERY
+    bool addBus(TwoWire * bus, const uint32_t * rates, uint8_t rate_count, VL53L1XRecovery * recovery = nullptr);
+#else
+    bool addBus(TwoWire * bus, const uint32_t * rates, uint8_t rate_count);
+#endif
+
+    void setWindow(uint8_t transactions) { window = transactions; }
+    void setStepDownErrors(uint8_t errors) { step_down_errors = errors; }
+    void setStepUpWindows(uint16_t windows) { step_up_windows = windows; }
+
+    // set every bus to its fastest rate
+    void begin();
+
+    void record(uint8_t bus, uint8_t status, bool timed_out = false);
+
+    uint32_t getClock(uint8_t bus) { return buses[bus].rates[buses[bus].rate]; }
+    uint8_t getRateIndex(uint8_t bus) { return buses[bus].rate; }
+
+    // payload bytes per second the bus currently delivers: the clock over the
+    // 9 clocks of a byte, times the fraction of transactions that succeed
+    uint32_t getBandwidth(uint8_t bus);
+
+    const Stats & getStats(uint8_t bus) { return buses[bus].stats; }
+
+  private:
+
+    struct Bus
+    {
+      TwoWire * wire;
+#if VL53L1X_FEATURE_RECOVERY
+      VL53L1XRecovery * recovery;
+#endif
+      const uint32_t * rates;
+      uint8_t rate_count;
+      uint8_t rate;
+
+      uint8_t count;            // transactions in the current window
+      uint8_t failures;         // failures in the current window
+      uint16_t clean_windows;   // in a row
+      uint16_t up_windows;      // clean windows needed to step up
+      uint16_t probation;       // windows left before a step up is trusted
+      uint16_t success;         // moving average, 1.0 = 0xFFFF
+
+      Stats stats;
+    };
+
+    Bus buses[MaxBuses];
+    uint8_t bus_count;
+
+    uint8_t window;
+    uint8_t step_down_errors;
+    uint16_t step_up_windows;
+
+    void endWindow(Bus & b);
+    void setRate(Bus & b, uint8_t rate);
+};
+
+#endif
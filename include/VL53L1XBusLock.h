@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "VL53L1XConfig.h"
+
+// Per-bus locking, for driving sensors from several threads (RTOS tasks, or
+// host threads).
+//
+// Every I2C transaction of the library (a register access, one chunk of a
+// burst, a probe, a bus clear) runs inside a VL53L1XBusGuard, which holds the
+// lock of its bus if one was attached with VL53L1XBusLock::attach(). Sensors
+// sharing a bus can then be called from different threads without their
+// transactions interleaving, while buses with separate locks run fully in
+// parallel. Buses without a lock, and builds without
+// VL53L1X_FEATURE_BUS_LOCK, pay nothing.
+//
+// The lock protects the bus, not the sensor: a VL53L1X object (its
+// ranging_data, last_status and timeout state) must only be used by one thread
+// at a time, typically the task that owns its bus. A caller can also hold a
+// VL53L1XBusGuard around a sequence of calls (selecting a multiplexer channel
+// and reading behind it, say) to keep other threads off the bus meanwhile; the
+// lock is recursive.
+//
+// The mutexes are FreeRTOS recursive mutexes where FreeRTOS is available, and
+// std::recursive_mutex in host builds.
+
+#if VL53L1X_FEATURE_BUS_LOCK
+
+class VL53L1XBusLock
+{
+  public:
+
+    static const uint8_t MaxBuses = 4;
+    static const int8_t NoLock = -1;
+
+    // Give the bus a lock; call during setup, before other threads use the
+    // library. Returns false if there is no room (or no mutex) for it.
+    static bool attach(TwoWire * bus);
+
+    // index of the bus's lock, or NoLock
+    static int8_t find(TwoWire * bus)
+    {
+      for (uint8_t i = 0; i < count; i++)
+      {
+        if (buses[i] == bus) { return i; }
+      }
+      return NoLock;
+    }
+
+    static void take(int8_t lock);
+    static void give(int8_t lock);
+
+  private:
+
+    static TwoWire * buses[MaxBuses];
+    static uint8_t count;
+};
+
+class VL53L1XBusGuard
+{
+  public:
+
+    explicit VL53L1XBusGuard(TwoWire * bus) : lock(VL53L1XBusLock::find(bus))
+    {
+      if (lock != VL53L1XBusLock::NoLock) { VL53L1XBusLock::take(lock); }
+    }
+
+    ~VL53L1XBusGuard()
+    {
+      if (lock != VL53L1XBusLock::NoLock) { VL53L1XBusLock::give(lock); }
+    }
+
+    VL53L1XBusGuard(const VL53L1XBusGuard &) = delete;
+    VL53L1XBusGuard & operator=(const VL53L1XBusGuard &) = delete;
+
+  private:
+
+    int8_t lock;
+};
+
+#else
+
+class VL53L1XBusGuard
+{
+  public:
+
+    explicit VL53L1XBusGuard(TwoWire *) {}
+};
+
+#endif
@@ -0,0 +1,120 @@
+#pragma once
+
+// Compile-time feature selection.
+//
+// Every feature except the bus locks is enabled by default. Define its macro
+// to 0 (for example with -D in the build_flags of an environment in
+// platformio.ini) to leave it out of the build entirely; using a disabled
+// feature is a compile error rather than dead weight. The teensylc_minimal
+// environment shows a hot-path-only build.
+//
+// To see what each feature costs in flash and RAM, build with the footprint
+// target: pio run -e <env> -t footprint (see tools/footprint.py).
+
+// rangeStatusToString(). Note that on an AVR, its strings are stored in RAM.
+#ifndef VL53L1X_FEATURE_STATUS_STRINGS
+#define VL53L1X_FEATURE_STATUS_STRINGS 1
+#endif
+
+// Signal and ambient rates in RangingData as floats (MCPS). When disabled, the
+// rates are kept in the sensor's fixed point 9.7 format and no float code is
+// pulled in.
+#ifndef VL53L1X_FEATURE_FLOAT_RATES
+#define VL53L1X_FEATURE_FLOAT_RATES 1
+#endif
+
+// XSHUT control and configuration snapshots (saveConfig(), restoreConfig()).
+#ifndef VL53L1X_FEATURE_RESTORE
+#define VL53L1X_FEATURE_RESTORE 1
+#endif
+
+// VL53L1XRecovery: I2C bus fault recovery
+#ifndef VL53L1X_FEATURE_RECOVERY
+#define VL53L1X_FEATURE_RECOVERY VL53L1X_FEATURE_RESTORE
+#endif
+
+// VL53L1XSupervisor: sensor health supervision
+#ifndef VL53L1X_FEATURE_SUPERVISOR
+#define VL53L1X_FEATURE_SUPERVISOR VL53L1X_FEATURE_RESTORE
+#endif
+
+// VL53L1XPowerManager: XSHUT power gating of sensor groups
+#ifndef VL53L1X_FEATURE_POWER_MANAGER
+#define VL53L1X_FEATURE_POWER_MANAGER VL53L1X_FEATURE_RESTORE
+#endif
+
+// VL53L1XControl: binary runtime control plane over a serial link
+#ifndef VL53L1X_FEATURE_CONTROL
+#define VL53L1X_FEATURE_CONTROL 1
+#endif
+
+// VL53L1XGesture: hover and swipe detection with ROI zones
+#ifndef VL53L1X_FEATURE_GESTURE
+#define VL53L1X_FEATURE_GESTURE 1
+#endif
+
+// VL53L1XBackground: static background model, foreground classification
+#ifndef VL53L1X_FEATURE_BACKGROUND
+#define VL53L1X_FEATURE_BACKGROUND 1
+#endif
+
+// VL53L1XZoneScan: adaptive quadtree multi-zone scanning
+#ifndef VL53L1X_FEATURE_ZONE_SCAN
+#define VL53L1X_FEATURE_ZONE_SCAN 1
+#endif
+
+// VL53L1XFrameAssembler: motion-compensated frames from scanned zones
+#ifndef VL53L1X_FEATURE_FRAME_ASSEMBLY
+#define VL53L1X_FEATURE_FRAME_ASSEMBLY 1
+#endif
+
+// VL53L1XArrayCalibration: relative offset/scale calibration of an array
+#ifndef VL53L1X_FEATURE_ARRAY_CALIBRATION
+#define VL53L1X_FEATURE_ARRAY_CALIBRATION 1
+#endif
+
+// VL53L1XRuleEngine: alert rules compiled to per-sensor tables
+#ifndef VL53L1X_FEATURE_RULES
+#define VL53L1X_FEATURE_RULES 1
+#endif
+
+// VL53L1XEnumerator: bounded-time bus and multiplexer enumeration
+#ifndef VL53L1X_FEATURE_ENUMERATION
+#define VL53L1X_FEATURE_ENUMERATION 1
+#endif
+
+// VL53L1XSleep: MCU sleep between data-ready events
+#ifndef VL53L1X_FEATURE_SLEEP
+#define VL53L1X_FEATURE_SLEEP 1
+#endif
+
+// VL53L1XTrend: signal-rate trend monitoring for optical degradation
+#ifndef VL53L1X_FEATURE_TREND
+#define VL53L1X_FEATURE_TREND 1
+#endif
+
+// VL53L1XBusClock: adaptive I2C clock per bus
+#ifndef VL53L1X_FEATURE_BUS_CLOCK
+#define VL53L1X_FEATURE_BUS_CLOCK 1
+#endif
+
+// VL53L1XBusLock: per-bus locks for using the library from several threads.
+// Off by default: it needs FreeRTOS (or a host build), and single-threaded
+// sketches don't need it.
+#ifndef VL53L1X_FEATURE_BUS_LOCK
+#define VL53L1X_FEATURE_BUS_LOCK 0
+#endif
+
+// VL53L1XTiming: on-device characterization of the achieved period and jitter
+#ifndef VL53L1X_FEATURE_TIMING
+#define VL53L1X_FEATURE_TIMING 1
+#endif
+
+// VL53L1XRouter: multi-sink sample output with per-sink queues
+#ifndef VL53L1X_FEATURE_ROUTER
+#define VL53L1X_FEATURE_ROUTER 1
+#endif
+
+#if !VL53L1X_FEATURE_RESTORE && (VL53L1X_FEATURE_RECOVERY || VL53L1X_FEATURE_SUPERVISOR || VL53L1X_FEATURE_POWER_MANAGER)
+#error "VL53L1X_FEATURE_RECOVERY, _SUPERVISOR and _POWER_MANAGER require VL53L1X_FEATURE_RESTORE"
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+#include "VL53L1XProtocol.h"
+#include "VL53L1XSample.h"
+
+#if VL53L1X_FEATURE_CONTROL
+
+#if VL53L1X_FEATURE_SUPERVISOR
+#include "VL53L1XSupervisor.h"
+#endif
+#if VL53L1X_FEATURE_RECOVERY
+#include "VL53L1XRecovery.h"
+#endif
+#if VL53L1X_FEATURE_RULES
+#include "VL53L1XRuleEngine.h"
+#endif
+
+// Runtime control plane: lets a host read and change sensor settings, start
+// and stop ranging, trigger calibration and read counters over a serial link,
+// using the binary frames described in VL53L1XProtocol.h.
+//
+// Changes are applied with as little disruption as possible:
+//
+// - ROI size and center are written directly; the sensor picks them up at the
+//   next measurement without stopping.
+// - Distance mode, timing budget and period need ranging to be stopped, so the
+//   stop, the change and the restart (with the same period) go out together
+//   through a VL53L1XWriteQueue, losing at most the measurement in progress.
+//
+// Every change is acknowledged with the value read back from the sensor. If
+// the sensor has a configuration cache, it is refreshed so that recovery and
+// power gating restore the new settings.
+//
+// With a rule engine attached (setRules()), the host can also replace the
+// alert rules, and poll() sends the alerts it raises as Alert frames.
+//
+// Readings can be streamed to the host as Sample frames with sendSample(), in
+// place of text output.
+//
+// Call poll() from loop(); it handles whatever has arrived and never waits for
+// more.
+class VL53L1XControl
+{
+  public:
+
+    struct Counters
+    {
+      uint16_t frames;    // valid frames received
+      uint16_t errors;    // frames rejected by the parser (CRC, length)
+      uint16_t applied;   // commands that succeeded, per sensor
+      uint16_t failed;    // commands that were rejected or failed, per sensor
+    };
+
+    VL53L1XControl(Stream & port, VL53L1X * sensors, uint8_t count);
+
+    // sensor_groups[i] is the group of sensors[i], for group targets (same
+    // array as VL53L1XPowerManager uses)
+    void setGroups(const uint8_t * sensor_groups) { this->sensor_groups = sensor_groups; }
+
+#if VL53L1X_FEATURE_SUPERVISOR
+    void setSupervisor(VL53L1XSupervisor * supervisor) { this->supervisor = supervisor; }
+#endif
+#if VL53L1X_FEATURE_RECOVERY
+    void setRecovery(VL53L1XRecovery * recovery) { this->recovery = recovery; }
+#endif
+#if VL53L1X_FEATURE_RULES
+    void setRules(VL53L1XRuleEngine * rules) { this->rules = rules; }
+#endif
+
+    void poll();
+
+    // send a reading of sensor index as a Sample frame
+    void sendSample(uint8_t index, const VL53L1XSample & sample);
+
+    const Counters & getCounters() { return counters; }
+
+  private:
+
+    // bytes handled per poll(), to bound the time spent in one call
+    static const uint8_t MaxBytesPerPoll = 64;
+
+    Stream & port;
+    VL53L1X * sensors;
+    uint8_t count;
+    const uint8_t * sensor_groups;
+
+#if VL53L1X_FEATURE_SUPERVISOR
+    VL53L1XSupervisor * supervisor;
+#endif
+#if VL53L1X_FEATURE_RECOVERY
+    VL53L1XRecovery * recovery;
+#endif
+#if VL53L1X_FEATURE_RULES
+    VL53L1XRuleEngine * rules;
+    uint8_t alert_seq;
+#endif
+    uint8_t sample_seq;
+
+    VL53L1XFrameParser parser;
+    Counters counters;
+
+    bool targets(uint8_t target, uint8_t index);
+    void handle(const VL53L1XProtocol::Frame & request);
+    uint8_t execute(const VL53L1XProtocol::Frame & request, uint8_t index, uint8_t * reply, uint8_t * length);
+    uint8_t get(VL53L1X & sensor, uint8_t param, uint32_t * value);
+    uint8_t set(VL53L1X & sensor, uint8_t param, uint32_t value);
+    uint8_t restart(VL53L1X & sensor, uint32_t period_ms);
+    uint8_t counterDump(uint8_t index, uint8_t * out);
+    uint8_t finish(VL53L1X & sensor);
+#if VL53L1X_FEATURE_RULES
+    void loadRules(const VL53L1XProtocol::Frame & request, VL53L1XProtocol::Frame & reply);
+    void sendAlerts();
+#endif
+    void send(const VL53L1XProtocol::Frame & reply);
+};
+
+#endif
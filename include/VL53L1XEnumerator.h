@@ -0,0 +1,162 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_ENUMERATION
+
+#if VL53L1X_FEATURE_RECOVERY
+#include "VL53L1XRecovery.h"
+#endif
+
+// Bus enumeration: finds every device on a set of I2C buses, including behind
+// TCA9548A-style multiplexers, and identifies the VL53L1X sensors among them.
+//
+// Each address costs a single transaction: the model ID register address is
+// written and, if the device ACKs, the two ID bytes are read back after a
+// repeated start, so an absent address is only the address byte and its NACK
+// (about 25 us at 400 kHz). Every probe is timed; one that takes longer than
+// the probe limit (setProbeLimit()), or fails with a bus error, counts as a
+// fault on that bus, which is cleared with the bus's VL53L1XRecovery if it has
+// one. After MaxBusFaults faults the rest of the bus is skipped, and the whole
+// enumeration stops when the budget (setBudget()) runs out.
+//
+// Where the Wire library has a transaction timeout (WIRE_HAS_TIMEOUT, as in
+// the AVR core), the probe limit is also set as that timeout, so a stuck
+// transaction is cut short and a dead bus costs a bounded time. Elsewhere
+// (Teensy's Wire among others) a probe can't be interrupted: the limit only
+// flags a slow probe once it has returned, and a transaction that never
+// returns hangs the enumeration along with everything else on that bus.
+//
+// Behind a multiplexer, each channel is enabled alone and scanned in turn.
+// Addresses that answered with every channel disabled are on the bus itself,
+// and are not scanned again. Multiplexer addresses are not scanned either.
+//
+// Writing the register address is harmless for VL53L1X sensors and for most
+// other devices, but restrict the scan with setAddressRange() if the bus has
+// devices that treat any write as a command.
+//
+// Note that sensors still at the default address (0x29) all answer at once;
+// enumerate after giving them unique addresses, or with only one of them out
+// of reset.
+class VL53L1XEnumerator
+{
+  public:
+
+    static const uint8_t MaxBuses = 4;
+    static const uint8_t MaxMuxes = 4;
+    static const uint8_t MuxChannels = 8;
+    static const uint8_t NoMux = 0xFF;
+    static const uint8_t MaxBusFaults = 3;
+
+    static const uint16_t ModelId = 0xEACC; // model ID and module type
+
+    enum Probe : uint8_t
+    {
+      Absent,     // no ACK
+      Identified, // a VL53L1X
+      Present,    // something else
+      BusError,
+    };
+
+    struct Device
+    {
+      uint8_t bus;        // index in the order buses were added
+      uint8_t mux;        // index in the order muxes were added, or NoMux
+      uint8_t channel;
+      uint8_t address;
+      uint16_t model_id;  // the two ID bytes read, 0 if they couldn't be read
+      bool sensor;        // model_id == ModelId
+    };
+
+    struct Stats
+    {
+      uint16_t probes;
+      uint16_t faults;        // slow probes and bus errors
+      uint16_t skipped_buses; // buses given up on after MaxBusFaults
+      uint8_t dropped;        // devices found with the inventory full
+      uint16_t max_probe_us;
+      uint16_t elapsed_ms;
+      bool complete;          // false if the budget ran out
+    };
+
+    // inventory: room for capacity devices
+    VL53L1XEnumerator(Device * inventory, uint8_t capacity);
+
+#if VL53L1X_FEATURE_RECOVERY
+    bool addBus(TwoWire * bus, VL53L1XRecovery * recovery = nullptr);
+#else
+    bool addBus(TwoWire * bus);
+#endif
+    bool addMux(uint8_t bus, uint8_t address);
+
+    void setAddressRange(uint8_t first, uint8_t last) { first_address = first; last_address = last; }
+    void setProbeLimit(uint16_t limit_us) { probe_limit_us = limit_us; }
+    void setBudget(uint16_t budget_ms) { this->budget_ms = budget_ms; }
+
+    // scan everything; returns the number of devices found
+    uint8_t enumerate();
+
+    uint8_t getCount() { return count; }
+    const Device & getDevice(uint8_t i) { return inventory[i]; }
+    uint8_t getSensorCount();
+
+    // index of the device at that place in the inventory, or -1 if missing
+    int find(uint8_t bus, uint8_t mux, uint8_t channel, uint8_t address);
+    int find(uint8_t bus, uint8_t address) { return find(bus, NoMux, 0, address); }
+
+    // route a bus to a device's multiplexer channel (with every other
+    // multiplexer on the bus disabled); true if it could be selected. With
+    // several threads on the bus, hold a VL53L1XBusGuard from here until done
+    // with the device.
+    bool select(const Device & device);
+
+    const Stats & getStats() { return stats; }
+
+    // one probe transaction; model_id gets the ID bytes if the device ACKed
+    static Probe probe(TwoWire * bus, uint8_t address, uint16_t * model_id);
+
+  private:
+
+    struct Bus
+    {
+      TwoWire * wire;
+#if VL53L1X_FEATURE_RECOVERY
+      VL53L1XRecovery * recovery;
+#endif
+      uint8_t faults;
+    };
+
+    struct Mux
+    {
+      uint8_t bus;
+      uint8_t address;
+    };
+
+    Device * inventory;
+    uint8_t capacity;
+    uint8_t count;
+
+    Bus buses[MaxBuses];
+    uint8_t bus_count;
+    Mux muxes[MaxMuxes];
+    uint8_t mux_count;
+
+    uint8_t first_address;
+    uint8_t last_address;
+    uint16_t probe_limit_us;
+    uint16_t budget_ms;
+
+    uint16_t start_ms;
+    Stats stats;
+
+    bool scan(uint8_t bus, uint8_t mux, uint8_t channel, uint8_t * direct);
+    bool isMux(uint8_t bus, uint8_t address);
+    bool setMux(uint8_t mux, uint8_t channels);
+    void disableMuxes(uint8_t bus);
+    void fault(uint8_t bus);
+    bool outOfTime() { return (uint16_t)(millis() - start_ms) >= budget_ms; }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_FRAME_ASSEMBLY
+
+// Motion-compensated frames from zones scanned one after another.
+//
+// When one sensor scans several ROI zones with setROICenter(), each zone is
+// measured at a different time, so a moving target is smeared across the
+// frame: zones scanned early show where it was, zones scanned late where it
+// is. The assembler tracks the range and range rate of every zone with an
+// alpha-beta filter, timestamping each sample as it is read, and produces
+// frames in which every zone is predicted to one common frame time.
+//
+// Each zone of a frame comes with an uncertainty: the zone's typical
+// prediction error (mean absolute innovation) plus how much its velocity
+// estimate varies, times how far it had to be extrapolated. Consumers can use
+// it to weight zones or to gate associations.
+//
+// The caller owns the zones array: fill in roi_center for each zone and leave
+// the rest to the assembler. update() scans the zones in order and returns
+// true when a frame (one pass over all zones) is ready, aligned to the time
+// of its last sample; assemble() aligns to any other time. As with
+// VL53L1XGesture, the period must leave a gap between measurements for the
+// ROI to be reprogrammed (startContinuous(budget_ms + 2) or more), and each
+// result must be read within that gap; a result whose stream count shows that
+// a measurement was missed is dropped, since its zone isn't known, and counted
+// in getResyncs(). add() feeds in samples taken some other way.
+class VL53L1XFrameAssembler
+{
+  public:
+
+    static const uint16_t NoTarget = 0xFFFF;
+
+    struct Zone
+    {
+      uint8_t roi_center;
+
+      // tracking state
+      bool tracking;
+      uint8_t samples;             // since tracking started (saturating)
+      uint16_t range_mm;           // filtered range at timestamp_us
+      int16_t velocity_q8;         // range rate, 1/256 mm per millisecond
+      uint16_t innovation_mm;      // mean absolute prediction error
+      uint16_t velocity_spread_q8; // mean absolute velocity change
+      uint32_t timestamp_us;
+
+      // output of the last assemble()
+      uint16_t frame_range_mm;       // NoTarget if none
+      uint16_t frame_uncertainty_mm;
+      int32_t frame_offset_us;       // frame time minus sample time
+    };
+
+    VL53L1XFrameAssembler(VL53L1X & sensor, Zone * zones, uint8_t count);
+
+    // filter gains: alpha = 1 / 2^alpha_shift, beta = 1 / 2^beta_shift
+    void setGains(uint8_t alpha_shift, uint8_t beta_shift) { this->alpha_shift = alpha_shift; this->beta_shift = beta_shift; }
+
+    // samples further apart than this restart a zone's velocity estimate, and
+    // zones are not extrapolated further than this
+    void setMaxGap(uint32_t max_gap_us) { this->max_gap_us = (max_gap_us > MaxGapLimit) ? MaxGapLimit : max_gap_us; }
+
+    // programs the first zone; call with the sensor initialized and before
+    // starting continuous ranging (otherwise the first result is dropped)
+    void begin();
+
+    bool update();
+
+    void add(uint8_t zone, uint16_t range_mm, uint8_t range_status, uint32_t timestamp_us);
+    void assemble(uint32_t frame_time_us);
+
+    uint32_t getFrameTime() { return frame_time_us; }
+
+    // results dropped because their zone wasn't known
+    uint16_t getResyncs() { return resyncs; }
+
+  private:
+
+    // limits that keep the fixed point arithmetic within 32 bits: 10 m/s,
+    // half a second of extrapolation and 8 m of prediction error
+    static const int16_t MaxVelocity = 2560;
+    static const uint32_t MaxGapLimit = 500000;
+    static const int32_t MaxInnovation = 8000;
+
+    VL53L1X & sensor;
+    Zone * zones;
+    uint8_t count;
+    uint8_t current;
+
+    // stream count the next result should have (-1: any)
+    bool synced;
+    int16_t expected_stream;
+    uint16_t resyncs;
+
+    uint8_t alpha_shift;
+    uint8_t beta_shift;
+    uint32_t max_gap_us;
+
+    uint32_t frame_time_us;
+
+    int32_t predict(const Zone & zone, int32_t dt_us);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_GESTURE
+
+// Hover and swipe detection with one sensor.
+//
+// The sensor ranges continuously with a small ROI, and the engine moves the
+// ROI center to the next of 2 to 4 zones after every measurement, so each zone
+// is sampled once per cycle. A hand passing over the sensor enters the zones
+// one after another; the order of those presence onsets gives the swipe
+// direction. A hand held over the sensor is a hover.
+//
+// Each zone has a position given with addZone(): x to the right and y up, as
+// seen by the user, in any consistent unit (note that the receiver lens
+// mirrors the scene onto the SPAD array, so a zone on the left of the array
+// sees the right side). The swipe direction is the direction from the zone
+// entered first to the zone entered last: a mostly horizontal one is a left or
+// right swipe, otherwise up or down. Two zones side by side therefore detect
+// left/right swipes only.
+//
+// Events are produced while the hand is still in view or as soon as it
+// leaves, so the latency is bounded by one zone cycle after the gesture ends
+// (or after the hover time is reached). A gesture that takes longer than the
+// swipe limit without becoming a hover is dropped.
+//
+// The ROI takes effect from the measurement after the one in progress when it
+// is written, so use a period of at least the timing budget plus a couple of
+// milliseconds (e.g. startContinuous(budget_ms + 2)), and call update() often
+// enough to read each result within that gap; the engine then attributes each
+// result to the zone that was programmed before it. It checks this with the
+// stream count: a result that isn't the measurement right after the previous
+// one (a measurement was missed, so the ROI may have been written too late)
+// is dropped, the zone is programmed again, and getResyncs() counts it. A
+// read that comes late but within the same period can't be detected.
+//
+// Call update() from loop(); it never waits for the sensor. process() runs the
+// detector on a sample from elsewhere (a recording, for example).
+class VL53L1XGesture
+{
+  public:
+
+    enum Gesture : uint8_t
+    {
+      None,
+      Hover,
+      SwipeLeft,
+      SwipeRight,
+      SwipeUp,
+      SwipeDown,
+    };
+
+    struct Event
+    {
+      Gesture gesture;
+      uint32_t timestamp_ms;  // when the event was recognized
+      uint16_t duration_ms;   // first onset to event
+      uint16_t distance_mm;   // closest range seen during the gesture
+    };
+
+    static const uint8_t MaxZones = 4;
+
+    VL53L1XGesture(VL53L1X & sensor);
+
+    // zones are scanned in the order they are added; returns false if full
+    bool addZone(uint8_t roi_center, int8_t x, int8_t y);
+    uint8_t getZoneCount() { return zone_count; }
+
+    // something closer than threshold_mm is present; it must move beyond
+    // threshold_mm + hysteresis_mm to be absent again
+    void setThreshold(uint16_t threshold_mm, uint16_t hysteresis_mm) { this->threshold_mm = threshold_mm; this->hysteresis_mm = hysteresis_mm; }
+
+    // a swipe must cross the zones within swipe_ms; a hover is every zone
+    // present for hover_ms
+    void setTiming(uint16_t swipe_ms, uint16_t hover_ms) { this->swipe_ms = swipe_ms; this->hover_ms = hover_ms; }
+
+    // programs the first zone; call with the sensor initialized and before
+    // starting continuous ranging (otherwise the first result is dropped)
+    void begin();
+
+    Gesture update();
+    Gesture process(uint16_t range_mm, uint8_t range_status, uint32_t now_ms);
+
+    const Event & getEvent() { return event; }
+
+    // zone the next sample will be attributed to
+    uint8_t getCurrentZone() { return current; }
+    bool zonePresent(uint8_t zone) { return zones[zone].present; }
+
+    // results dropped because their zone wasn't known
+    uint16_t getResyncs() { return resyncs; }
+
+  private:
+
+    struct Zone
+    {
+      uint8_t roi_center;
+      int8_t x;
+      int8_t y;
+      bool present;
+      uint32_t onset_ms;
+    };
+
+    enum State : uint8_t
+    {
+      Idle,     // nothing present
+      Tracking, // something entered, collecting onsets
+      Done,     // event sent or gesture dropped; waiting for everything to clear
+    };
+
+    VL53L1X & sensor;
+
+    Zone zones[MaxZones];
+    uint8_t zone_count;
+    uint8_t current;
+
+    // stream count the next result should have; -1: any (the sensor wasn't
+    // ranging when the first zone was programmed)
+    bool synced;
+    int16_t expected_stream;
+    uint16_t resyncs;
+
+    uint16_t threshold_mm;
+    uint16_t hysteresis_mm;
+    uint16_t swipe_ms;
+    uint16_t hover_ms;
+
+    State state;
+    uint32_t start_ms;
+    uint16_t closest_mm;
+    uint8_t first_zone;  // zone with the earliest onset of this gesture
+    uint8_t last_zone;   // zone with the latest onset of this gesture
+    uint8_t entered;     // bitmask of zones that had an onset
+
+    Event event;
+
+    bool sampleZone(Zone & zone, uint16_t range_mm, uint8_t range_status, uint32_t now_ms);
+    Gesture classify();
+    Gesture emit(Gesture gesture, uint32_t now_ms);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_POWER_MANAGER
+
+// XSHUT power gating for groups of VL53L1X sensors.
+//
+// Each sensor belongs to one group. An idle group is held in hardware shutdown
+// through XSHUT, which draws far less than a stopped sensor. Waking a group
+// powers its sensors up one at a time (they all boot at the default address),
+// restores each one's cached configuration and address with
+// VL53L1X::restoreConfig(), and resumes ranging if it was running. Only one
+// group is restored at a time; groups woken meanwhile wait their turn, and so
+// does a group while VL53L1X::powerOn() refuses because another module (a
+// VL53L1XSupervisor) is bringing up a sensor on the same bus. If a
+// sensor can't be restored, the wake fails and the group goes back to sleep.
+// The manager measures the wake-to-first-sample latency: the time from the
+// wake request until every sensor in the group has a measurement ready.
+//
+// Groups can be woken on request (wake() and sleep()) or on a schedule
+// (setSchedule()). Everything is driven from service(), which never blocks
+// for longer than one restoreConfig().
+//
+// Sensors need an XSHUT pin and a saved configuration snapshot to be power
+// gated; sensors without them are left powered.
+class VL53L1XPowerManager
+{
+  public:
+
+    enum GroupState : uint8_t
+    {
+      On,
+      Off,
+      Restoring, // powering sensors up and restoring them, one at a time
+                 // (or waiting for another group to finish doing so)
+      Settling,  // all restored, waiting for the first sample of each
+    };
+
+    struct Group
+    {
+      GroupState state;
+      bool sensor_on;           // while Restoring: sensor `next` is powered up
+      uint8_t next;             // sensor index being woken or waited for
+      uint32_t period_ms;       // schedule: wake every period_ms...
+      uint32_t on_ms;           // ...and stay awake for on_ms (0 = no schedule)
+      uint32_t wake_ms;         // when the group was last woken
+      uint32_t wake_start_us;
+      uint32_t step_ms;         // when the current step started
+
+      uint16_t wakes;           // wakes started
+      uint16_t completed_wakes;
+      uint16_t failed_wakes;    // a sensor couldn't be restored
+      uint32_t last_latency_us; // wake-to-first-sample latency
+      uint32_t max_latency_us;
+      uint64_t total_latency_us; // over the completed wakes
+    };
+
+    // sensor_groups[i] is the group of sensors[i]; groups must point to
+    // group_count elements. Both arrays are owned by the caller. All groups
+    // start out awake.
+    VL53L1XPowerManager(VL53L1X * sensors, const uint8_t * sensor_groups, uint8_t count,
+                        Group * groups, uint8_t group_count);
+
+    // Keep a group awake for on_ms out of every period_ms; on_ms = 0 disables
+    // the schedule and leaves the group under manual control
+    void setSchedule(uint8_t group, uint32_t period_ms, uint32_t on_ms);
+
+    void wake(uint8_t group);
+    void sleep(uint8_t group);
+    void service();
+
+    // true if the sensor's group is fully awake and it can be read
+    bool awake(uint8_t index) { return groups[sensor_groups[index]].state == On; }
+
+    const Group & getGroup(uint8_t group) { return groups[group]; }
+
+    // average wake-to-first-sample latency of a group's completed wakes
+    uint32_t getAverageLatency(uint8_t group);
+
+  private:
+
+    // how long XSHUT is held low before a sensor can be powered up again, and
+    // how long to wait after releasing it before restoring (datasheet tBOOT is
+    // 1.2 ms max)
+    static const uint8_t PowerOffMs = 1;
+    static const uint8_t BootMs = 2;
+    static const uint8_t RestoreTimeoutMs = 2;
+
+    // give up waiting for a first sample after this long
+    static const uint16_t SettleTimeoutMs = 1000;
+
+    static const uint8_t NoGroup = 0xFF;
+
+    VL53L1X * sensors;
+    const uint8_t * sensor_groups;
+    uint8_t count;
+    Group * groups;
+    uint8_t group_count;
+    uint8_t restoring; // the group powering sensors up, or NoGroup
+
+    bool gated(uint8_t index);
+    uint8_t nextInGroup(uint8_t group, uint8_t from);
+    void stepRestoring(uint8_t group);
+    void failWake(uint8_t group);
+    void stepSettling(uint8_t group);
+};
+
+#endif
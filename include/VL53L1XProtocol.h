@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Binary framing for the serial link, shared by the device (VL53L1XControl) and
+// host-side tools, so it only depends on the C standard headers.
+//
+// Every frame is
+//
+//   0xA5 | length | seq | type | target | payload[length] | crc8
+//
+// where crc8 (polynomial 0x07, initial value 0) covers everything from length
+// through the end of the payload. Multi-byte payload fields are little-endian.
+//
+// Requests carry a host-chosen seq that is echoed in the reply. A reply has the
+// request type with the Reply bit set, the index of the sensor it concerns as
+// its target, and a Status byte as the first payload byte. Requests addressed
+// to a group or to all sensors get one reply per sensor, except Rules, which
+// applies to the whole device and gets one reply. Alert frames are sent by the
+// device on its own, as are Sample frames carrying telemetry, each with the
+// sensor as target and their own sequence count.
+class VL53L1XProtocol
+{
+  public:
+
+    static const uint8_t Sync = 0xA5;
+    static const uint8_t HeaderLength = 5; // sync, length, seq, type, target
+    static const uint8_t MaxPayload = 48;
+    static const uint8_t MaxFrame = HeaderLength + MaxPayload + 1;
+
+    enum Type : uint8_t
+    {
+      Ping      = 0x01, // no payload; replies Ok
+      Get       = 0x02, // [param] -> [status, param, value32]
+      Set       = 0x03, // [param, value32] -> [status, param, applied value32]
+      Start     = 0x04, // [period_ms32] (optional) -> [status]
+      Stop      = 0x05, // -> [status]
+      Calibrate = 0x06, // rerun VHV and phase calibration -> [status]
+      Counters  = 0x07, // -> [status, counters...] (see VL53L1XControl)
+      Rules     = 0x08, // [mode, rule records...] -> [status, rule count]
+      Alert     = 0x09, // sent by the device: [rule id, value16, timestamp_ms32]
+      Sample    = 0x0A, // sent by the device: a sample record (see below)
+
+      Reply     = 0x80, // set in the type of replies
+    };
+
+    enum Param : uint8_t
+    {
+      DistanceMode = 1, // VL53L1X::DistanceMode
+      TimingBudget = 2, // microseconds
+      RoiSize      = 3, // width | height << 8
+      RoiCenter    = 4, // SPAD number
+      Period       = 5, // inter-measurement period, milliseconds
+      Timeout      = 6, // I/O timeout, milliseconds
+    };
+
+    enum Status : uint8_t
+    {
+      Ok          = 0,
+      UnknownType = 1,
+      BadParam    = 2, // unknown parameter or value out of range
+      BadTarget   = 3,
+      BadLength   = 4,
+      Failed      = 5, // the sensor did not accept the change (bus error)
+    };
+
+    // Rules: mode RulesReplace clears the rule set first; each rule record is
+    // id, kind, target, count, threshold16, rearm16 (VL53L1XRuleEngine::Rule).
+    // The rule set is recompiled after every Rules frame, so a set too big for
+    // one frame is sent as a replace followed by appends. A frame with an
+    // invalid rule (BadParam) or that doesn't fit (Failed) changes nothing.
+    static const uint8_t RulesAppend = 0;
+    static const uint8_t RulesReplace = 1;
+    static const uint8_t RuleLength = 8;
+
+    // Sample: telemetry, with the sensor as target and the device's own
+    // sequence count. The record is VL53L1XSample: timestamp_us32, range_mm16,
+    // peak signal rate16 and ambient rate16 (9.7 fixed point MCPS),
+    // range_status, stream_count.
+    static const uint8_t SampleLength = 12;
+
+    // target values: a sensor index (0-0x7F), a group, or all sensors
+    static const uint8_t TargetGroup = 0x80; // | group number
+    static const uint8_t TargetAll = 0xFF;
+
+    struct Frame
+    {
+      uint8_t length;
+      uint8_t seq;
+      uint8_t type;
+      uint8_t target;
+      uint8_t payload[MaxPayload];
+    };
+
+    static uint8_t crc8(const uint8_t * data, uint8_t length, uint8_t crc = 0)
+    {
+      while (length--)
+      {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+          crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+      }
+      return crc;
+    }
+
+    // Serialize a frame into out (at least MaxFrame bytes); returns its size
+    static uint8_t encode(const Frame & frame, uint8_t * out)
+    {
+      out[0] = Sync;
+      out[1] = frame.length;
+      out[2] = frame.seq;
+      out[3] = frame.type;
+      out[4] = frame.target;
+      memcpy(out + HeaderLength, frame.payload, frame.length);
+      out[HeaderLength + frame.length] = crc8(out + 1, HeaderLength - 1 + frame.length);
+      return HeaderLength + frame.length + 1;
+    }
+
+    static void put16(uint8_t * p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    static void put32(uint8_t * p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+    static uint16_t get16(const uint8_t * p) { return p[0] | (uint16_t)p[1] << 8; }
+    static uint32_t get32(const uint8_t * p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+};
+
+// Incremental frame decoder: feed it received bytes one at a time. Garbage and
+// frames with a bad CRC are skipped, resynchronizing on the next sync byte.
+class VL53L1XFrameParser
+{
+  public:
+
+    VL53L1XFrameParser() : state(WaitSync), index(0), crc_errors(0), overruns(0) {}
+
+    // returns true when b completes a valid frame, available from frame()
+    bool feed(uint8_t b)
+    {
+      switch (state)
+      {
+        case WaitSync:
+          if (b == VL53L1XProtocol::Sync) { state = Header; index = 0; }
+          return false;
+
+        case Header:
+          header[index++] = b;
+          if (index == VL53L1XProtocol::HeaderLength - 1)
+          {
+            current.length = header[0];
+            current.seq = header[1];
+            current.type = header[2];
+            current.target = header[3];
+            if (current.length > VL53L1XProtocol::MaxPayload)
+            {
+              overruns++;
+              state = WaitSync;
+              return false;
+            }
+            index = 0;
+            state = (current.length > 0) ? Payload : Crc;
+          }
+          return false;
+
+        case Payload:
+          current.payload[index++] = b;
+          if (index == current.length) { state = Crc; }
+          return false;
+
+        case Crc:
+        default:
+        {
+          state = WaitSync;
+          uint8_t crc = VL53L1XProtocol::crc8(header, VL53L1XProtocol::HeaderLength - 1);
+          crc = VL53L1XProtocol::crc8(current.payload, current.length, crc);
+          if (crc != b)
+          {
+            crc_errors++;
+            return false;
+          }
+          return true;
+        }
+      }
+    }
+
+    const VL53L1XProtocol::Frame & frame() const { return current; }
+
+    uint16_t crcErrors() const { return crc_errors; }
+    uint16_t overrunErrors() const { return overruns; }
+
+  private:
+
+    enum State : uint8_t { WaitSync, Header, Payload, Crc };
+
+    State state;
+    uint8_t index;
+    uint8_t header[VL53L1XProtocol::HeaderLength - 1];
+    VL53L1XProtocol::Frame current;
+
+    uint16_t crc_errors;
+    uint16_t overruns;
+};
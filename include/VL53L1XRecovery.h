@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_RECOVERY
+
+// I2C fault recovery for one bus of VL53L1X sensors.
+//
+// After each driver call, pass the sensor to check(). It looks at last_status
+// and escalates in bounded steps:
+//
+//   1. bus errors (anything other than a NACK) or a sensor that keeps NACKing:
+//      release the bus, clock SCL until a slave holding SDA low lets go, and
+//      generate a STOP condition
+//   2. if the sensor still doesn't ACK: power-cycle it through XSHUT and
+//      restore its cached configuration with VL53L1X::restoreConfig(); if
+//      that fails (or another sensor on the bus is booting), it is left in
+//      shutdown until the next recovery
+//
+// The sequence is bounded by the time budget (setBudget()): the bus clear
+// (nine SCL clocks, a STOP and a restart of the Wire peripheral) always runs
+// and counts against it, and each later step (the probe, the power cycle, the
+// restore) only starts while some of it is left, so a recovery can overrun the
+// budget by at most the step that was running. Only the failing sensor is
+// reset, so other sensors on the bus keep ranging
+// (they range autonomously in continuous mode; at worst one of their samples
+// is read a few milliseconds late).
+//
+// Power cycling requires the sensor's XSHUT pin (VL53L1X::setXshutPin()) and a
+// configuration snapshot (VL53L1X::setConfigCache() and saveConfig()).
+class VL53L1XRecovery
+{
+  public:
+
+    enum Result : uint8_t
+    {
+      Ok,             // no fault
+      Pending,        // fault seen, not yet persistent enough to act on
+      BusCleared,     // bus released, sensor responding again
+      SensorRestored, // sensor power-cycled and restored
+      Failed,         // sensor still not responding
+      BudgetExceeded, // gave up because the time budget ran out
+    };
+
+    struct Stats
+    {
+      uint16_t faults;         // failed transactions seen by check()
+      uint16_t stuck_bus;      // times SDA or SCL was found held low
+      uint16_t bus_clears;     // clock-out/STOP sequences performed
+      uint16_t power_cycles;   // XSHUT power cycles performed
+      uint16_t restores;       // successful configuration restores
+      uint16_t failures;       // recoveries that did not succeed
+      uint16_t max_recovery_ms; // longest recovery so far
+    };
+
+    // sda_pin and scl_pin are the pins the bus uses (e.g. 18 and 19 for Wire on
+    // a Teensy 4.1); clock_hz is reapplied after the bus is restarted
+    VL53L1XRecovery(TwoWire * bus, uint8_t sda_pin, uint8_t scl_pin, uint32_t clock_hz);
+
+    void setBudget(uint16_t budget_ms) { this->budget_ms = budget_ms; }
+    uint16_t getBudget() { return budget_ms; }
+
+    // number of consecutive NACKs from the same sensor before acting
+    void setNackLimit(uint8_t limit) { nack_limit = limit; }
+    uint8_t getNackLimit() { return nack_limit; }
+
+    void setClock(uint32_t clock_hz) { this->clock_hz = clock_hz; }
+
+    Result check(VL53L1X & sensor);
+    Result recover(VL53L1X & sensor);
+    bool clearBus();
+
+    const Stats & getStats() { return stats; }
+    void resetStats() { stats = Stats(); }
+
+  private:
+
+    // I2C status codes returned by TwoWire::endTransmission()
+    static const uint8_t StatusNackAddress = 2;
+    static const uint8_t StatusNackData = 3;
+
+    // SCL half period while clocking the bus by hand (~100 kHz)
+    static const uint8_t HalfPeriodUs = 5;
+
+    // how long XSHUT is held low when power cycling; the datasheet only
+    // requires it to be low for a few hundred nanoseconds, but the carrier's
+    // pull-up and decoupling need a moment to discharge
+    static const uint16_t XshutLowUs = 500;
+
+    TwoWire * bus;
+    uint8_t sda_pin;
+    uint8_t scl_pin;
+    uint32_t clock_hz;
+
+    uint16_t budget_ms;
+    uint8_t nack_limit;
+
+    // consecutive NACKs, tracked for one sensor at a time (a sensor that has
+    // gone away NACKs every call, so another sensor's success resets it)
+    VL53L1X * nack_sensor;
+    uint8_t nack_count;
+
+    Stats stats;
+
+    bool probe(VL53L1X & sensor);
+    void releaseLine(uint8_t pin) { pinMode(pin, INPUT_PULLUP); }
+    void driveLow(uint8_t pin) { digitalWrite(pin, LOW); pinMode(pin, OUTPUT); }
+};
+
+#endif
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+// Register metadata: width, access and block of every VL53L1X register, derived
+// from the API register map (vl53l1x_register_map.h and
+// vl53l1_register_structs.h). Everything here is constexpr, so lookups on
+// constant register addresses cost nothing at run time.
+class VL53L1XRegisters
+{
+  public:
+
+    enum Access : uint8_t
+    {
+      ReadOnly,
+      ReadWrite,
+      Command, // writing has side effects, so writes must not be reordered
+    };
+
+    // register groups as defined by the API; it reads and writes each group in
+    // one transaction, and so does VL53L1XWriteQueue
+    enum Block : uint8_t
+    {
+      StaticNvmManaged,   // 0x0001-0x000C
+      CustomerNvmManaged, // 0x000D-0x0023
+      StaticConfig,       // 0x0024-0x0043
+      GeneralConfig,      // 0x0044-0x0059
+      TimingConfig,       // 0x005A-0x0070
+      DynamicConfig,      // 0x0071-0x0082
+      SystemControl,      // 0x0083-0x0087
+      SystemResults,      // 0x0088-0x00B3
+      CoreResults,        // 0x00B4-0x00D4
+      DebugResults,       // 0x00D6-0x010D
+      NvmCopyData,        // 0x010F-0x013F
+      Other,
+    };
+
+    struct Info
+    {
+      uint16_t reg;
+      uint8_t width;
+      Access access;
+      Block block;
+    };
+
+    // width of a register in bytes
+    static constexpr uint8_t width(uint16_t reg)
+    {
+      return findWidth(reg, 0, WideCount);
+    }
+
+    static constexpr Block block(uint16_t reg)
+    {
+      return (reg == 0x0000) ? Other : // SOFT_RESET
+             (reg <= 0x000C) ? StaticNvmManaged :
+             (reg <= 0x0023) ? CustomerNvmManaged :
+             (reg <= 0x0043) ? StaticConfig :
+             (reg <= 0x0059) ? GeneralConfig :
+             (reg <= 0x0070) ? TimingConfig :
+             (reg <= 0x0082) ? DynamicConfig :
+             (reg <= 0x0087) ? SystemControl :
+             (reg <= 0x00B3) ? SystemResults :
+             (reg <= 0x00D4) ? CoreResults :
+             (reg >= 0x00D6 && reg <= 0x010D) ? DebugResults :
+             (reg >= 0x010F && reg <= 0x013F) ? NvmCopyData :
+             Other;
+    }
+
+    static constexpr Access access(uint16_t reg)
+    {
+      return (reg == VL53L1X::SOFT_RESET || reg == VL53L1X::I2C_SLAVE__DEVICE_ADDRESS) ? Command :
+             (block(reg) == SystemControl) ? Command :
+             (block(reg) >= SystemResults && block(reg) <= NvmCopyData) ? ReadOnly :
+             ReadWrite;
+    }
+
+    static constexpr Info info(uint16_t reg)
+    {
+      return Info{ reg, width(reg), access(reg), block(reg) };
+    }
+
+  private:
+
+    struct Wide
+    {
+      uint16_t reg;
+      uint8_t width;
+    };
+
+    // all registers wider than one byte, sorted by address
+    static constexpr Wide wide[] =
+    {
+      { VL53L1X::OSC_MEASURED__FAST_OSC__FREQUENCY, 2 },
+      { VL53L1X::ALGO__CROSSTALK_COMPENSATION_PLANE_OFFSET_KCPS, 2 },
+      { VL53L1X::ALGO__CROSSTALK_COMPENSATION_X_PLANE_GRADIENT_KCPS, 2 },
+      { VL53L1X::ALGO__CROSSTALK_COMPENSATION_Y_PLANE_GRADIENT_KCPS, 2 },
+      { VL53L1X::REF_SPAD_CHAR__TOTAL_RATE_TARGET_MCPS, 2 },
+      { VL53L1X::ALGO__PART_TO_PART_RANGE_OFFSET_MM, 2 },
+      { VL53L1X::MM_CONFIG__INNER_OFFSET_MM, 2 },
+      { VL53L1X::MM_CONFIG__OUTER_OFFSET_MM, 2 },
+      { VL53L1X::DSS_CONFIG__TARGET_TOTAL_RATE_MCPS, 2 },
+      { VL53L1X::ALGO__RANGE_IGNORE_THRESHOLD_MCPS, 2 },
+      { VL53L1X::CAL_CONFIG__REPEAT_RATE, 2 },
+      { VL53L1X::SYSTEM__THRESH_RATE_HIGH, 2 },
+      { VL53L1X::SYSTEM__THRESH_RATE_LOW, 2 },
+      { VL53L1X::DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT, 2 },
+      { VL53L1X::MM_CONFIG__TIMEOUT_MACROP_A, 2 },
+      { VL53L1X::MM_CONFIG__TIMEOUT_MACROP_B, 2 },
+      { VL53L1X::RANGE_CONFIG__TIMEOUT_MACROP_A, 2 },
+      { VL53L1X::RANGE_CONFIG__TIMEOUT_MACROP_B, 2 },
+      { VL53L1X::RANGE_CONFIG__SIGMA_THRESH, 2 },
+      { VL53L1X::RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS, 2 },
+      { VL53L1X::SYSTEM__INTERMEASUREMENT_PERIOD, 4 },
+      { VL53L1X::SYSTEM__THRESH_HIGH, 2 },
+      { VL53L1X::SYSTEM__THRESH_LOW, 2 },
+      { VL53L1X::RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::RESULT__PEAK_SIGNAL_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::RESULT__AMBIENT_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::RESULT__SIGMA_SD0, 2 },
+      { VL53L1X::RESULT__PHASE_SD0, 2 },
+      { VL53L1X::RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD0, 2 },
+      { VL53L1X::RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0, 2 },
+      { VL53L1X::RESULT__MM_INNER_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::RESULT__MM_OUTER_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::RESULT__AVG_SIGNAL_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD1, 2 },
+      { VL53L1X::RESULT__PEAK_SIGNAL_COUNT_RATE_MCPS_SD1, 2 },
+      { VL53L1X::RESULT__AMBIENT_COUNT_RATE_MCPS_SD1, 2 },
+      { VL53L1X::RESULT__SIGMA_SD1, 2 },
+      { VL53L1X::RESULT__PHASE_SD1, 2 },
+      { VL53L1X::RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD1, 2 },
+      { VL53L1X::RESULT__SPARE_0_SD1, 2 },
+      { VL53L1X::RESULT__SPARE_1_SD1, 2 },
+      { VL53L1X::RESULT__SPARE_2_SD1, 2 },
+      { VL53L1X::RESULT_CORE__AMBIENT_WINDOW_EVENTS_SD0, 4 },
+      { VL53L1X::RESULT_CORE__RANGING_TOTAL_EVENTS_SD0, 4 },
+      { VL53L1X::RESULT_CORE__SIGNAL_TOTAL_EVENTS_SD0, 4 },
+      { VL53L1X::RESULT_CORE__TOTAL_PERIODS_ELAPSED_SD0, 4 },
+      { VL53L1X::RESULT_CORE__AMBIENT_WINDOW_EVENTS_SD1, 4 },
+      { VL53L1X::RESULT_CORE__RANGING_TOTAL_EVENTS_SD1, 4 },
+      { VL53L1X::RESULT_CORE__SIGNAL_TOTAL_EVENTS_SD1, 4 },
+      { VL53L1X::RESULT_CORE__TOTAL_PERIODS_ELAPSED_SD1, 4 },
+      { VL53L1X::PHASECAL_RESULT__REFERENCE_PHASE, 2 },
+      { VL53L1X::RESULT__OSC_CALIBRATE_VAL, 2 },
+      { VL53L1X::FIRMWARE__CAL_REPEAT_RATE_COUNTER, 2 },
+      { VL53L1X::GPH__SYSTEM__THRESH_HIGH, 2 },
+      { VL53L1X::GPH__SYSTEM__THRESH_LOW, 2 },
+      { VL53L1X::PLL_PERIOD_US, 4 },
+      { VL53L1X::INTERRUPT_SCHEDULER__DATA_OUT, 4 },
+      { VL53L1X::IDENTIFICATION__MODULE_ID, 2 },
+      { VL53L1X::MCU_UTIL_MULTIPLIER__MULTIPLICAND, 4 },
+      { VL53L1X::MCU_UTIL_MULTIPLIER__MULTIPLIER, 4 },
+      { VL53L1X::MCU_UTIL_MULTIPLIER__PRODUCT_HI, 4 },
+      { VL53L1X::MCU_UTIL_MULTIPLIER__PRODUCT_LO, 4 },
+      { VL53L1X::MCU_UTIL_DIVIDER__DIVIDEND, 4 },
+      { VL53L1X::MCU_UTIL_DIVIDER__DIVISOR, 4 },
+      { VL53L1X::MCU_UTIL_DIVIDER__QUOTIENT, 4 },
+      { VL53L1X::TIMER0__VALUE_IN, 4 },
+      { VL53L1X::TIMER1__VALUE_IN, 4 },
+      { VL53L1X::MCU_RANGE_CALC__OFFSET_CORRECTED_RANGE, 2 },
+      { VL53L1X::MCU_RANGE_CALC__SPARE_4, 4 },
+      { VL53L1X::MCU_RANGE_CALC__AMBIENT_DURATION_PRE_CALC, 2 },
+      { VL53L1X::MCU_RANGE_CALC__ALGO_TOTAL_PERIODS, 2 },
+      { VL53L1X::MCU_RANGE_CALC__ALGO_ACCUM_PHASE, 4 },
+      { VL53L1X::MCU_RANGE_CALC__ALGO_SIGNAL_EVENTS, 4 },
+      { VL53L1X::MCU_RANGE_CALC__ALGO_AMBIENT_EVENTS, 4 },
+      { VL53L1X::MCU_RANGE_CALC__SPARE_6, 2 },
+      { VL53L1X::MCU_RANGE_CALC__ALGO_ADJUST_VCSEL_PERIOD, 2 },
+      { VL53L1X::MCU_RANGE_CALC__NUM_SPADS, 2 },
+      { VL53L1X::MCU_RANGE_CALC__PHASE_OUTPUT, 2 },
+      { VL53L1X::MCU_RANGE_CALC__RATE_PER_SPAD_MCPS, 4 },
+      { VL53L1X::MCU_RANGE_CALC__PEAK_SIGNAL_RATE_MCPS, 2 },
+      { VL53L1X::MCU_RANGE_CALC__AVG_SIGNAL_RATE_MCPS, 2 },
+      { VL53L1X::MCU_RANGE_CALC__AMBIENT_RATE_MCPS, 2 },
+      { VL53L1X::MCU_RANGE_CALC__XTALK, 2 },
+      { VL53L1X::MCU_RANGE_CALC__PEAK_SIGNAL_RATE_XTALK_CORR_MCPS, 2 },
+      { VL53L1X::PATCH__JMP_ENABLES, 2 },
+      { VL53L1X::PATCH__DATA_ENABLES, 2 },
+      { VL53L1X::PATCH__OFFSET_0, 2 },
+      { VL53L1X::PATCH__OFFSET_1, 2 },
+      { VL53L1X::PATCH__OFFSET_2, 2 },
+      { VL53L1X::PATCH__OFFSET_3, 2 },
+      { VL53L1X::PATCH__OFFSET_4, 2 },
+      { VL53L1X::PATCH__OFFSET_5, 2 },
+      { VL53L1X::PATCH__OFFSET_6, 2 },
+      { VL53L1X::PATCH__OFFSET_7, 2 },
+      { VL53L1X::PATCH__OFFSET_8, 2 },
+      { VL53L1X::PATCH__OFFSET_9, 2 },
+      { VL53L1X::PATCH__OFFSET_10, 2 },
+      { VL53L1X::PATCH__OFFSET_11, 2 },
+      { VL53L1X::PATCH__OFFSET_12, 2 },
+      { VL53L1X::PATCH__OFFSET_13, 2 },
+      { VL53L1X::PATCH__OFFSET_14, 2 },
+      { VL53L1X::PATCH__OFFSET_15, 2 },
+      { VL53L1X::PATCH__ADDRESS_0, 2 },
+      { VL53L1X::PATCH__ADDRESS_1, 2 },
+      { VL53L1X::PATCH__ADDRESS_2, 2 },
+      { VL53L1X::PATCH__ADDRESS_3, 2 },
+      { VL53L1X::PATCH__ADDRESS_4, 2 },
+      { VL53L1X::PATCH__ADDRESS_5, 2 },
+      { VL53L1X::PATCH__ADDRESS_6, 2 },
+      { VL53L1X::PATCH__ADDRESS_7, 2 },
+      { VL53L1X::PATCH__ADDRESS_8, 2 },
+      { VL53L1X::PATCH__ADDRESS_9, 2 },
+      { VL53L1X::PATCH__ADDRESS_10, 2 },
+      { VL53L1X::PATCH__ADDRESS_11, 2 },
+      { VL53L1X::PATCH__ADDRESS_12, 2 },
+      { VL53L1X::PATCH__ADDRESS_13, 2 },
+      { VL53L1X::PATCH__ADDRESS_14, 2 },
+      { VL53L1X::PATCH__ADDRESS_15, 2 },
+      { VL53L1X::TEST__BIST_ROM_MCU_SIG, 2 },
+      { VL53L1X::TEST__PLL_BIST_MIN_THRESHOLD, 2 },
+      { VL53L1X::TEST__PLL_BIST_MAX_THRESHOLD, 2 },
+      { VL53L1X::TEST__PLL_BIST_COUNT_OUT, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__PEAK_SIGNAL_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__AMBIENT_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__SIGMA_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__PHASE_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__MM_INNER_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__MM_OUTER_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__AVG_SIGNAL_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__PEAK_SIGNAL_COUNT_RATE_MCPS_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__AMBIENT_COUNT_RATE_MCPS_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__SIGMA_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__PHASE_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__SPARE_0_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__SPARE_1_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__SPARE_2_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT__SPARE_3_SD1, 2 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__AMBIENT_WINDOW_EVENTS_SD0, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__RANGING_TOTAL_EVENTS_SD0, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__SIGNAL_TOTAL_EVENTS_SD0, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__TOTAL_PERIODS_ELAPSED_SD0, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__AMBIENT_WINDOW_EVENTS_SD1, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__RANGING_TOTAL_EVENTS_SD1, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__SIGNAL_TOTAL_EVENTS_SD1, 4 },
+      { VL53L1X::PREV_SHADOW_RESULT_CORE__TOTAL_PERIODS_ELAPSED_SD1, 4 },
+      { VL53L1X::GPH__SYSTEM__THRESH_RATE_HIGH, 2 },
+      { VL53L1X::GPH__SYSTEM__THRESH_RATE_LOW, 2 },
+      { VL53L1X::GPH__DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT, 2 },
+      { VL53L1X::GPH__RANGE_CONFIG__SIGMA_THRESH, 2 },
+      { VL53L1X::GPH__RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS, 2 },
+      { VL53L1X::VHV_RESULT__PEAK_SIGNAL_RATE_MCPS, 2 },
+      { VL53L1X::VHV_RESULT__SIGNAL_TOTAL_EVENTS_REF, 4 },
+      { VL53L1X::PHASECAL_RESULT__PHASE_OUTPUT_REF, 2 },
+      { VL53L1X::DSS_RESULT__TOTAL_RATE_PER_SPAD, 2 },
+      { VL53L1X::DSS_RESULT__NUM_REQUESTED_SPADS, 2 },
+      { VL53L1X::MM_RESULT__INNER_INTERSECTION_RATE, 2 },
+      { VL53L1X::MM_RESULT__OUTER_COMPLEMENT_RATE, 2 },
+      { VL53L1X::MM_RESULT__TOTAL_OFFSET, 2 },
+      { VL53L1X::XTALK_CALC__XTALK_FOR_ENABLED_SPADS, 4 },
+      { VL53L1X::XTALK_RESULT__AVG_XTALK_USER_ROI_KCPS, 4 },
+      { VL53L1X::XTALK_RESULT__AVG_XTALK_MM_INNER_ROI_KCPS, 4 },
+      { VL53L1X::XTALK_RESULT__AVG_XTALK_MM_OUTER_ROI_KCPS, 4 },
+      { VL53L1X::RANGE_RESULT__ACCUM_PHASE, 4 },
+      { VL53L1X::RANGE_RESULT__OFFSET_CORRECTED_RANGE, 2 },
+      { VL53L1X::SHADOW_RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__PEAK_SIGNAL_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__AMBIENT_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__SIGMA_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__PHASE_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__MM_INNER_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__MM_OUTER_ACTUAL_EFFECTIVE_SPADS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__AVG_SIGNAL_COUNT_RATE_MCPS_SD0, 2 },
+      { VL53L1X::SHADOW_RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__PEAK_SIGNAL_COUNT_RATE_MCPS_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__AMBIENT_COUNT_RATE_MCPS_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__SIGMA_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__PHASE_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__SPARE_0_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__SPARE_1_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT__SPARE_2_SD1, 2 },
+      { VL53L1X::SHADOW_RESULT_CORE__AMBIENT_WINDOW_EVENTS_SD0, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__RANGING_TOTAL_EVENTS_SD0, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__SIGNAL_TOTAL_EVENTS_SD0, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__TOTAL_PERIODS_ELAPSED_SD0, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__AMBIENT_WINDOW_EVENTS_SD1, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__RANGING_TOTAL_EVENTS_SD1, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__SIGNAL_TOTAL_EVENTS_SD1, 4 },
+      { VL53L1X::SHADOW_RESULT_CORE__TOTAL_PERIODS_ELAPSED_SD1, 4 },
+    };
+
+    static constexpr uint16_t WideCount = sizeof(wide) / sizeof(wide[0]);
+
+    // binary search of wide[lo, hi); single-expression so it is also a valid
+    // C++11 constexpr function
+    static constexpr uint8_t findWidth(uint16_t reg, uint16_t lo, uint16_t hi)
+    {
+      return (lo >= hi) ? 1 :
+             (wide[(lo + hi) / 2].reg == reg) ? wide[(lo + hi) / 2].width :
+             (wide[(lo + hi) / 2].reg < reg) ? findWidth(reg, (lo + hi) / 2 + 1, hi) :
+                                               findWidth(reg, lo, (lo + hi) / 2);
+    }
+};
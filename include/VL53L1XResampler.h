@@ -0,0 +1,206 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+#include "VL53L1X.h"
+
+// Resampling of several sensors' streams onto one fixed-rate timebase.
+//
+// Sensors in continuous mode each run on their own oscillator, so their
+// samples arrive at different, slowly drifting times. Push every sample with
+// the time it was read, and update() produces a frame for each tick of a
+// common timebase (period_us apart) in which every sensor's range is
+// interpolated between the samples on either side of the tick, or
+// extrapolated from its last two samples when the next one hasn't arrived.
+//
+// Frames are produced delay_us after their tick. A delay of about one sensor
+// period lets most sensors interpolate; a delay of 0 gives the freshest frames,
+// all extrapolated. Extrapolation is limited to max_extrapolation_us, after
+// which the last range is held and marked Stale.
+//
+// Lookback is bounded by the history depth: each sensor keeps its last Depth
+// samples. Every output comes with its age (tick time minus the time of the
+// newest sample at or before the tick) and how it was obtained.
+//
+// The history is stored sensor-minor ([depth][sensor]) and the per-tick work
+// is written as straight loops over all sensors with selects instead of
+// branches, so compilers can vectorize them for large arrays. The divisions
+// by sample intervals are done once per sample, in push(), which stores the
+// reciprocal of the interval to the previous sample (0.32 fixed point); ticks
+// only multiply. Timestamps are handled as differences, so micros() wrapping
+// around is fine.
+template <uint8_t N, uint8_t Depth = 4>
+class VL53L1XResampler
+{
+  public:
+
+    enum Mode : uint8_t
+    {
+      Missing,      // no usable sample, or the nearest one had no target
+      Interpolated,
+      Extrapolated,
+      Held,         // only one usable sample: its range
+      Stale,        // held beyond the extrapolation limit
+    };
+
+    static const uint16_t NoTarget = 0xFFFF;
+
+    struct Frame
+    {
+      uint32_t time_us;
+      uint16_t range_mm[N];
+      uint32_t age_us[N];
+      Mode mode[N];
+    };
+
+    VL53L1XResampler(uint32_t period_us, uint32_t delay_us, uint32_t max_extrapolation_us)
+      : period_us(period_us), delay_us(delay_us), max_extrapolation_us(max_extrapolation_us), next_tick_us(0)
+    {
+      memset(times, 0, sizeof(times));
+      memset(ranges, 0, sizeof(ranges));
+      memset(valid, 0, sizeof(valid));
+      memset(inv_gaps, 0, sizeof(inv_gaps));
+      memset(heads, 0, sizeof(heads));
+      memset(counts, 0, sizeof(counts));
+    }
+
+    // first tick of the timebase
+    void start(uint32_t first_tick_us) { next_tick_us = first_tick_us; }
+
+    void push(uint8_t sensor, uint16_t range_mm, uint8_t range_status, uint32_t timestamp_us)
+    {
+      uint8_t slot = heads[sensor];
+      uint8_t previous = (slot > 0) ? slot - 1 : Depth - 1;
+      uint32_t gap_us = timestamp_us - times[previous][sensor];
+      inv_gaps[slot][sensor] = (counts[sensor] > 0 && gap_us > 0) ? (uint32_t)(0xFFFFFFFFUL / gap_us) : 0;
+      times[slot][sensor] = timestamp_us;
+      ranges[slot][sensor] = range_mm;
+      valid[slot][sensor] = (range_status == VL53L1X::RangeValid);
+      heads[sensor] = (slot + 1 < Depth) ? slot + 1 : 0;
+      if (counts[sensor] < Depth) { counts[sensor]++; }
+    }
+
+    void push(uint8_t sensor, const VL53L1X::RangingData & data, uint32_t timestamp_us)
+    {
+      push(sensor, data.range_mm, data.range_status, timestamp_us);
+    }
+
+    // Produce the frame for the next tick once its delay has passed; returns
+    // false if it is not due yet. If the caller fell behind by more than one
+    // period, the missed ticks are skipped.
+    bool update(uint32_t now_us, Frame * frame)
+    {
+      int32_t late_us = (int32_t)(now_us - (next_tick_us + delay_us));
+      if (late_us < 0) { return false; }
+
+      if ((uint32_t)late_us >= period_us)
+      {
+        next_tick_us += (late_us / period_us) * period_us;
+      }
+
+      resample(next_tick_us, frame);
+      next_tick_us += period_us;
+      return true;
+    }
+
+    // Resample every sensor at time t_us
+    void resample(uint32_t t_us, Frame * frame)
+    {
+      // dt of the newest sample at or before t (b), the one before it (c), and
+      // the oldest one after t (a), as signed offsets from t, with their
+      // ranges (-1 if not valid) and, for b and a, the reciprocal of the
+      // interval from the sample before. They are carried along in the search
+      // so that the output loop needs no indexed loads.
+      int32_t b_dt[N], c_dt[N], a_dt[N];
+      int32_t b_r[N], c_r[N], a_r[N];
+      uint32_t b_inv[N], a_inv[N];
+
+      for (uint8_t s = 0; s < N; s++)
+      {
+        b_dt[s] = INT32_MIN; c_dt[s] = INT32_MIN; a_dt[s] = INT32_MAX;
+        b_r[s] = -1; c_r[s] = -1; a_r[s] = -1;
+        b_inv[s] = 0; a_inv[s] = 0;
+      }
+
+      for (uint8_t d = 0; d < Depth; d++)
+      {
+        for (uint8_t s = 0; s < N; s++)
+        {
+          int32_t dt = (int32_t)(times[d][s] - t_us);
+          int32_t r = (int32_t)ranges[d][s] | ((int32_t)valid[d][s] - 1); // -1 if not valid
+          uint32_t inv = inv_gaps[d][s];
+          // & rather than && so there are no branches
+          bool used = d < counts[s];
+          bool before = used & (dt <= 0);
+          bool newest = before & (dt > b_dt[s]);
+          bool second = before & !newest & (dt > c_dt[s]);
+          bool after = used & (dt > 0) & (dt < a_dt[s]);
+
+          // demote the previous newest when a newer one is found
+          c_dt[s]  = newest ? b_dt[s] : (second ? dt : c_dt[s]);
+          c_r[s]   = newest ? b_r[s]  : (second ? r  : c_r[s]);
+          b_dt[s]  = newest ? dt  : b_dt[s];
+          b_r[s]   = newest ? r   : b_r[s];
+          b_inv[s] = newest ? inv : b_inv[s];
+          a_dt[s]  = after ? dt  : a_dt[s];
+          a_r[s]   = after ? r   : a_r[s];
+          a_inv[s] = after ? inv : a_inv[s];
+        }
+      }
+
+      frame->time_us = t_us;
+
+      // b and a, and c and b, are consecutive samples, so the interval
+      // between them is the one push() stored the reciprocal of. Every case
+      // is computed and the result selected; the 64-bit products wrap
+      // harmlessly in the cases that aren't selected.
+      for (uint8_t s = 0; s < N; s++)
+      {
+        bool have_b = (b_dt[s] != INT32_MIN) & (b_r[s] >= 0);
+        bool have_c = (c_dt[s] != INT32_MIN) & (c_r[s] >= 0);
+        bool have_a = (a_dt[s] != INT32_MAX) & (a_r[s] >= 0);
+        uint32_t age = (b_dt[s] != INT32_MIN) ? (uint32_t)-b_dt[s] : 0;
+        bool stale = age > max_extrapolation_us;
+        int32_t rb = b_r[s];
+
+        // fraction of the interval from b to t, 16.16 fixed point
+        uint64_t weight_a = ((uint64_t)age * a_inv[s]) >> 16;
+        uint64_t weight_b = ((uint64_t)age * b_inv[s]) >> 16;
+        int32_t interpolated = rb + (int32_t)((int64_t)((uint64_t)(int64_t)(a_r[s] - rb) * weight_a) >> 16);
+        int32_t extrapolated = rb + (int32_t)((int64_t)((uint64_t)(int64_t)(rb - c_r[s]) * weight_b) >> 16);
+        extrapolated = (extrapolated < 0) ? 0 : extrapolated;
+        extrapolated = (extrapolated >= NoTarget) ? NoTarget - 1 : extrapolated;
+
+        // in increasing order of precedence
+        bool extrapolate = have_c & (b_inv[s] != 0);
+        uint8_t mode = Held;
+        int32_t range = rb;
+        mode = extrapolate ? (uint8_t)Extrapolated : mode;
+        range = extrapolate ? extrapolated : range;
+        mode = stale ? (uint8_t)Stale : mode;
+        range = stale ? rb : range;
+        mode = have_a ? (uint8_t)Interpolated : mode;
+        range = have_a ? interpolated : range;
+        mode = have_b ? mode : (uint8_t)Missing;
+        range = have_b ? range : (int32_t)NoTarget;
+
+        frame->range_mm[s] = range;
+        frame->age_us[s] = age;
+        frame->mode[s] = (Mode)mode;
+      }
+    }
+
+  private:
+
+    uint32_t period_us;
+    uint32_t delay_us;
+    uint32_t max_extrapolation_us;
+    uint32_t next_tick_us;
+
+    uint32_t times[Depth][N];
+    uint16_t ranges[Depth][N];
+    bool valid[Depth][N];
+    uint32_t inv_gaps[Depth][N]; // 2^32 / interval from the previous sample
+    uint8_t heads[N];
+    uint8_t counts[N];
+};
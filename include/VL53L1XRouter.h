@@ -0,0 +1,120 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1XSample.h"
+
+#if VL53L1X_FEATURE_ROUTER
+
+// Routing of samples to several outputs (text or binary serial output, an SD
+// logger, telemetry, local consumers) so that a slow one can't hold up the
+// others or the ranging loop.
+//
+// publish() hands each sample to every sink. A sink is a function taking one
+// sample, which returns false if it can't take it right now (a serial port
+// without room in its transmit buffer, a logger busy flushing); the sample
+// then stays in the sink's own bounded queue and is offered again later.
+// Sinks must never block: refusing is how they push back.
+//
+// Each sink has a priority class:
+//
+// - Critical sinks (a safety consumer) are served from publish() itself, so
+//   they see every sample before publish() returns unless they refuse it;
+// - Normal sinks are served by service();
+// - Background sinks (loggers) get what is left of service()'s time budget
+//   after the Normal ones.
+//
+// and a policy for when its queue is full:
+//
+// - DropOldest: the oldest queued sample makes room (freshest data first,
+//   for live telemetry);
+// - DropNewest: the new sample is dropped (an unbroken history up to the
+//   overload);
+// - Decimate: the sink falls back to every 2nd, then 4th, ... measurement of
+//   each sensor (by stream count), so all sensors stay covered at a lower
+//   rate; the rate steps back up each time the queue empties.
+//
+// Per-sink counters give the samples offered, delivered and dropped, refusals,
+// the queue's high-water mark, and the latency from when a reading was taken
+// (its timestamp) to its delivery.
+//
+// publish() and service() must be called from the same context (the loop);
+// producers in interrupts or other tasks can hand their samples over through a
+// VL53L1XSeqLock.
+class VL53L1XRouter
+{
+  public:
+
+    enum Policy : uint8_t { DropOldest, DropNewest, Decimate };
+    enum Priority : uint8_t { Critical, Normal, Background };
+
+    // returns false to refuse the sample (it stays queued)
+    typedef bool (*Deliver)(void * context, uint8_t sensor, const VL53L1XSample & sample);
+
+    struct Record
+    {
+      VL53L1XSample sample;
+      uint8_t sensor;
+    };
+
+    struct Stats
+    {
+      uint32_t offered;
+      uint32_t delivered;
+      uint32_t dropped;         // by the policy, including decimated samples
+      uint32_t refused;         // deliveries the sink refused
+      uint32_t latency_avg_us;  // from the reading's timestamp to delivery,
+                                // averaged over about 16 samples
+      uint32_t latency_max_us;
+      uint8_t high_water;       // most samples queued at once
+    };
+
+    struct Sink
+    {
+      Deliver deliver;
+      void * context;
+      Record * queue;
+      uint8_t capacity;
+      uint8_t head;
+      uint8_t length;
+      Policy policy;
+      Priority priority;
+      uint8_t decimation_shift; // keeping 1 in 2^shift measurements
+      Stats stats;
+    };
+
+    // sinks holds room for max_sinks sinks
+    VL53L1XRouter(Sink * sinks, uint8_t max_sinks);
+
+    // queue holds capacity Records, owned by the caller; returns the sink's
+    // index, or -1 if there is no room for it
+    int8_t addSink(Deliver deliver, void * context, Record * queue, uint8_t capacity,
+                   Policy policy, Priority priority);
+
+    // Hand a sample to every sink; never waits for a sink
+    void publish(uint8_t sensor, const VL53L1XSample & sample);
+
+    // Deliver queued samples: Critical sinks' leftovers, then Normal sinks,
+    // then Background sinks until budget_us has passed (0: no limit). One
+    // delivery can overrun the budget by however long the sink takes.
+    void service(uint16_t budget_us = 0);
+
+    const Stats & getStats(uint8_t sink) { return sinks[sink].stats; }
+    uint8_t getQueued(uint8_t sink) { return sinks[sink].length; }
+    uint8_t getDecimation(uint8_t sink) { return 1 << sinks[sink].decimation_shift; }
+    void resetStats();
+
+  private:
+
+    // at most 1 in 64 measurements; the stream count wraps from 255 to 128,
+    // so decimation by a power of two stays regular across the wrap
+    static const uint8_t MaxDecimationShift = 6;
+
+    Sink * sinks;
+    uint8_t max_sinks;
+    uint8_t sink_count;
+
+    void enqueue(Sink & sink, uint8_t sensor, const VL53L1XSample & sample);
+    bool drain(Sink & sink, uint32_t start_us, uint16_t budget_us);
+};
+
+#endif
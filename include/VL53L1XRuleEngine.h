@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_RULES
+
+// Alert rules as data.
+//
+// Each rule is a small record (see Rule) saying which sensors it applies to,
+// what condition to watch for and for how many consecutive samples. Rules are
+// added at run time, from code or over the control plane (VL53L1XControl),
+// and compile() turns them into flat per-sensor tables: one contiguous run of
+// entries per sensor holding only the rules that apply to it, with their
+// counters. evaluate() then walks just that sensor's run, doing a fixed
+// amount of integer work per entry, with no parsing or lookups; rules for
+// other sensors cost nothing, and the per-sample cost is bounded by
+// MaxRulesPerSensor however many rules there are in total.
+//
+// A rule fires once when its condition has held for `count` samples in a row
+// and re-arms when the condition clears (for range rules, when the range has
+// moved `rearm` mm back past the threshold). Alerts are queued; take them with
+// pollAlert().
+class VL53L1XRuleEngine
+{
+  public:
+
+    enum Kind : uint8_t
+    {
+      RangeBelow     = 1, // range < threshold mm (no target counts as far)
+      RangeAbove     = 2, // range > threshold mm
+      StatusIs       = 3, // range status == threshold
+      StatusChanged  = 4, // range status differs from the previous sample
+                          // (fires on every change; count is ignored)
+      ApproachFaster = 5, // closing speed > threshold mm/s
+    };
+
+    // target values, as in VL53L1XProtocol: a sensor index, a group, or all
+    static const uint8_t TargetGroup = 0x80;
+    static const uint8_t TargetAll = 0xFF;
+
+    struct Rule
+    {
+      uint8_t id;         // reported in alerts
+      Kind kind;
+      uint8_t target;
+      uint8_t count;      // consecutive samples needed (at least 1)
+      uint16_t threshold;
+      uint16_t rearm;     // hysteresis for range rules, in mm
+    };
+
+    struct Alert
+    {
+      uint8_t id;
+      uint8_t sensor;
+      uint16_t value;     // range, status or speed that fired the rule
+      uint32_t timestamp_ms;
+    };
+
+    // compiled form of a rule for one sensor
+    struct Entry
+    {
+      Kind kind;
+      uint8_t id;
+      uint8_t count;
+      uint8_t run;        // consecutive samples the condition has held
+      bool fired;
+      uint16_t threshold;
+      uint16_t rearm;
+    };
+
+    struct SensorState
+    {
+      uint16_t first;     // this sensor's entries: first to first + length
+      uint8_t length;
+      uint8_t last_status;
+      uint16_t last_range_mm;
+      uint32_t last_ms;
+      bool seen;
+    };
+
+    static const uint8_t MaxRulesPerSensor = 16;
+    static const uint8_t AlertQueueLength = 8;
+
+    // rules: room for max_rules source rules; entries: room for the compiled
+    // tables (at most max_rules * sensor_count entries are ever needed)
+    VL53L1XRuleEngine(Rule * rules, uint8_t max_rules, Entry * entries, uint16_t max_entries,
+                      SensorState * states, uint8_t sensor_count);
+
+    // sensor_groups[i] is the group of sensor i, for group targets
+    void setGroups(const uint8_t * sensor_groups) { this->sensor_groups = sensor_groups; }
+
+    // edit the rule set; changes take effect at compile()
+    void clear() { rule_count = 0; }
+    bool add(const Rule & rule);
+    uint8_t getRuleCount() { return rule_count; }
+
+    // build the per-sensor tables; returns false (keeping the previous
+    // tables) if they don't fit or a sensor would have too many rules
+    bool compile();
+
+    // add count rules (after clearing the rule set, if replace) and compile,
+    // all or nothing: returns false, leaving the rules and tables as they
+    // were, if a rule is invalid or there is no room for the result
+    bool load(const Rule * added, uint8_t count, bool replace);
+
+    // a known kind with a count of at least 1
+    static bool valid(const Rule & rule);
+
+    // returns the number of alerts raised by this sample
+    uint8_t evaluate(uint8_t sensor, uint16_t range_mm, uint8_t range_status, uint32_t now_ms);
+    uint8_t evaluate(uint8_t sensor, const VL53L1X::RangingData & data, uint32_t now_ms)
+    {
+      return evaluate(sensor, data.range_mm, data.range_status, now_ms);
+    }
+
+    bool pollAlert(Alert * alert);
+    uint16_t getDroppedAlerts() { return dropped; }
+
+  private:
+
+    Rule * rules;
+    uint8_t max_rules;
+    uint8_t rule_count;
+    Entry * entries;
+    uint16_t max_entries;
+    SensorState * states;
+    uint8_t sensor_count;
+    const uint8_t * sensor_groups;
+
+    Alert alerts[AlertQueueLength];
+    uint8_t alert_head;
+    uint8_t alert_count;
+    uint16_t dropped;
+
+    bool applies(const Rule & rule, uint8_t sensor);
+    bool fits(uint8_t kept, const Rule * added, uint8_t added_count);
+    void raise(uint8_t id, uint8_t sensor, uint16_t value, uint32_t now_ms);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+#include "VL53L1XProtocol.h"
+
+// Compact, self-contained record of one reading, for passing readings between
+// contexts (interrupts, queues, sinks) without carrying the whole VL53L1X
+// object along. Count rates are in the sensor's fixed point 9.7 format (MCPS
+// * 128) regardless of VL53L1X_FEATURE_FLOAT_RATES, so the record stays
+// integer-only and 12 bytes.
+struct VL53L1XSample
+{
+  uint32_t timestamp_us;  // micros() when the reading was taken
+  uint16_t range_mm;
+  uint16_t peak_signal_count_rate_fixed;
+  uint16_t ambient_count_rate_fixed;
+  uint8_t range_status;   // VL53L1X::RangeStatus
+  uint8_t stream_count;
+
+  // Fill from the sensor's last reading (call right after read())
+  void capture(VL53L1X & sensor, uint32_t timestamp_us)
+  {
+    this->timestamp_us = timestamp_us;
+    range_mm = sensor.ranging_data.range_mm;
+    range_status = sensor.ranging_data.range_status;
+    stream_count = sensor.getStreamCount();
+#if VL53L1X_FEATURE_FLOAT_RATES
+    // exact: the floats were converted from 9.7 fixed point in the first place
+    peak_signal_count_rate_fixed = sensor.ranging_data.peak_signal_count_rate_MCPS * (1 << 7);
+    ambient_count_rate_fixed = sensor.ranging_data.ambient_count_rate_MCPS * (1 << 7);
+#else
+    peak_signal_count_rate_fixed = sensor.ranging_data.peak_signal_count_rate_fixed;
+    ambient_count_rate_fixed = sensor.ranging_data.ambient_count_rate_fixed;
+#endif
+  }
+
+  bool valid() const { return range_status == VL53L1X::RangeValid; }
+
+  // Serialize as the payload of a VL53L1XProtocol Sample frame
+  // (VL53L1XProtocol::SampleLength bytes, little-endian)
+  void encode(uint8_t * out) const
+  {
+    VL53L1XProtocol::put32(out, timestamp_us);
+    VL53L1XProtocol::put16(out + 4, range_mm);
+    VL53L1XProtocol::put16(out + 6, peak_signal_count_rate_fixed);
+    VL53L1XProtocol::put16(out + 8, ambient_count_rate_fixed);
+    out[10] = range_status;
+    out[11] = stream_count;
+  }
+};
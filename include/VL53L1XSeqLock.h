@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+// Lock-free "latest value" storage based on sequence locks.
+//
+// A single writer (for example the interrupt handler or task that reads the
+// sensors) publishes values without ever blocking or disabling interrupts.
+// Readers copy the value and retry if a write happened in the middle of the
+// copy, so they never see a half-updated value, no matter how the value's
+// fields are laid out. Readers never block the writer; they only repeat a
+// small copy in the rare case they overlap with a write.
+//
+// There must only be one writer per object (or per VL53L1XLatestArray); use one
+// store per writer context, e.g. one per I2C bus, if several contexts produce
+// readings.
+
+// Sequence counters must be read and written in one access. 8 bits is enough
+// on an 8-bit AVR as long as a reader is not preempted for 128 writes.
+#if defined(__AVR__)
+typedef uint8_t VL53L1XSeqCount;
+#else
+typedef uint32_t VL53L1XSeqCount;
+#endif
+
+// Full memory barrier: orders the sequence counter accesses with respect to the
+// data copy (also a compiler barrier on single-core MCUs)
+inline void VL53L1XSeqBarrier() { __sync_synchronize(); }
+
+template <typename T>
+class VL53L1XSeqLock
+{
+  public:
+
+    VL53L1XSeqLock() : seq(0) { memset(&value, 0, sizeof(value)); }
+
+    // Publish a new value. Never blocks.
+    void write(const T & new_value)
+    {
+      beginWrite();
+      memcpy(&value, &new_value, sizeof(T));
+      endWrite();
+    }
+
+    // Copy the value into *out; returns false (leaving a possibly torn copy in
+    // *out) if a write was in progress or happened during the copy
+    bool tryRead(T * out) const
+    {
+      VL53L1XSeqCount start = seq;
+      if (start & 1) { return false; }
+      VL53L1XSeqBarrier();
+      memcpy(out, &value, sizeof(T));
+      VL53L1XSeqBarrier();
+      return seq == start;
+    }
+
+    // Copy the value into *out, retrying until the copy is consistent
+    void read(T * out) const
+    {
+      while (!tryRead(out)) {}
+    }
+
+    // Number of values written so far (wraps); useful for readers that only
+    // want to act on new values
+    VL53L1XSeqCount version() const { return seq >> 1; }
+
+    // for writers that fill the value in place: beginWrite(), modify
+    // *writeBuffer(), endWrite()
+    void beginWrite()
+    {
+      seq = seq + 1; // odd: write in progress
+      VL53L1XSeqBarrier();
+    }
+    T * writeBuffer() { return &value; }
+    void endWrite()
+    {
+      VL53L1XSeqBarrier();
+      seq = seq + 1; // even: stable
+    }
+
+  private:
+
+    volatile VL53L1XSeqCount seq;
+    T value; // only accessed between barriers
+};
+
+// Latest value of each of N sensors. Each slot can be read on its own, and
+// snapshot() returns all N slots as they were at a single instant (no slot
+// updated halfway through the copy). A consistent snapshot costs a copy of all
+// slots, retried only when the writer publishes during the copy.
+template <typename T, uint8_t N>
+class VL53L1XLatestArray
+{
+  public:
+
+    VL53L1XLatestArray() : seq(0) {}
+
+    // Publish the latest value of slot index. Never blocks.
+    void write(uint8_t index, const T & value)
+    {
+      seq = seq + 1;
+      VL53L1XSeqBarrier();
+      slots[index].write(value);
+      VL53L1XSeqBarrier();
+      seq = seq + 1;
+    }
+
+    bool tryRead(uint8_t index, T * out) const { return slots[index].tryRead(out); }
+    void read(uint8_t index, T * out) const { slots[index].read(out); }
+
+    // version of a single slot, to check whether it has been updated
+    VL53L1XSeqCount version(uint8_t index) const { return slots[index].version(); }
+
+    // Copy all N values into out[0..N-1] as one consistent frame
+    bool trySnapshot(T * out) const
+    {
+      VL53L1XSeqCount start = seq;
+      if (start & 1) { return false; }
+      VL53L1XSeqBarrier();
+      for (uint8_t i = 0; i < N; i++)
+      {
+        // a write in progress shows up here first, so bail out early
+        if (!slots[i].tryRead(&out[i])) { return false; }
+      }
+      VL53L1XSeqBarrier();
+      return seq == start;
+    }
+
+    void snapshot(T * out) const
+    {
+      while (!trySnapshot(out)) {}
+    }
+
+    static uint8_t size() { return N; }
+
+  private:
+
+    volatile VL53L1XSeqCount seq;
+    VL53L1XSeqLock<T> slots[N];
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_SLEEP
+
+// Low-power acquisition: sleep the MCU between measurements instead of
+// spinning in read().
+//
+// wait() puts the core to sleep (WFI on ARM, idle sleep on AVR) until a sensor
+// has a measurement ready, then returns; read() then reads each ready sensor,
+// so all of them are serviced in one pass before sleeping again. Readiness
+// comes from:
+//
+// - the sensor's GPIO1 pin, if it is wired to an MCU pin (setInterruptPin()):
+//   GPIO1 goes low when a measurement is ready (or a threshold interrupt
+//   fires) and its falling edge wakes the core; checking it costs a
+//   digitalRead() and no I2C;
+// - otherwise, a predicted ready time: the sensor's measured interval, from
+//   the time its last sample was read. The sensor is only polled over I2C once
+//   that time has come. A sample that is already there at the first poll may
+//   have been waiting, so the prediction is then shortened a little; it
+//   settles where the occasional poll comes too early, just under the actual
+//   interval.
+//
+// The core also wakes for the system tick (every millisecond with the Arduino
+// cores), which is when predicted times are checked, so a prediction is late
+// by at most a tick.
+//
+// Stats count the time spent asleep and awake since begin() or resetStats();
+// getDutyCycle() is the fraction of time awake, and service_us / samples the
+// CPU time spent per sample.
+class VL53L1XSleep
+{
+  public:
+
+    static const uint8_t NoPin = 0xFF;
+
+    struct Slot
+    {
+      uint8_t interrupt_pin;
+      bool ready;
+      bool polled_early;    // a poll found the current sample not yet ready
+      uint32_t period_us;   // measured interval between samples
+      uint32_t last_us;     // when the last sample was read
+    };
+
+    struct Stats
+    {
+      uint32_t wakes;         // wait() calls that found something ready
+      uint32_t timeouts;      // wait() calls that gave up
+      uint32_t sleeps;        // times the core went to sleep
+      uint32_t samples;
+      uint32_t early_polls;   // I2C polls of a predicted sensor that wasn't ready
+      uint32_t asleep_us;
+      uint32_t service_us;    // time spent in read()
+      uint32_t start_us;
+    };
+
+    // slots holds one Slot per sensor
+    VL53L1XSleep(VL53L1X * sensors, Slot * slots, uint8_t count);
+
+    // GPIO1 of sensor index is connected to pin; call before begin()
+    void setInterruptPin(uint8_t index, uint8_t pin) { slots[index].interrupt_pin = pin; }
+
+    // call once the sensors are ranging (others are ignored): attaches the
+    // interrupts and takes each sensor's inter-measurement period as its first
+    // predicted interval
+    void begin();
+
+    // Sleep until at least one sensor is ready or timeout_ms has passed;
+    // returns the number of sensors ready
+    uint8_t wait(uint16_t timeout_ms = 100);
+
+    // Read sensor index if wait() found it ready (VL53L1X::read(false));
+    // returns false if it wasn't
+    bool read(uint8_t index);
+
+    // true if nothing has been read from sensor index for timeout_ms
+    bool overdue(uint8_t index, uint16_t timeout_ms);
+
+    const Stats & getStats() { return stats; }
+    void resetStats();
+
+    // per mille of the time since begin() or resetStats() the core was awake
+    uint16_t getDutyCycle();
+
+  private:
+
+    // a prediction that was never early is shortened by 1/PeriodShrink of
+    // itself per sample (1.5%, about the spread of the sensors' oscillators)
+    static const uint8_t PeriodShrink = 64;
+
+    VL53L1X * sensors;
+    Slot * slots;
+    uint8_t count;
+    Stats stats;
+
+    static volatile bool woken;
+    static void onInterrupt() { woken = true; }
+
+    uint8_t collect(uint32_t now_us);
+    static void sleepUntilInterrupt();
+};
+
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_SUPERVISOR
+
+// Health supervisor for an array of VL53L1X sensors.
+//
+// Report every read to sample(). A sensor is quarantined when its stream count
+// stops advancing, it keeps reporting HardwareFail, or its reads keep timing
+// out. Quarantined sensors drop out of the schedule (active() returns false)
+// and are brought back by service(), which power-cycles them through XSHUT and
+// restores their cached configuration (VL53L1X::restoreConfig()) in small
+// non-blocking steps, backing off after each failed attempt. Sensors on one
+// bus are powered up one at a time (VL53L1X::powerOn()), since they all boot
+// at the default address. Call service() once per loop; it never waits, so healthy sensors
+// keep their rates while another sensor is recovering.
+//
+// Recovery needs each sensor's XSHUT pin and a saved configuration snapshot.
+// A sensor without them stays quarantined until rejoin() is called.
+class VL53L1XSupervisor
+{
+  public:
+
+    enum State : uint8_t
+    {
+      Healthy,
+      Quarantined, // held in shutdown, waiting for the next attempt
+      Booting,     // powered up, waiting for boot before restoring
+      Disabled,    // cannot be recovered automatically (no XSHUT or snapshot)
+    };
+
+    enum Reason : uint8_t
+    {
+      NoFault,
+      Stale,     // stream count stopped advancing
+      Hardware,  // persistent HardwareFail range status
+      Timeouts,  // repeated read timeouts or bus errors
+      Manual,    // quarantine() called
+    };
+
+    struct SensorHealth
+    {
+      State state;
+      Reason reason;          // why the sensor was last quarantined
+      uint8_t last_stream_count;
+      uint8_t stale_count;    // consecutive reads with an unchanged stream count
+      uint8_t hw_fail_count;  // consecutive HardwareFail readings
+      uint8_t timeout_count;  // consecutive timed out reads
+      uint8_t attempts;       // failed restores since quarantine
+      uint16_t state_since_ms;
+      uint16_t backoff_ms;
+      uint16_t quarantines;   // lifetime counters
+      uint16_t restores;
+    };
+
+    // health must point to count elements, owned by the caller
+    VL53L1XSupervisor(VL53L1X * sensors, SensorHealth * health, uint8_t count);
+
+    // thresholds (consecutive reads) before a sensor is quarantined
+    void setStaleLimit(uint8_t limit) { stale_limit = limit; }
+    void setHardwareFailLimit(uint8_t limit) { hw_fail_limit = limit; }
+    void setTimeoutLimit(uint8_t limit) { timeout_limit = limit; }
+
+    // delay before the first restore attempt, doubled after each failure up to
+    // the maximum
+    void setBackoff(uint16_t initial_ms, uint16_t max_ms) { backoff_initial_ms = initial_ms; backoff_max_ms = max_ms; }
+
+    void sample(uint8_t index, bool timed_out);
+    void service();
+
+    bool active(uint8_t index) { return health[index].state == Healthy; }
+    uint8_t activeCount();
+
+    void quarantine(uint8_t index, Reason reason = Manual);
+    void rejoin(uint8_t index);
+
+    const SensorHealth & getHealth(uint8_t index) { return health[index]; }
+
+  private:
+
+    // how long XSHUT is held low, and how long to wait after releasing it
+    // before talking to the sensor (datasheet tBOOT is 1.2 ms max)
+    static const uint8_t PowerOffMs = 1;
+    static const uint8_t BootMs = 2;
+
+    // bound on the boot poll in restoreConfig(); the boot should already be
+    // complete by the time it is called
+    static const uint8_t RestoreTimeoutMs = 2;
+
+    VL53L1X * sensors;
+    SensorHealth * health;
+    uint8_t count;
+
+    uint8_t stale_limit;
+    uint8_t hw_fail_limit;
+    uint8_t timeout_limit;
+    uint16_t backoff_initial_ms;
+    uint16_t backoff_max_ms;
+
+    void setState(SensorHealth & h, State state);
+    void resetCounters(SensorHealth & h);
+    void step(uint8_t index);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_TIMING
+
+// On-device timing characterization.
+//
+// The period a sensor actually delivers differs from the one it was given:
+// its oscillator is off by up to a few percent, the timing budget only
+// approximates the measurement time (VL53L1X::TimingGuard), and reads compete
+// for the bus. For each sensor in turn, and each configuration (distance mode,
+// timing budget, inter-measurement period) given to begin(), the
+// characterization ranges until it has the requested number of samples and
+// measures:
+//
+// - the data-ready period (mean, standard deviation as jitter, min and max),
+//   and its error against the nominal period, the longer of the
+//   inter-measurement period and the timing budget;
+// - measurements missed, from gaps in the stream count (a missed one doesn't
+//   count as a long period), and periods left out because the loop held up a
+//   data-ready check, so that the time it became ready isn't known;
+// - the read latency: the time of read(), that is the transfer of the results
+//   and the interrupt clear;
+// - the poll time, the cost of one data-ready check, which is also the
+//   resolution of the measured times (use setInterruptPins() for microsecond
+//   resolution);
+// - the bus occupancy: the read and one poll per measurement, as a fraction
+//   of the period. The occupancies of the sensors sharing a bus add up.
+//
+// It is poll-driven like the rest of the library: call update() as often as
+// possible (the loop should do little else meanwhile, or the times get
+// coarser) until it returns true. Each sensor gets its own configuration back
+// once its runs are done. Sensors that aren't ranging are skipped.
+class VL53L1XTiming
+{
+  public:
+
+    static const uint8_t NoPin = 0xFF;
+
+    struct Config
+    {
+      VL53L1X::DistanceMode distance_mode;
+      uint32_t budget_us;
+      uint32_t period_ms;
+    };
+
+    struct Result
+    {
+      uint32_t nominal_us;     // longer of the period and the timing budget
+      uint32_t period_us;      // mean data-ready period
+      uint32_t jitter_us;      // standard deviation of the period
+      uint32_t min_us;
+      uint32_t max_us;
+      int32_t error_ppm;       // of the mean period against the nominal one
+      uint16_t read_us;        // mean time of read()
+      uint16_t read_max_us;
+      uint16_t poll_us;        // mean time of one data-ready check
+      uint16_t busy_permille;  // bus time per period
+      uint16_t samples;        // periods measured (0: sensor skipped)
+      uint16_t missed;         // measurements lost between reads
+      uint16_t late;           // periods not measured: a data-ready check was
+                               // held up by the loop
+      uint8_t errors;          // failed reads and data-ready timeouts
+    };
+
+    // results holds count * config_count Results, sensor-major
+    VL53L1XTiming(VL53L1X * sensors, uint8_t count, Result * results);
+
+    // pins[i] is the MCU pin GPIO1 of sensor i is connected to, or NoPin:
+    // data-ready is then read from the pin instead of over I2C
+    void setInterruptPins(const uint8_t * pins) { this->pins = pins; }
+
+    // Start characterizing; configs must stay valid until done. samples is
+    // the number of periods measured per sensor and configuration.
+    void begin(const Config * configs, uint8_t config_count, uint16_t samples);
+
+    // Make progress; returns true when everything is done
+    bool update();
+    bool done() { return sensor >= count; }
+
+    const Result & getResult(uint8_t index, uint8_t config) { return results[(uint16_t)index * config_count + config]; }
+
+    // the results as a text table, one row per sensor and configuration
+    void print(Print & out);
+
+  private:
+
+    // errors (failed reads, no data ready for two nominal periods plus
+    // DataReadyMarginMs) after which a run is abandoned
+    static const uint8_t MaxErrors = 4;
+    static const uint8_t DataReadyMarginMs = 100;
+    // longest time between data-ready checks for a ready time to count
+    static const uint16_t MaxPollGapUs = 5000;
+    // measurements thrown away after each start: the first one includes the
+    // calibration done on the first read after a start
+    static const uint8_t WarmupSamples = 2;
+
+    enum Phase : uint8_t { Start, Warmup, Measure };
+
+    VL53L1X * sensors;
+    uint8_t count;
+    Result * results;
+    const uint8_t * pins;
+
+    const Config * configs;
+    uint8_t config_count;
+    uint16_t samples;
+
+    // position in the run
+    uint8_t sensor;
+    uint8_t config;
+    Phase phase;
+    uint8_t warmup;
+    uint8_t last_stream;
+    bool last_precise;
+    uint32_t last_ready_us;
+    uint32_t last_poll_us;
+    uint32_t wait_start_us;
+
+    // sums for the current run
+    int64_t sum_dev;           // period minus nominal, us
+    uint64_t sum_dev2;
+    uint32_t sum_read_us;
+    uint32_t sum_poll_us;
+    uint32_t polls;
+
+    // the sensor's own configuration, put back after its runs
+    VL53L1X::DistanceMode saved_mode;
+    uint32_t saved_budget_us;
+    uint32_t saved_period_ms;
+
+    Result & current() { return results[(uint16_t)sensor * config_count + config]; }
+    void startRun();
+    void sample(uint32_t ready_us, bool precise, uint32_t read_us);
+    void fail();
+    void finishRun();
+    void nextRun();
+    static uint8_t streamGap(uint8_t from, uint8_t to);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_TREND
+
+// Long-horizon trend monitor for optical degradation (dust or condensation on
+// the cover glass, a scratched window).
+//
+// A dirty window lowers the signal rate long before ranges start failing, but
+// the signal rate also depends on the range, so it can't be compared between
+// readings directly. For each sensor, the monitor fits
+//
+//   log2(signal) = a + b * log2(range / 1 m)
+//
+// by least squares over the valid readings of each epoch (setEpoch(), a minute
+// by default), and takes a, the signal the sensor would see from the same
+// scene at 1 m, as its optical performance for that epoch. b is pulled towards
+// -2 (inverse square), so a scene that never moves still gives a sensible a.
+//
+// Each epoch's a is added to a second, exponentially weighted regression
+// against time (covering a few hundred epochs), whose slope is how fast the
+// signal is falling; the slope only counts once it is clearly larger than the
+// noise. The epochs up to the first learn samples (setLearnSamples()) set the
+// sensor's baseline; after that, a sensor is flagged when:
+//
+// - SignalLow: the trend's current a is more than the allowed loss
+//   (setSignalLoss()) below the baseline;
+// - SignalFalling: the trend reaches that loss within the horizon
+//   (setHorizon()), so the sensor can be serviced before it fails;
+// - AmbientHigh: the ambient rate has risen well above its baseline;
+// - ValidityLow: the fraction of valid readings has dropped, in any of the
+//   range bands (below 1 m, 1-2 m, beyond).
+//
+// Only the flagged sensors need cleaning or a longer timing budget; call
+// rebaseline() after servicing one. Memory is fixed: one Track per sensor.
+class VL53L1XTrend
+{
+  public:
+
+    static const uint8_t Bands = 3;
+
+    enum Flag : uint8_t
+    {
+      SignalLow     = 1,
+      SignalFalling = 2,
+      AmbientHigh   = 4,
+      ValidityLow   = 8,
+    };
+
+    struct Track
+    {
+      // signal vs range fit of this epoch: sums of w, x, y, x*x, x*y
+      float sw, sx, sy, sxx, sxy;
+      // 1 m signal vs epoch, the newest epoch at t = 0: sums of w, t, y, t*t,
+      // t*y, y*y
+      float tw, tt, ty, ttt, tty, tyy;
+
+      float baseline;           // log2 of the 1 m signal (MCPS) at the baseline
+      float ambient;            // mean ambient rate, MCPS
+      float ambient_baseline;
+      uint16_t validity[Bands]; // fraction of valid readings, 1.0 = 0xFFFF
+      uint16_t validity_baseline[Bands];
+
+      uint32_t epoch_start_ms;
+      uint16_t samples;         // valid readings since (re)baselining, saturates
+      uint8_t band;             // of the last valid reading
+      uint8_t flags;
+      bool baselined;
+    };
+
+    // tracks must point to count elements, owned by the caller
+    VL53L1XTrend(Track * tracks, uint8_t count);
+
+    void setEpoch(uint32_t epoch_ms) { this->epoch_ms = epoch_ms; }
+    void setLearnSamples(uint16_t samples) { learn_samples = samples; }
+    // signal loss (percent of the baseline) that counts as degraded
+    void setSignalLoss(uint8_t percent);
+    // how many epochs ahead a falling trend is flagged
+    void setHorizon(uint16_t epochs) { horizon = epochs; }
+    // drop in the valid fraction, in percentage points, that counts as degraded
+    void setValidityLoss(uint8_t percent) { validity_loss = (uint32_t)percent * 0xFFFF / 100; }
+    // ambient rise, in percent of the baseline, that counts as degraded
+    void setAmbientRise(uint16_t percent) { ambient_rise = 1 + percent / 100.0f; }
+
+    // Record a reading (count rates in 9.7 fixed point); returns true if the
+    // sensor's flags changed
+    bool sample(uint8_t index, uint16_t range_mm, uint8_t range_status,
+                uint16_t signal_rate_fixed, uint16_t ambient_rate_fixed);
+    bool sample(uint8_t index, const VL53L1X::RangingData & data);
+
+    uint8_t getFlags(uint8_t index) { return tracks[index].flags; }
+    bool learning(uint8_t index) { return tracks[index].samples < learn_samples; }
+
+    // current 1 m signal as a percentage of the baseline
+    uint16_t getSignalPercent(uint8_t index);
+    // signal change per epoch, percent of the baseline (negative if falling)
+    float getTrendPercent(uint8_t index);
+    // epochs until the signal loss is reached at the current trend, or 0xFFFF
+    // if it isn't falling
+    uint16_t getEpochsToLoss(uint8_t index);
+
+    // start learning a new baseline, after cleaning the sensor for example
+    void rebaseline(uint8_t index);
+
+    const Track & getTrack(uint8_t index) { return tracks[index]; }
+
+  private:
+
+    // forgetting factor of the trend: 1 - 1 / TrendHorizon
+    static const uint16_t TrendHorizon = 256; // epochs
+    static const uint8_t AmbientShift = 8;    // readings, as a power of 2
+
+    // valid readings an epoch needs to count in the trend
+    static const uint8_t MinEpochSamples = 8;
+
+    // weight (in w * log2(range)^2) of the prior slope
+    static const uint8_t PriorWeight = 4;
+    static const int8_t PriorSlope = -2;
+
+    // ambient rates below this (MCPS) are never flagged as high
+    static const uint8_t AmbientFloor = 1;
+
+    // a trend slope counts when it is this many standard errors from 0, with
+    // at least MinEpochs epochs of data
+    static const uint8_t MinSignificance = 3;
+    static const uint8_t MinEpochs = 8;
+
+    Track * tracks;
+    uint8_t count;
+
+    uint32_t epoch_ms;
+    uint16_t learn_samples;
+    uint16_t horizon;
+    uint16_t validity_loss;
+    float signal_loss;     // log2 of the remaining fraction
+    float ambient_rise;    // factor
+
+    float signalAt1m(const Track & t);
+    bool fitTrend(const Track & t, float * slope, float * level);
+    void endEpoch(Track & t);
+    uint8_t evaluate(Track & t);
+    static uint8_t bandOf(uint16_t range_mm);
+};
+
+#endif
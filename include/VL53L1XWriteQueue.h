@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+#include "VL53L1XRegisters.h"
+
+// Coalescing write queue for VL53L1X register writes.
+//
+// While a queue exists for a sensor, its writeReg(), writeReg16Bit() and
+// writeReg32Bit() calls are collected instead of being sent one transaction
+// each. On flush() (or when the queue goes out of scope), the pending bytes are
+// sorted by address and sent as the fewest bursts possible: consecutive
+// registers within the same API register block go out in one transaction.
+// Later writes to the same register replace earlier ones.
+//
+// Reads stay coherent: a read of registers that are all pending is answered
+// from the queue, and any other read flushes the queue first. Writes to
+// Command registers (VL53L1XRegisters::access()), such as SYSTEM__MODE_START,
+// flush the queue and are then sent immediately, so they keep their order
+// relative to everything written before them.
+//
+// Typical use is a local at the top of a configuration function:
+//
+//   VL53L1XWriteQueue queue(sensor);
+//   sensor.writeReg(...);
+//   ...
+//   // flushed here
+//
+// Queues nest: a queue created while another is active for the same sensor
+// defers to the outer one.
+class VL53L1XWriteQueue
+{
+  public:
+
+    explicit VL53L1XWriteQueue(VL53L1X & sensor);
+    ~VL53L1XWriteQueue();
+
+    // logical register write; the width comes from the register metadata
+    void write(uint16_t reg, uint32_t value);
+
+    // send all pending writes; returns false if a transaction failed, in
+    // which case the writes that weren't sent stay queued for the next flush
+    // (a write that then finds the queue still full is sent directly)
+    bool flush();
+
+    uint8_t pendingBytes() { return count; }
+
+    // bursts sent by this queue so far
+    uint16_t getTransactions() { return transactions; }
+
+  private:
+
+    friend class VL53L1X;
+
+    // pending register bytes; large enough for all of init()
+    static const uint8_t Capacity = 64;
+
+    VL53L1X & sensor;
+    bool owner;
+
+    uint8_t count;
+    uint16_t regs[Capacity];  // sorted, unique
+    uint8_t values[Capacity];
+
+    uint16_t transactions;
+
+    bool add(uint16_t reg, uint32_t value, uint8_t width);
+    bool pending(uint16_t reg, uint8_t width, uint32_t * value);
+    void addByte(uint16_t reg, uint8_t value);
+    void removeBytes(uint16_t reg, uint8_t width);
+};
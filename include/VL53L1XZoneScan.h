@@ -0,0 +1,132 @@
+#pragma once
+
+#include <Arduino.h>
+#include "VL53L1X.h"
+
+#if VL53L1X_FEATURE_ZONE_SCAN
+
+// Adaptive multi-zone scanning with one sensor.
+//
+// A fixed scan of a 4x4 grid of 4x4-SPAD zones takes 16 measurements per
+// frame, most of them of empty space. This scanner works on a two-level
+// quadtree instead:
+//
+// 1. a coarse pass measures the four 8x8-SPAD quadrants
+// 2. quadrants that saw a target, are nearer than a neighbouring quadrant by
+//    more than the discontinuity threshold (an edge), or changed since the
+//    previous frame are candidates for refinement, ranked by a change score
+// 3. the best candidates, up to the refinement budget, are measured again as
+//    four 4x4-SPAD zones each
+//
+// Cells of quadrants that were not refined take the quadrant's coarse range,
+// so every frame has a full 4x4 grid, with the resolution of each cell
+// reported. A candidate that misses out on refinement gains score each frame,
+// so busy scenes still get every target refined regularly. An empty scene
+// costs 4 measurements per frame; a full refinement 20.
+//
+// The grid is in the orientation of the SPAD table above
+// VL53L1X::setROICenter(): row 0 is the row containing SPAD 128, column 0 the
+// column containing SPAD 128. The lens inverts the scene, so that corner
+// sees the lower right of the field of view, looking into the sensor.
+//
+// As with VL53L1XGesture, each ROI is programmed while the previous
+// measurement's result is read, so the period must leave a gap between
+// measurements (startContinuous(budget_ms + 2) or more) and update() has to
+// read each result within it. Results that don't follow the previous one in
+// stream count belong to an unknown zone: they are dropped and the zone is
+// measured again (getResyncs()). Call update() from loop(); it never waits for
+// the sensor.
+class VL53L1XZoneScan
+{
+  public:
+
+    static const uint8_t GridSize = 4;
+    static const uint8_t CellCount = GridSize * GridSize;
+    static const uint8_t QuadrantCount = 4;
+    static const uint8_t MaxMeasurements = QuadrantCount + QuadrantCount * 4;
+
+    // range of a cell with no target
+    static const uint16_t NoTarget = 0xFFFF;
+
+    struct Frame
+    {
+      uint16_t range_mm[CellCount];  // row-major, NoTarget if none
+      uint8_t level[CellCount];      // 1: from the 8x8 quadrant, 2: 4x4 zone
+      uint32_t timestamp_ms;         // when the last measurement was read
+      uint16_t duration_ms;          // first to last measurement of the frame
+      uint8_t measurements;
+      uint8_t refined;               // bitmask of refined quadrants
+    };
+
+    VL53L1XZoneScan(VL53L1X & sensor);
+
+    // quadrants refined per frame at most (0-4)
+    void setRefineBudget(uint8_t quadrants) { refine_budget = (quadrants > QuadrantCount) ? QuadrantCount : quadrants; }
+
+    // targets beyond max_range_mm don't need refining; quadrants whose ranges
+    // differ by more than discontinuity_mm do
+    void setThresholds(uint16_t max_range_mm, uint16_t discontinuity_mm) { this->max_range_mm = max_range_mm; this->discontinuity_mm = discontinuity_mm; }
+
+    // programs the first quadrant; call with the sensor initialized and before
+    // starting continuous ranging (otherwise the first result is dropped)
+    void begin();
+
+    // returns true when a frame has been completed, available from getFrame()
+    bool update();
+    bool process(uint16_t range_mm, uint8_t range_status, uint32_t now_ms);
+
+    const Frame & getFrame() { return frame; }
+
+    // ROI for the measurement the next sample belongs to
+    uint8_t getCurrentCenter() { return center(plan[step]); }
+    uint8_t getCurrentSize() { return size(plan[step]); }
+
+    // results dropped because their zone wasn't known
+    uint16_t getResyncs() { return resyncs; }
+
+    // SPAD number at the center of a width x height ROI with its corner
+    // (lowest row and column numbers) at row, column of the SPAD table
+    static uint8_t roiCenter(uint8_t row, uint8_t column, uint8_t width, uint8_t height);
+
+  private:
+
+    // zone ids in the plan: 0-3 quadrants, 4-19 cells (4 + row * 4 + column)
+    static const uint8_t FirstCell = QuadrantCount;
+
+    struct Quadrant
+    {
+      uint16_t range_mm;
+      uint16_t previous_mm;
+      uint16_t waiting;       // frames as a candidate without being refined
+    };
+
+    VL53L1X & sensor;
+
+    uint8_t refine_budget;
+    uint16_t max_range_mm;
+    uint16_t discontinuity_mm;
+
+    Quadrant quadrants[QuadrantCount];
+    uint16_t cells[CellCount];
+
+    uint8_t plan[MaxMeasurements];
+    uint8_t plan_length;
+    uint8_t step;
+    uint8_t refined;
+    uint32_t frame_start_ms;
+
+    // stream count the next result should have (-1: any)
+    bool synced;
+    int16_t expected_stream;
+    uint16_t resyncs;
+
+    Frame frame;
+
+    static uint8_t center(uint8_t zone);
+    static uint8_t size(uint8_t zone);
+    void program();
+    void refine();
+    void finishFrame(uint32_t now_ms);
+};
+
+#endif
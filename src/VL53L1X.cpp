@@ -4,6 +4,12 @@
 // VL53L1X datasheet.
 
 #include "VL53L1X.h"
+#include "VL53L1XWriteQueue.h"
+#include "VL53L1XBusLock.h"
+
+#if VL53L1X_FEATURE_RESTORE
+VL53L1X * VL53L1X::booting[VL53L1X::MaxBootingBuses];
+#endif
 
 // Constructors ////////////////////////////////////////////////////////////////
 
@@ -13,12 +19,21 @@ VL53L1X::VL53L1X()
 #else
   : bus(nullptr)
 #endif
-  , address(AddressDefault)
+  , queue(nullptr)
+#if VL53L1X_FEATURE_RESTORE
+  , config_cache(nullptr)
+#endif
   , io_timeout(0) // no timeout
-  , did_timeout(false)
-  , calibrated(false)
+  , address(AddressDefault)
+  , stream_count(0)
   , saved_vhv_init(0)
   , saved_vhv_timeout(0)
+#if VL53L1X_FEATURE_RESTORE
+  , xshut_pin(NoPin)
+#endif
+  , did_timeout(false)
+  , calibrated(false)
+  , continuous_active(false)
   , distance_mode(Unknown)
 {
 }
@@ -29,6 +44,9 @@ void VL53L1X::setAddress(uint8_t new_addr)
 {
   writeReg(I2C_SLAVE__DEVICE_ADDRESS, new_addr & 0x7F);
   address = new_addr;
+#if VL53L1X_FEATURE_RESTORE
+  if (last_status == 0) { endBoot(); }
+#endif
 }
 
 // Initialize sensor using settings taken mostly from VL53L1_DataInit() and
@@ -39,6 +57,8 @@ int VL53L1X::init(bool io_2v8)
 {
   // check model ID and module type registers (values specified in datasheet)
   uint16_t res = readReg16Bit(IDENTIFICATION__MODEL_ID);
+  // nothing answered: don't mistake the bytes the failed read returned for an ID
+  if (last_status != 0) { return -(int)last_status; }
   if (res != 0xEACC) { return res; }
 
   // VL53L1_software_reset() begin
@@ -55,10 +75,12 @@ int VL53L1X::init(bool io_2v8)
 
   startTimeout();
 
-  // check last_status in case we still get a NACK to try to deal with it correctly
+  // check last_status in case we still get a NACK to try to deal with it correctly;
+  // without an I/O timeout, still give up after the API's boot timeout in case
+  // the device went away
   while ((readReg(FIRMWARE__SYSTEM_STATUS) & 0x01) == 0 || last_status != 0)
   {
-    if (checkTimeoutExpired())
+    if (checkTimeoutExpired() || (io_timeout == 0 && (uint16_t)(millis() - timeout_start_ms) > BootTimeoutMs))
     {
       did_timeout = true;
       return 2;
@@ -68,6 +90,9 @@ int VL53L1X::init(bool io_2v8)
 
   // VL53L1_software_reset() end
 
+  // collect the configuration writes below and send them as a few bursts
+  VL53L1XWriteQueue batch(*this);
+
   // VL53L1_DataInit() begin
 
   // sensor uses 1V8 mode for I/O by default; switch to 2V8 mode if necessary
@@ -162,6 +187,9 @@ int VL53L1X::init(bool io_2v8)
 // Write an 8-bit register
 void VL53L1X::writeReg(uint16_t reg, uint8_t value)
 {
+  if (queue != nullptr && queue->add(reg, value, 1)) { return; }
+
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(reg >> 8)); // reg high byte
   bus->write((uint8_t)(reg));      // reg low byte
@@ -172,6 +200,9 @@ void VL53L1X::writeReg(uint16_t reg, uint8_t value)
 // Write a 16-bit register
 void VL53L1X::writeReg16Bit(uint16_t reg, uint16_t value)
 {
+  if (queue != nullptr && queue->add(reg, value, 2)) { return; }
+
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(reg >> 8)); // reg high byte
   bus->write((uint8_t)(reg));      // reg low byte
@@ -183,6 +214,9 @@ void VL53L1X::writeReg16Bit(uint16_t reg, uint16_t value)
 // Write a 32-bit register
 void VL53L1X::writeReg32Bit(uint16_t reg, uint32_t value)
 {
+  if (queue != nullptr && queue->add(reg, value, 4)) { return; }
+
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(reg >> 8)); // reg high byte
   bus->write((uint8_t)(reg));      // reg low byte
@@ -196,8 +230,16 @@ void VL53L1X::writeReg32Bit(uint16_t reg, uint32_t value)
 // Read an 8-bit register
 uint8_t VL53L1X::readReg(regAddr reg)
 {
+  if (queue != nullptr)
+  {
+    uint32_t pending_value;
+    if (queue->pending(reg, 1, &pending_value)) { return pending_value; }
+    queue->flush();
+  }
+
   uint8_t value;
 
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(reg >> 8)); // reg high byte
   bus->write((uint8_t)(reg));      // reg low byte
@@ -212,8 +254,16 @@ uint8_t VL53L1X::readReg(regAddr reg)
 // Read a 16-bit register
 uint16_t VL53L1X::readReg16Bit(uint16_t reg)
 {
+  if (queue != nullptr)
+  {
+    uint32_t pending_value;
+    if (queue->pending(reg, 2, &pending_value)) { return pending_value; }
+    queue->flush();
+  }
+
   uint16_t value;
 
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(reg >> 8)); // reg high byte
   bus->write((uint8_t)(reg));      // reg low byte
@@ -229,8 +279,16 @@ uint16_t VL53L1X::readReg16Bit(uint16_t reg)
 // Read a 32-bit register
 uint32_t VL53L1X::readReg32Bit(uint16_t reg)
 {
+  if (queue != nullptr)
+  {
+    uint32_t pending_value;
+    if (queue->pending(reg, 4, &pending_value)) { return pending_value; }
+    queue->flush();
+  }
+
   uint32_t value;
 
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(reg >> 8)); // reg high byte
   bus->write((uint8_t)(reg));      // reg low byte
@@ -245,10 +303,63 @@ uint32_t VL53L1X::readReg32Bit(uint16_t reg)
   return value;
 }
 
+// Write an arbitrary number of bytes to consecutive registers, split into as
+// few transactions as the Wire buffer allows
+void VL53L1X::writeMulti(uint16_t reg, const uint8_t * src, uint8_t count)
+{
+  VL53L1XBusGuard guard(bus);
+
+  while (count > 0)
+  {
+    uint8_t chunk = (count > MaxBurstLength) ? MaxBurstLength : count;
+
+    bus->beginTransmission(address);
+    bus->write((uint8_t)(reg >> 8)); // reg high byte
+    bus->write((uint8_t)(reg));      // reg low byte
+    bus->write(src, chunk);
+    last_status = bus->endTransmission();
+    if (last_status != 0) { return; }
+
+    reg += chunk;
+    src += chunk;
+    count -= chunk;
+  }
+}
+
+// Read an arbitrary number of bytes from consecutive registers into dst
+void VL53L1X::readMulti(uint16_t reg, uint8_t * dst, uint8_t count)
+{
+  if (queue != nullptr) { queue->flush(); }
+
+  VL53L1XBusGuard guard(bus);
+
+  while (count > 0)
+  {
+    uint8_t chunk = (count > MaxBurstLength) ? MaxBurstLength : count;
+
+    bus->beginTransmission(address);
+    bus->write((uint8_t)(reg >> 8)); // reg high byte
+    bus->write((uint8_t)(reg));      // reg low byte
+    last_status = bus->endTransmission();
+    if (last_status != 0) { return; }
+
+    bus->requestFrom(address, chunk);
+    for (uint8_t i = 0; i < chunk; i++)
+    {
+      *dst++ = bus->read();
+    }
+
+    reg += chunk;
+    count -= chunk;
+  }
+}
+
 // set distance mode to Short, Medium, or Long
 // based on VL53L1_SetDistanceMode()
 bool VL53L1X::setDistanceMode(DistanceMode mode)
 {
+  VL53L1XWriteQueue batch(*this);
+
   // save existing timing budget
   uint32_t budget_us = getMeasurementTimingBudget();
 
@@ -326,6 +437,8 @@ bool VL53L1X::setMeasurementTimingBudget(uint32_t budget_us)
 
   if (budget_us <= TimingGuard) { return false; }
 
+  VL53L1XWriteQueue batch(*this);
+
   uint32_t range_config_timeout_us = budget_us -= TimingGuard;
   if (range_config_timeout_us > 1100000) { return false; } // FDA_MAX_TIMING_BUDGET_US * 2
 
@@ -376,6 +489,22 @@ bool VL53L1X::setMeasurementTimingBudget(uint32_t budget_us)
   return true;
 }
 
+// Set the inter-measurement period in milliseconds used by continuous ranging.
+// Takes effect the next time ranging is started.
+// based on VL53L1_set_inter_measurement_period_ms()
+void VL53L1X::setInterMeasurementPeriod(uint32_t period_ms)
+{
+  writeReg32Bit(SYSTEM__INTERMEASUREMENT_PERIOD, period_ms * osc_calibrate_val);
+}
+
+// Get the inter-measurement period in milliseconds
+// based on VL53L1_get_inter_measurement_period_ms()
+uint32_t VL53L1X::getInterMeasurementPeriod()
+{
+  if (osc_calibrate_val == 0) { return 0; }
+  return readReg32Bit(SYSTEM__INTERMEASUREMENT_PERIOD) / osc_calibrate_val;
+}
+
 // Get the measurement timing budget in microseconds
 // based on VL53L1_SetMeasurementTimingBudgetMicroSeconds()
 uint32_t VL53L1X::getMeasurementTimingBudget()
@@ -405,6 +534,8 @@ uint32_t VL53L1X::getMeasurementTimingBudget()
 // reading that document carefully.
 void VL53L1X::setROISize(uint8_t width, uint8_t height)
 {
+  VL53L1XWriteQueue batch(*this);
+
   if ( width > 16) {  width = 16; }
   if (height > 16) { height = 16; }
 
@@ -490,15 +621,38 @@ uint8_t VL53L1X::getROICenter()
   return readReg(ROI_CONFIG__USER_ROI_CENTRE_SPAD);
 }
 
+// Set the range offset in millimeters, which the sensor adds to every range it
+// reports (from -1024 to 1023). This replaces the part-to-part offset
+// calibrated at the factory, so to adjust it, add to getOffset().
+// based on VL53L1X_SetOffset() from STSW-IMG009 Ultra Lite Driver
+void VL53L1X::setOffset(int16_t offset_mm)
+{
+  VL53L1XWriteQueue batch(*this);
+
+  writeReg16Bit(ALGO__PART_TO_PART_RANGE_OFFSET_MM, offset_mm * 4);
+  writeReg16Bit(MM_CONFIG__INNER_OFFSET_MM, 0);
+  writeReg16Bit(MM_CONFIG__OUTER_OFFSET_MM, 0);
+}
+
+// Get the range offset in millimeters
+// based on VL53L1X_GetOffset() from STSW-IMG009 Ultra Lite Driver
+int16_t VL53L1X::getOffset()
+{
+  // 13-bit signed value in units of 1/4 mm
+  int16_t offset = readReg16Bit(ALGO__PART_TO_PART_RANGE_OFFSET_MM) << 3;
+  return offset >> 5;
+}
+
 // Start continuous ranging measurements, with the given inter-measurement
 // period in milliseconds determining how often the sensor takes a measurement.
 void VL53L1X::startContinuous(uint32_t period_ms)
 {
-  // from VL53L1_set_inter_measurement_period_ms()
-  writeReg32Bit(SYSTEM__INTERMEASUREMENT_PERIOD, period_ms * osc_calibrate_val);
+  setInterMeasurementPeriod(period_ms);
 
   writeReg(SYSTEM__INTERRUPT_CLEAR, 0x01); // sys_interrupt_clear_range
   writeReg(SYSTEM__MODE_START, 0x40); // mode_range__timed
+
+  continuous_active = true;
 }
 
 // Stop continuous measurements
@@ -507,6 +661,10 @@ void VL53L1X::stopContinuous()
 {
   writeReg(SYSTEM__MODE_START, 0x80); // mode_range__abort
 
+  continuous_active = false;
+
+  VL53L1XWriteQueue batch(*this);
+
   // VL53L1_low_power_auto_data_stop_range() begin
 
   calibrated = false;
@@ -536,10 +694,16 @@ uint16_t VL53L1X::read(bool blocking)
 {
   if (blocking)
   {
+    uint8_t bus_errors = 0;
+
     startTimeout();
     while (!dataReady())
     {
-      if (checkTimeoutExpired())
+      // a sensor that keeps NACKing or a stuck bus won't recover by itself, so
+      // give up early and let the caller recover it (see VL53L1XRecovery)
+      // instead of stalling everything else on the bus until io_timeout
+      bus_errors = (last_status != 0) ? bus_errors + 1 : 0;
+      if (checkTimeoutExpired() || bus_errors >= MaxBusErrors)
       {
         did_timeout = true;
         return 0;
@@ -547,7 +711,9 @@ uint16_t VL53L1X::read(bool blocking)
     }
   }
 
-  readResults();
+  ResultBuffer results;
+  readResults(results);
+  stream_count = results.stream_count;
 
   if (!calibrated)
   {
@@ -555,9 +721,9 @@ uint16_t VL53L1X::read(bool blocking)
     calibrated = true;
   }
 
-  updateDSS();
+  updateDSS(results);
 
-  getRangingData();
+  getRangingData(results);
 
   writeReg(SYSTEM__INTERRUPT_CLEAR, 0x01); // sys_interrupt_clear_range
 
@@ -582,6 +748,7 @@ uint16_t VL53L1X::readSingle(bool blocking)
   }
 }
 
+#if VL53L1X_FEATURE_STATUS_STRINGS
 // convert a RangeStatus to a readable string
 // Note that on an AVR, these strings are stored in RAM (dynamic memory), which
 // makes working with them easier but uses up 200+ bytes of RAM (many AVR-based
@@ -631,6 +798,7 @@ const char * VL53L1X::rangeStatusToString(RangeStatus status)
       return "unknown status";
   }
 }
+#endif
 
 // Did a timeout occur in one of the read functions since the last call to
 // timeoutOccurred()?
@@ -641,6 +809,142 @@ bool VL53L1X::timeoutOccurred()
   return tmp;
 }
 
+#if VL53L1X_FEATURE_RESTORE
+// Hold the sensor in shutdown by driving XSHUT low. Returns false if no XSHUT
+// pin has been set.
+bool VL53L1X::powerOff()
+{
+  if (xshut_pin == NoPin) { return false; }
+
+  digitalWrite(xshut_pin, LOW);
+  pinMode(xshut_pin, OUTPUT);
+  // continuous_active is left alone so restoreConfig() resumes ranging
+  calibrated = false;
+  endBoot();
+  return true;
+}
+
+// Stop driving XSHUT low so the carrier board can pull it high. (We do NOT
+// want to drive XSHUT high since it is not level shifted.) The sensor boots at
+// the default address; restoreConfig() or init() and setAddress() must follow.
+bool VL53L1X::powerOn()
+{
+  if (xshut_pin == NoPin) { return false; }
+
+  for (uint8_t i = 0; i < MaxBootingBuses; i++)
+  {
+    if (booting[i] != nullptr && booting[i] != this && booting[i]->bus == bus) { return false; }
+  }
+
+  endBoot();
+  for (uint8_t i = 0; i < MaxBootingBuses; i++)
+  {
+    // with sensors booting on more buses than there are slots, the extra ones
+    // go untracked
+    if (booting[i] == nullptr)
+    {
+      booting[i] = this;
+      break;
+    }
+  }
+
+  pinMode(xshut_pin, INPUT);
+  return true;
+}
+
+// Save the current configuration into the cache given to setConfigCache() so
+// restoreConfig() can bring the sensor back after a reset or power cycle
+// without going through init() again. Call this once the sensor is fully
+// configured (distance mode, timing budget, ROI, etc.), and again after
+// changing any of those settings.
+bool VL53L1X::saveConfig()
+{
+  if (config_cache == nullptr) { return false; }
+
+  config_cache->valid = false;
+
+  readMulti(ConfigOffsetsStart, config_cache->offsets, ConfigOffsetsLength);
+  if (last_status != 0) { return false; }
+  readMulti(ConfigBlockStart, config_cache->config, ConfigBlockLength);
+  if (last_status != 0) { return false; }
+
+  // if the snapshot was taken while ranging, it contains the phasecal override
+  // from setupManualCalibration(); remove it the same way stopContinuous()
+  // does so the first range after a restore recalibrates (the VHV registers
+  // it also changes are not part of the snapshot)
+  config_cache->config[PHASECAL_CONFIG__OVERRIDE - ConfigBlockStart] = 0x00;
+
+  config_cache->address = address;
+  config_cache->valid = true;
+  return true;
+}
+
+// Fast restore after a power cycle or reset: wait for the sensor to boot at the
+// default address, write back the cached configuration in a few bursts,
+// reassign its address and resume continuous ranging if it was running. This
+// takes a few milliseconds, compared to the dozens of transactions init()
+// needs. Returns false if the sensor did not come up within timeout_ms or
+// there is no valid snapshot.
+bool VL53L1X::restoreConfig(uint16_t timeout_ms)
+{
+  if (config_cache == nullptr || !config_cache->valid) { return false; }
+
+  bool resume = continuous_active;
+  uint16_t saved_timeout = io_timeout;
+
+  address = AddressDefault;
+  calibrated = false;
+  continuous_active = false;
+
+  // VL53L1_poll_for_boot_completion(), bounded by timeout_ms even if the
+  // sensor never ACKs
+  io_timeout = timeout_ms;
+  startTimeout();
+  while ((readReg(FIRMWARE__SYSTEM_STATUS) & 0x01) == 0 || last_status != 0)
+  {
+    if (checkTimeoutExpired())
+    {
+      io_timeout = saved_timeout;
+      did_timeout = true;
+      return false;
+    }
+  }
+  io_timeout = saved_timeout;
+
+  writeMulti(ConfigOffsetsStart, config_cache->offsets, ConfigOffsetsLength);
+  if (last_status != 0) { return false; }
+  writeMulti(ConfigBlockStart, config_cache->config, ConfigBlockLength);
+  if (last_status != 0) { return false; }
+
+  if (config_cache->address != AddressDefault)
+  {
+    setAddress(config_cache->address);
+    if (last_status != 0) { return false; }
+  }
+
+  if (resume)
+  {
+    // the inter-measurement period is part of the snapshot
+    writeReg(SYSTEM__INTERRUPT_CLEAR, 0x01); // sys_interrupt_clear_range
+    writeReg(SYSTEM__MODE_START, 0x40); // mode_range__timed
+    continuous_active = true;
+  }
+
+  // done booting even if the snapshot keeps the default address
+  if (last_status == 0) { endBoot(); }
+  return last_status == 0;
+}
+
+// Give up this sensor's claim to its bus's boot slot (see powerOn())
+void VL53L1X::endBoot()
+{
+  for (uint8_t i = 0; i < MaxBootingBuses; i++)
+  {
+    if (booting[i] == this) { booting[i] = nullptr; }
+  }
+}
+#endif
+
 // Private Methods /////////////////////////////////////////////////////////////
 
 // "Setup ranges after the first one in low power auto mode by turning off
@@ -648,6 +952,8 @@ bool VL53L1X::timeoutOccurred()
 // based on VL53L1_low_power_auto_setup_manual_calibration()
 void VL53L1X::setupManualCalibration()
 {
+  VL53L1XWriteQueue batch(*this);
+
   // "save original vhv configs"
   saved_vhv_init = readReg(VHV_CONFIG__INIT);
   saved_vhv_timeout = readReg(VHV_CONFIG__TIMEOUT_MACROP_LOOP_BOUND);
@@ -665,8 +971,9 @@ void VL53L1X::setupManualCalibration()
 }
 
 // read measurement results into buffer
-void VL53L1X::readResults()
+void VL53L1X::readResults(ResultBuffer & results)
 {
+  VL53L1XBusGuard guard(bus);
   bus->beginTransmission(address);
   bus->write((uint8_t)(RESULT__RANGE_STATUS >> 8)); // reg high byte
   bus->write((uint8_t)(RESULT__RANGE_STATUS));      // reg low byte
@@ -704,7 +1011,7 @@ void VL53L1X::readResults()
 
 // perform Dynamic SPAD Selection calculation/update
 // based on VL53L1_low_power_auto_update_DSS()
-void VL53L1X::updateDSS()
+void VL53L1X::updateDSS(const ResultBuffer & results)
 {
   uint16_t spadCount = results.dss_actual_effective_spads_sd0;
 
@@ -750,7 +1057,7 @@ void VL53L1X::updateDSS()
 
 // get range, status, rates from results buffer
 // based on VL53L1_GetRangingMeasurementData()
-void VL53L1X::getRangingData()
+void VL53L1X::getRangingData(const ResultBuffer & results)
 {
   // VL53L1_copy_sys_and_core_results_to_range_results() begin
 
@@ -826,10 +1133,16 @@ void VL53L1X::getRangingData()
   }
 
   // from SetSimpleData()
+#if VL53L1X_FEATURE_FLOAT_RATES
   ranging_data.peak_signal_count_rate_MCPS =
     countRateFixedToFloat(results.peak_signal_count_rate_crosstalk_corrected_mcps_sd0);
   ranging_data.ambient_count_rate_MCPS =
     countRateFixedToFloat(results.ambient_count_rate_mcps_sd0);
+#else
+  ranging_data.peak_signal_count_rate_fixed =
+    results.peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+  ranging_data.ambient_count_rate_fixed = results.ambient_count_rate_mcps_sd0;
+#endif
 }
 
 // Decode sequence step timeout in MCLKs from register value
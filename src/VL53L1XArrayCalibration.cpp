@@ -0,0 +1,200 @@
+#include "VL53L1XArrayCalibration.h"
+
+#if VL53L1X_FEATURE_ARRAY_CALIBRATION
+
+#include <math.h>
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XArrayCalibration::VL53L1XArrayCalibration(VL53L1X * sensors, uint8_t count, Cell * cells, Result * results)
+  : sensors(sensors)
+  , count(count)
+  , cells(cells)
+  , results(results)
+  , pose_count(0)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    results[i].offset_mm = 0;
+    results[i].scale_q14 = 16384;
+    results[i].residual_mm = 0;
+    results[i].geometry_mm = 0;
+  }
+  reset();
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XArrayCalibration::reset()
+{
+  pose_count = 0;
+  for (uint16_t i = 0; i < (uint16_t)count * MaxPoses; i++)
+  {
+    cells[i].sum_mm = 0;
+    cells[i].count = 0;
+  }
+}
+
+bool VL53L1XArrayCalibration::beginPose(uint16_t known_mm)
+{
+  if (pose_count >= MaxPoses) { return false; }
+  this->known_mm[pose_count++] = known_mm;
+  return true;
+}
+
+void VL53L1XArrayCalibration::add(uint8_t sensor, uint16_t range_mm, uint8_t range_status)
+{
+  if (pose_count == 0 || range_status != VL53L1X::RangeValid) { return; }
+
+  Cell & c = cell(sensor, pose_count - 1);
+  if (c.count == 0xFFFF) { return; }
+  c.sum_mm += range_mm;
+  c.count++;
+}
+
+// Alternating least squares: with the sensors' scales and offsets fixed, each
+// unknown pose distance is the average of what the sensors say it is; with
+// the distances fixed, each sensor's scale and offset are a straight line fit
+// of its readings against them. A few rounds converge for the small errors
+// involved. Without known distances, the fit can only be relative (shifting
+// and stretching all distances fits as well), so it is pinned to an average
+// offset of 0 and an average scale of 1.
+bool VL53L1XArrayCalibration::solve(bool fit_scale)
+{
+  float distance[MaxPoses];
+  bool anchored = false;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    Result & r = results[i];
+    bool seen = false;
+    for (uint8_t k = 0; k < pose_count; k++) { seen |= cell(i, k).count > 0; }
+    if (!seen) { return false; }
+
+    r.fit_scale = 1;
+    r.fit_offset = 0;
+  }
+  for (uint8_t k = 0; k < pose_count; k++) { anchored |= known_mm[k] != 0; }
+
+  for (uint8_t iteration = 0; iteration < Iterations; iteration++)
+  {
+    // pose distances
+    for (uint8_t k = 0; k < pose_count; k++)
+    {
+      if (known_mm[k] != 0)
+      {
+        distance[k] = known_mm[k];
+        continue;
+      }
+
+      float sum = 0;
+      uint8_t n = 0;
+      for (uint8_t i = 0; i < count; i++)
+      {
+        const Cell & c = cell(i, k);
+        const Result & r = results[i];
+        if (c.count == 0) { continue; }
+        sum += ((float)c.sum_mm / c.count - r.fit_offset) / r.fit_scale - r.geometry_mm;
+        n++;
+      }
+      distance[k] = (n > 0) ? sum / n : 0;
+    }
+
+    // sensor lines
+    for (uint8_t i = 0; i < count; i++)
+    {
+      Result & r = results[i];
+      float sx = 0, sy = 0, sxx = 0, sxy = 0;
+      uint8_t n = 0;
+      for (uint8_t k = 0; k < pose_count; k++)
+      {
+        const Cell & c = cell(i, k);
+        if (c.count == 0) { continue; }
+        float x = distance[k] + r.geometry_mm;
+        float y = (float)c.sum_mm / c.count;
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+        n++;
+      }
+
+      float spread = n * sxx - sx * sx;
+      if (fit_scale && n >= 2 && spread > n * n * 1.0f)
+      {
+        r.fit_scale = (n * sxy - sx * sy) / spread;
+        r.fit_offset = (sy - r.fit_scale * sx) / n;
+      }
+      else
+      {
+        r.fit_scale = 1;
+        r.fit_offset = (sy - sx) / n;
+      }
+    }
+
+    if (!anchored)
+    {
+      float mean_scale = 0, mean_offset = 0;
+      for (uint8_t i = 0; i < count; i++)
+      {
+        mean_scale += results[i].fit_scale;
+        mean_offset += results[i].fit_offset;
+      }
+      mean_scale /= count;
+      mean_offset /= count;
+
+      // distance' = mean_scale * distance + mean_offset gives the same
+      // readings with these scales and offsets:
+      for (uint8_t i = 0; i < count; i++)
+      {
+        Result & r = results[i];
+        r.fit_scale /= mean_scale;
+        r.fit_offset -= r.fit_scale * mean_offset;
+      }
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    Result & r = results[i];
+    float squares = 0;
+    uint8_t n = 0;
+    for (uint8_t k = 0; k < pose_count; k++)
+    {
+      const Cell & c = cell(i, k);
+      if (c.count == 0) { continue; }
+      float error = (float)c.sum_mm / c.count - (r.fit_scale * (distance[k] + r.geometry_mm) + r.fit_offset);
+      squares += error * error;
+      n++;
+    }
+
+    r.offset_mm = lroundf(r.fit_offset);
+    r.scale_q14 = lroundf(16384 / r.fit_scale);
+    r.residual_mm = lroundf(sqrtf(squares / n));
+  }
+
+  return true;
+}
+
+bool VL53L1XArrayCalibration::program()
+{
+  bool ok = true;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    VL53L1X & sensor = sensors[i];
+
+    int16_t offset = sensor.getOffset() - results[i].offset_mm;
+    if (offset > 1023) { offset = 1023; }
+    if (offset < -1024) { offset = -1024; }
+    sensor.setOffset(offset);
+
+    if (sensor.last_status != 0) { ok = false; continue; }
+
+#if VL53L1X_FEATURE_RESTORE
+    VL53L1X::ConfigSnapshot * cache = sensor.getConfigCache();
+    if (cache != nullptr && cache->valid && !sensor.saveConfig()) { ok = false; }
+#endif
+  }
+
+  return ok;
+}
+
+#endif
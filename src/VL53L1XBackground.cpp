@@ -0,0 +1,121 @@
+#include "VL53L1XBackground.h"
+
+#if VL53L1X_FEATURE_BACKGROUND
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XBackground::VL53L1XBackground(Cell * cells, uint8_t sensor_count, uint8_t zone_count)
+  : cells(cells)
+  , sensor_count(sensor_count)
+  , zone_count(zone_count)
+  , rate_shift(5)
+  , train_samples(32)
+  , multiple_q2(16)
+  , margin_mm(60)
+  , absorb_samples(3000)
+{
+  for (uint8_t i = 0; i < sensor_count; i++) { reset(i); }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+VL53L1XBackground::Result VL53L1XBackground::classify(uint8_t sensor, uint8_t zone, uint16_t range_mm, uint8_t range_status)
+{
+  switch (range_status)
+  {
+    case VL53L1X::RangeValid:
+      if (range_mm > FarRange) { range_mm = FarRange; }
+      break;
+
+    // nothing there
+    case VL53L1X::SignalFail:
+    case VL53L1X::OutOfBoundsFail:
+      range_mm = FarRange;
+      break;
+
+    default:
+      return Ignored;
+  }
+
+  Cell & c = cell(sensor, zone);
+  uint16_t range_q4 = range_mm << 4;
+
+  if (c.samples < train_samples)
+  {
+    learn(c, range_q4);
+    return Learning;
+  }
+
+  uint32_t distance_q4 = (range_q4 > c.mean_q4) ? range_q4 - c.mean_q4 : c.mean_q4 - range_q4;
+
+  if (distance_q4 <= threshold(c))
+  {
+    c.foreground_run = 0;
+    learn(c, range_q4);
+    return Background;
+  }
+
+  if (++c.foreground_run >= absorb_samples)
+  {
+    // it has stayed: it is part of the background now
+    c.samples = 0;
+    c.foreground_run = 0;
+    learn(c, range_q4);
+  }
+  return Foreground;
+}
+
+void VL53L1XBackground::reset(uint8_t sensor)
+{
+  for (uint8_t z = 0; z < zone_count; z++)
+  {
+    Cell & c = cell(sensor, z);
+    c.mean_q4 = 0;
+    c.deviation_q4 = 0;
+    c.samples = 0;
+    c.foreground_run = 0;
+  }
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+uint32_t VL53L1XBackground::threshold(const Cell & c)
+{
+  uint32_t t = ((uint32_t)c.deviation_q4 * multiple_q2) >> 2;
+  uint32_t margin_q4 = (uint32_t)margin_mm << 4;
+  return (t > margin_q4) ? t : margin_q4;
+}
+
+// Move the mean and deviation towards a background sample. While a cell is
+// new, this is a plain average of the samples so far, so the first samples
+// count as much as later ones; after that it is an exponential average.
+void VL53L1XBackground::learn(Cell & c, uint16_t range_q4)
+{
+  if (c.samples == 0)
+  {
+    c.mean_q4 = range_q4;
+    c.deviation_q4 = 0;
+    c.samples = 1;
+    return;
+  }
+
+  int32_t error = (int32_t)range_q4 - c.mean_q4;
+  int32_t deviation_error = ((error < 0) ? -error : error) - c.deviation_q4;
+
+  if (c.samples < ((uint16_t)1 << rate_shift))
+  {
+    c.samples++;
+    c.mean_q4 += error / c.samples;
+    c.deviation_q4 += deviation_error / c.samples;
+  }
+  else
+  {
+    if (c.samples < 0xFFFF) { c.samples++; }
+    // arithmetic shifts of negative values round towards minus infinity, so
+    // divide instead to keep the average unbiased
+    c.mean_q4 += error / ((int32_t)1 << rate_shift);
+    c.deviation_q4 += deviation_error / ((int32_t)1 << rate_shift);
+  }
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "VL53L1XBusClock.h"
+
+#if VL53L1X_FEATURE_BUS_CLOCK
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XBusClock::VL53L1XBusClock()
+  : bus_count(0)
+  , window(64)
+  , step_down_errors(2)
+  , step_up_windows(16)
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+#if VL53L1X_FEATURE_RECOVERY
+bool VL53L1XBusClock::addBus(TwoWire * bus, const uint32_t * rates, uint8_t rate_count, VL53L1XRecovery * recovery)
+#else
+bool VL53L1XBusClock::addBus(TwoWire * bus, const uint32_t * rates, uint8_t rate_count)
+#endif
+{
+  if (bus_count >= MaxBuses || rate_count == 0 || rate_count > MaxRates) { return false; }
+
+  Bus & b = buses[bus_count++];
+  b = Bus();
+  b.wire = bus;
+#if VL53L1X_FEATURE_RECOVERY
+  b.recovery = recovery;
+#endif
+  b.rates = rates;
+  b.rate_count = rate_count;
+  return true;
+}
+
+void VL53L1XBusClock::begin()
+{
+  for (uint8_t i = 0; i < bus_count; i++)
+  {
+    Bus & b = buses[i];
+    b.count = 0;
+    b.failures = 0;
+    b.clean_windows = 0;
+    b.up_windows = step_up_windows;
+    b.probation = 0;
+    b.success = 0xFFFF;
+    setRate(b, 0);
+  }
+}
+
+void VL53L1XBusClock::record(uint8_t bus, uint8_t status, bool timed_out)
+{
+  Bus & b = buses[bus];
+  bool failed = status != 0 || timed_out;
+
+  b.stats.transactions++;
+  b.count++;
+  if (failed)
+  {
+    b.stats.failures++;
+    b.failures++;
+  }
+  b.success += ((int32_t)(failed ? 0 : 0xFFFF) - b.success) / (1 << 6);
+
+  // don't wait for the end of the window once it has failed
+  if (b.failures >= step_down_errors || b.count >= window) { endWindow(b); }
+}
+
+uint32_t VL53L1XBusClock::getBandwidth(uint8_t bus)
+{
+  Bus & b = buses[bus];
+  return (uint64_t)(b.rates[b.rate] / 9) * b.success / 0xFFFF;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+void VL53L1XBusClock::endWindow(Bus & b)
+{
+  bool clean = b.failures == 0;
+  bool failed = b.failures >= step_down_errors;
+  b.count = 0;
+  b.failures = 0;
+
+  if (failed)
+  {
+    // a faster rate that fails soon after stepping up is marginal: wait
+    // longer before trying it again
+    if (b.probation > 0)
+    {
+      b.up_windows = (b.up_windows < MaxStepUpWindows / 2) ? b.up_windows * 2 : MaxStepUpWindows;
+    }
+    b.probation = 0;
+    b.clean_windows = 0;
+
+    if (b.rate + 1 < b.rate_count)
+    {
+      setRate(b, b.rate + 1);
+      b.stats.step_downs++;
+    }
+    return;
+  }
+
+  if (b.probation > 0 && --b.probation == 0) { b.up_windows = step_up_windows; }
+  if (!clean)
+  {
+    b.clean_windows = 0;
+    return;
+  }
+
+  if (b.rate > 0 && ++b.clean_windows >= b.up_windows)
+  {
+    b.clean_windows = 0;
+    b.probation = b.up_windows;
+    setRate(b, b.rate - 1);
+    b.stats.step_ups++;
+  }
+}
+
+void VL53L1XBusClock::setRate(Bus & b, uint8_t rate)
+{
+  b.rate = rate;
+  b.wire->setClock(b.rates[rate]);
+#if VL53L1X_FEATURE_RECOVERY
+  if (b.recovery != nullptr) { b.recovery->setClock(b.rates[rate]); }
+#endif
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "VL53L1XBusLock.h"
+
+#if VL53L1X_FEATURE_BUS_LOCK
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#define VL53L1X_LOCK_FREERTOS 1
+#elif defined(__has_include)
+#if __has_include(<FreeRTOS.h>)
+#include <FreeRTOS.h>
+#include <semphr.h>
+#define VL53L1X_LOCK_FREERTOS 1
+#endif
+#endif
+
+#if !defined(VL53L1X_LOCK_FREERTOS)
+#if defined(ARDUINO)
+#error "VL53L1X_FEATURE_BUS_LOCK needs FreeRTOS (or a host build with std::recursive_mutex)"
+#endif
+#include <mutex>
+#endif
+
+TwoWire * VL53L1XBusLock::buses[MaxBuses];
+uint8_t VL53L1XBusLock::count = 0;
+
+#if VL53L1X_LOCK_FREERTOS
+static SemaphoreHandle_t mutexes[VL53L1XBusLock::MaxBuses];
+#else
+static std::recursive_mutex mutexes[VL53L1XBusLock::MaxBuses];
+#endif
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+bool VL53L1XBusLock::attach(TwoWire * bus)
+{
+  if (find(bus) != NoLock) { return true; }
+  if (count >= MaxBuses) { return false; }
+
+#if VL53L1X_LOCK_FREERTOS
+  mutexes[count] = xSemaphoreCreateRecursiveMutex();
+  if (mutexes[count] == nullptr) { return false; }
+#endif
+
+  buses[count] = bus;
+  // find() doesn't lock, so the bus must be in the table before it is counted
+  __sync_synchronize();
+  count++;
+  return true;
+}
+
+void VL53L1XBusLock::take(int8_t lock)
+{
+#if VL53L1X_LOCK_FREERTOS
+  xSemaphoreTakeRecursive(mutexes[lock], portMAX_DELAY);
+#else
+  mutexes[lock].lock();
+#endif
+}
+
+void VL53L1XBusLock::give(int8_t lock)
+{
+#if VL53L1X_LOCK_FREERTOS
+  xSemaphoreGiveRecursive(mutexes[lock]);
+#else
+  mutexes[lock].unlock();
+#endif
+}
+
+#endif
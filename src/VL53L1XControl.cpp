@@ -0,0 +1,412 @@
+#include "VL53L1XControl.h"
+
+#if VL53L1X_FEATURE_CONTROL
+
+#include "VL53L1XWriteQueue.h"
+
+typedef VL53L1XProtocol P;
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XControl::VL53L1XControl(Stream & port, VL53L1X * sensors, uint8_t count)
+  : port(port)
+  , sensors(sensors)
+  , count(count)
+  , sensor_groups(nullptr)
+#if VL53L1X_FEATURE_SUPERVISOR
+  , supervisor(nullptr)
+#endif
+#if VL53L1X_FEATURE_RECOVERY
+  , recovery(nullptr)
+#endif
+#if VL53L1X_FEATURE_RULES
+  , rules(nullptr)
+  , alert_seq(0)
+#endif
+  , sample_seq(0)
+  , counters()
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XControl::poll()
+{
+  uint16_t errors = parser.crcErrors() + parser.overrunErrors();
+
+  for (uint8_t n = 0; n < MaxBytesPerPoll && port.available() > 0; n++)
+  {
+    if (parser.feed(port.read()))
+    {
+      counters.frames++;
+      handle(parser.frame());
+    }
+  }
+
+  counters.errors += (uint16_t)(parser.crcErrors() + parser.overrunErrors() - errors);
+
+#if VL53L1X_FEATURE_RULES
+  sendAlerts();
+#endif
+}
+
+void VL53L1XControl::sendSample(uint8_t index, const VL53L1XSample & sample)
+{
+  P::Frame frame;
+  frame.seq = sample_seq++;
+  frame.type = P::Sample;
+  frame.target = index;
+  frame.length = P::SampleLength;
+  sample.encode(frame.payload);
+  send(frame);
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+bool VL53L1XControl::targets(uint8_t target, uint8_t index)
+{
+  if (target == P::TargetAll) { return true; }
+  if (target & P::TargetGroup)
+  {
+    return sensor_groups != nullptr && sensor_groups[index] == (target & ~P::TargetGroup);
+  }
+  return target == index;
+}
+
+// Run a request on every sensor it targets, replying for each
+void VL53L1XControl::handle(const P::Frame & request)
+{
+  P::Frame reply;
+  reply.seq = request.seq;
+  reply.type = request.type | P::Reply;
+
+#if VL53L1X_FEATURE_RULES
+  if (request.type == P::Rules)
+  {
+    loadRules(request, reply);
+    if (reply.payload[0] == P::Ok) { counters.applied++; } else { counters.failed++; }
+    send(reply);
+    return;
+  }
+#endif
+
+  bool any = false;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!targets(request.target, i)) { continue; }
+    any = true;
+
+    uint8_t length = 0;
+    uint8_t status = execute(request, i, reply.payload + 1, &length);
+    if (status == P::Ok) { counters.applied++; } else { counters.failed++; }
+
+    reply.target = i;
+    reply.payload[0] = status;
+    reply.length = 1 + length;
+    send(reply);
+  }
+
+  if (!any)
+  {
+    counters.failed++;
+    reply.target = request.target;
+    reply.payload[0] = P::BadTarget;
+    reply.length = 1;
+    send(reply);
+  }
+}
+
+// Execute a request for one sensor. The reply payload (after the status byte)
+// goes in reply, its size in *length.
+uint8_t VL53L1XControl::execute(const P::Frame & request, uint8_t index, uint8_t * reply, uint8_t * length)
+{
+  VL53L1X & sensor = sensors[index];
+  uint8_t status;
+  uint32_t value;
+
+  switch (request.type)
+  {
+    case P::Ping:
+      return P::Ok;
+
+    case P::Get:
+      if (request.length != 1) { return P::BadLength; }
+      status = get(sensor, request.payload[0], &value);
+      reply[0] = request.payload[0];
+      P::put32(reply + 1, value);
+      *length = 5;
+      return status;
+
+    case P::Set:
+      if (request.length != 5) { return P::BadLength; }
+      status = set(sensor, request.payload[0], P::get32(request.payload + 1));
+      if (status != P::Ok && status != P::Failed) { return status; }
+      // acknowledge with what the sensor actually has now
+      get(sensor, request.payload[0], &value);
+      reply[0] = request.payload[0];
+      P::put32(reply + 1, value);
+      *length = 5;
+      return status;
+
+    case P::Start:
+      if (request.length != 0 && request.length != 4) { return P::BadLength; }
+      value = (request.length == 4) ? P::get32(request.payload) : sensor.getInterMeasurementPeriod();
+      return restart(sensor, value);
+
+    case P::Stop:
+      sensor.stopContinuous();
+      return finish(sensor);
+
+    case P::Calibrate:
+      // stopping clears the manual calibration, so the first range after the
+      // restart runs the VHV and phase calibration again
+      if (!sensor.isContinuous()) { return P::Ok; }
+      return restart(sensor, sensor.getInterMeasurementPeriod());
+
+    case P::Counters:
+      *length = counterDump(index, reply);
+      return P::Ok;
+
+    default:
+      return P::UnknownType;
+  }
+}
+
+uint8_t VL53L1XControl::get(VL53L1X & sensor, uint8_t param, uint32_t * value)
+{
+  uint8_t width, height;
+
+  switch (param)
+  {
+    case P::DistanceMode: *value = sensor.getDistanceMode(); break;
+    case P::TimingBudget: *value = sensor.getMeasurementTimingBudget(); break;
+    case P::RoiSize:
+      sensor.getROISize(&width, &height);
+      *value = width | (uint16_t)height << 8;
+      break;
+    case P::RoiCenter: *value = sensor.getROICenter(); break;
+    case P::Period: *value = sensor.getInterMeasurementPeriod(); break;
+    case P::Timeout: *value = sensor.getTimeout(); return P::Ok;
+    default:
+      *value = 0;
+      return P::BadParam;
+  }
+
+  return (sensor.last_status == 0) ? P::Ok : P::Failed;
+}
+
+uint8_t VL53L1XControl::set(VL53L1X & sensor, uint8_t param, uint32_t value)
+{
+  switch (param)
+  {
+    case P::RoiCenter:
+      if (value > 0xFF) { return P::BadParam; }
+      sensor.setROICenter(value);
+      return finish(sensor);
+
+    case P::RoiSize:
+    {
+      // the API requires at least 4x4 SPADs
+      uint8_t width = value & 0xFF;
+      uint8_t height = (value >> 8) & 0xFF;
+      if (width < 4 || height < 4 || width > 16 || height > 16) { return P::BadParam; }
+      sensor.setROISize(width, height);
+      return finish(sensor);
+    }
+
+    case P::Timeout:
+      if (value > 0xFFFF) { return P::BadParam; }
+      sensor.setTimeout(value);
+      return P::Ok;
+
+    case P::DistanceMode:
+    case P::TimingBudget:
+    case P::Period:
+      break;
+
+    default:
+      return P::BadParam;
+  }
+
+  // these can't be changed while ranging: stop, apply and restart in one batch
+  if (param == P::DistanceMode && value > VL53L1X::Long) { return P::BadParam; }
+
+  bool running = sensor.isContinuous();
+  uint32_t period_ms = (param == P::Period) ? value : sensor.getInterMeasurementPeriod();
+  bool ok = true;
+
+  {
+    VL53L1XWriteQueue batch(sensor);
+
+    if (running) { sensor.stopContinuous(); }
+
+    if (param == P::DistanceMode)
+    {
+      ok = sensor.setDistanceMode((VL53L1X::DistanceMode)value);
+    }
+    else if (param == P::TimingBudget)
+    {
+      ok = sensor.setMeasurementTimingBudget(value);
+    }
+    else if (!running)
+    {
+      sensor.setInterMeasurementPeriod(period_ms);
+    }
+
+    if (running) { sensor.startContinuous(period_ms); }
+  }
+
+  if (!ok) { return P::BadParam; }
+  return finish(sensor);
+}
+
+// (Re)start continuous ranging with the given period
+uint8_t VL53L1XControl::restart(VL53L1X & sensor, uint32_t period_ms)
+{
+  {
+    VL53L1XWriteQueue batch(sensor);
+    if (sensor.isContinuous()) { sensor.stopContinuous(); }
+    sensor.startContinuous(period_ms);
+  }
+  return finish(sensor);
+}
+
+// Check the outcome of a change and refresh the configuration cache
+uint8_t VL53L1XControl::finish(VL53L1X & sensor)
+{
+  if (sensor.last_status != 0) { return P::Failed; }
+
+#if VL53L1X_FEATURE_RESTORE
+  VL53L1X::ConfigSnapshot * cache = sensor.getConfigCache();
+  if (cache != nullptr && cache->valid && !sensor.saveConfig()) { return P::Failed; }
+#endif
+
+  return P::Ok;
+}
+
+// Counter dump for one sensor:
+//   control plane: frames, errors, applied, failed (u16 each)
+//   supervisor:    state (u8), quarantines, restores (u16)    [0xFF.. if none]
+//   recovery:      faults, bus clears, power cycles, failures (u16, bus-wide)
+uint8_t VL53L1XControl::counterDump(uint8_t index, uint8_t * out)
+{
+  uint8_t * p = out;
+
+  P::put16(p, counters.frames);  p += 2;
+  P::put16(p, counters.errors);  p += 2;
+  P::put16(p, counters.applied); p += 2;
+  P::put16(p, counters.failed);  p += 2;
+
+  uint8_t state = 0xFF;
+  uint16_t quarantines = 0xFFFF, restores = 0xFFFF;
+#if VL53L1X_FEATURE_SUPERVISOR
+  if (supervisor != nullptr)
+  {
+    const VL53L1XSupervisor::SensorHealth & health = supervisor->getHealth(index);
+    state = health.state;
+    quarantines = health.quarantines;
+    restores = health.restores;
+  }
+#else
+  (void)index;
+#endif
+  *p++ = state;
+  P::put16(p, quarantines); p += 2;
+  P::put16(p, restores);    p += 2;
+
+  uint16_t faults = 0xFFFF, clears = 0xFFFF, cycles = 0xFFFF, failures = 0xFFFF;
+#if VL53L1X_FEATURE_RECOVERY
+  if (recovery != nullptr)
+  {
+    const VL53L1XRecovery::Stats & stats = recovery->getStats();
+    faults = stats.faults;
+    clears = stats.bus_clears;
+    cycles = stats.power_cycles;
+    failures = stats.failures;
+  }
+#endif
+  P::put16(p, faults);   p += 2;
+  P::put16(p, clears);   p += 2;
+  P::put16(p, cycles);   p += 2;
+  P::put16(p, failures); p += 2;
+
+  return p - out;
+}
+
+#if VL53L1X_FEATURE_RULES
+// Add (or replace) rules from a Rules request and recompile them; a request
+// that can't be applied in full changes nothing
+void VL53L1XControl::loadRules(const P::Frame & request, P::Frame & reply)
+{
+  reply.target = request.target;
+  reply.length = 2;
+
+  if (rules == nullptr)
+  {
+    reply.payload[0] = P::UnknownType;
+    reply.payload[1] = 0;
+    return;
+  }
+
+  if (request.length < 1 || (request.length - 1) % P::RuleLength != 0)
+  {
+    reply.payload[0] = P::BadLength;
+    reply.payload[1] = rules->getRuleCount();
+    return;
+  }
+  uint8_t records = (request.length - 1) / P::RuleLength;
+
+  // decode and check every record before changing anything, so a bad frame
+  // leaves the rule set as it was
+  VL53L1XRuleEngine::Rule staged[P::MaxPayload / P::RuleLength];
+  uint8_t status = P::Ok;
+  for (uint8_t i = 0; i < records; i++)
+  {
+    const uint8_t * p = request.payload + 1 + i * P::RuleLength;
+    VL53L1XRuleEngine::Rule & rule = staged[i];
+    rule.id = p[0];
+    rule.kind = (VL53L1XRuleEngine::Kind)p[1];
+    rule.target = p[2];
+    rule.count = p[3];
+    rule.threshold = P::get16(p + 4);
+    rule.rearm = P::get16(p + 6);
+    if (!VL53L1XRuleEngine::valid(rule)) { status = P::BadParam; }
+  }
+
+  if (status == P::Ok && !rules->load(staged, records, request.payload[0] == P::RulesReplace))
+  {
+    status = P::Failed;
+  }
+
+  reply.payload[0] = status;
+  reply.payload[1] = rules->getRuleCount();
+}
+
+void VL53L1XControl::sendAlerts()
+{
+  if (rules == nullptr) { return; }
+
+  VL53L1XRuleEngine::Alert alert;
+  while (rules->pollAlert(&alert))
+  {
+    P::Frame frame;
+    frame.seq = alert_seq++;
+    frame.type = P::Alert;
+    frame.target = alert.sensor;
+    frame.length = 7;
+    frame.payload[0] = alert.id;
+    P::put16(frame.payload + 1, alert.value);
+    P::put32(frame.payload + 3, alert.timestamp_ms);
+    send(frame);
+  }
+}
+#endif
+
+void VL53L1XControl::send(const P::Frame & reply)
+{
+  uint8_t buffer[P::MaxFrame];
+  port.write(buffer, P::encode(reply, buffer));
+}
+
+#endif
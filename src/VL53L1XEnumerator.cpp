@@ -0,0 +1,267 @@
+#include "VL53L1XEnumerator.h"
+
+#if VL53L1X_FEATURE_ENUMERATION
+
+#include <string.h>
+#include "VL53L1XBusLock.h"
+
+// I2C status returned by TwoWire::endTransmission()
+static const uint8_t StatusNackAddress = 2;
+static const uint8_t StatusNackData = 3;
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XEnumerator::VL53L1XEnumerator(Device * inventory, uint8_t capacity)
+  : inventory(inventory)
+  , capacity(capacity)
+  , count(0)
+  , bus_count(0)
+  , mux_count(0)
+  , first_address(0x08) // 0x00-0x07 and 0x78-0x7F are reserved
+  , last_address(0x77)
+  , probe_limit_us(2000)
+  , budget_ms(1000)
+  , start_ms(0)
+  , stats()
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+#if VL53L1X_FEATURE_RECOVERY
+bool VL53L1XEnumerator::addBus(TwoWire * bus, VL53L1XRecovery * recovery)
+#else
+bool VL53L1XEnumerator::addBus(TwoWire * bus)
+#endif
+{
+  if (bus_count >= MaxBuses) { return false; }
+
+  Bus & b = buses[bus_count++];
+  b.wire = bus;
+#if VL53L1X_FEATURE_RECOVERY
+  b.recovery = recovery;
+#endif
+  b.faults = 0;
+  return true;
+}
+
+bool VL53L1XEnumerator::addMux(uint8_t bus, uint8_t address)
+{
+  if (mux_count >= MaxMuxes || bus >= bus_count) { return false; }
+
+  muxes[mux_count].bus = bus;
+  muxes[mux_count].address = address;
+  mux_count++;
+  return true;
+}
+
+uint8_t VL53L1XEnumerator::enumerate()
+{
+  count = 0;
+  stats = Stats();
+  stats.complete = true;
+  start_ms = millis();
+
+  for (uint8_t b = 0; b < bus_count && stats.complete; b++)
+  {
+    // multiplexer channels are switched under other users' feet otherwise
+    VL53L1XBusGuard guard(buses[b].wire);
+
+    buses[b].faults = 0;
+#if defined(WIRE_HAS_TIMEOUT)
+    // where the Wire library supports it, don't let one transaction hang
+    buses[b].wire->setWireTimeout(probe_limit_us, true);
+#endif
+
+    // addresses that answer with every multiplexer channel disabled
+    uint8_t direct[16];
+    memset(direct, 0, sizeof(direct));
+
+    disableMuxes(b);
+    bool ok = scan(b, NoMux, 0, direct);
+
+    for (uint8_t m = 0; m < mux_count && ok; m++)
+    {
+      if (muxes[m].bus != b) { continue; }
+
+      for (uint8_t channel = 0; channel < MuxChannels && ok; channel++)
+      {
+        if (!setMux(m, 1 << channel))
+        {
+          // a multiplexer that doesn't answer has nothing to scan behind it
+          fault(b);
+          ok = buses[b].faults < MaxBusFaults;
+          break;
+        }
+        ok = scan(b, m, channel, direct);
+      }
+      setMux(m, 0);
+    }
+
+    if (buses[b].faults >= MaxBusFaults) { stats.skipped_buses++; }
+  }
+
+  stats.elapsed_ms = millis() - start_ms;
+  return count;
+}
+
+uint8_t VL53L1XEnumerator::getSensorCount()
+{
+  uint8_t sensors = 0;
+  for (uint8_t i = 0; i < count; i++) { sensors += inventory[i].sensor; }
+  return sensors;
+}
+
+int VL53L1XEnumerator::find(uint8_t bus, uint8_t mux, uint8_t channel, uint8_t address)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const Device & d = inventory[i];
+    if (d.bus == bus && d.mux == mux && d.address == address && (mux == NoMux || d.channel == channel))
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool VL53L1XEnumerator::select(const Device & device)
+{
+  bool ok = true;
+  for (uint8_t m = 0; m < mux_count; m++)
+  {
+    if (muxes[m].bus != device.bus) { continue; }
+    ok &= setMux(m, (m == device.mux) ? 1 << device.channel : 0);
+  }
+  return ok;
+}
+
+// The model ID register address goes out with a repeated start instead of a
+// STOP, so the ACK check and the ID read are one transaction.
+VL53L1XEnumerator::Probe VL53L1XEnumerator::probe(TwoWire * bus, uint8_t address, uint16_t * model_id)
+{
+  *model_id = 0;
+
+  VL53L1XBusGuard guard(bus);
+  bus->beginTransmission(address);
+  bus->write((uint8_t)(VL53L1X::IDENTIFICATION__MODEL_ID >> 8));
+  bus->write((uint8_t)(VL53L1X::IDENTIFICATION__MODEL_ID));
+  uint8_t status = bus->endTransmission(false);
+
+  if (status == StatusNackAddress) { return Absent; }
+  if (status == StatusNackData)
+  {
+    // there is a device, but not one with 16-bit register addresses. Without
+    // a STOP the transaction would be left open, so end it with an empty
+    // write.
+    bus->beginTransmission(address);
+    bus->endTransmission();
+    return Present;
+  }
+  if (status != 0) { return BusError; }
+
+  if (bus->requestFrom(address, (uint8_t)2) != 2) { return Present; }
+  *model_id = (uint16_t)bus->read() << 8;
+  *model_id |= bus->read();
+
+  return (*model_id == ModelId) ? Identified : Present;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Probe the address range on the bus as currently routed; returns false if
+// the bus was given up on or time ran out
+bool VL53L1XEnumerator::scan(uint8_t bus, uint8_t mux, uint8_t channel, uint8_t * direct)
+{
+  for (uint16_t address = first_address; address <= last_address && address < 0x80; address++)
+  {
+    if (isMux(bus, address)) { continue; }
+    bool on_bus = direct[address >> 3] & (1 << (address & 7));
+    if (mux != NoMux && on_bus) { continue; }
+
+    if (outOfTime())
+    {
+      stats.complete = false;
+      return false;
+    }
+
+    uint16_t model_id;
+    uint32_t start_us = micros();
+    Probe result = probe(buses[bus].wire, address, &model_id);
+    uint32_t elapsed_us = micros() - start_us;
+
+    stats.probes++;
+    if (elapsed_us > stats.max_probe_us) { stats.max_probe_us = (elapsed_us > 0xFFFF) ? 0xFFFF : elapsed_us; }
+
+    if (result == BusError || elapsed_us > probe_limit_us)
+    {
+      fault(bus);
+      if (buses[bus].faults >= MaxBusFaults) { return false; }
+      if (result == BusError) { continue; }
+    }
+    if (result == Absent) { continue; }
+
+    if (mux == NoMux) { direct[address >> 3] |= 1 << (address & 7); }
+
+    if (count >= capacity)
+    {
+      if (stats.dropped < 0xFF) { stats.dropped++; }
+      continue;
+    }
+
+    Device & d = inventory[count++];
+    d.bus = bus;
+    d.mux = mux;
+    d.channel = channel;
+    d.address = address;
+    d.model_id = model_id;
+    d.sensor = (result == Identified);
+  }
+
+  return true;
+}
+
+bool VL53L1XEnumerator::isMux(uint8_t bus, uint8_t address)
+{
+  for (uint8_t m = 0; m < mux_count; m++)
+  {
+    if (muxes[m].bus == bus && muxes[m].address == address) { return true; }
+  }
+  return false;
+}
+
+// TCA9548A-style: a single control register, one enable bit per channel
+bool VL53L1XEnumerator::setMux(uint8_t mux, uint8_t channels)
+{
+  TwoWire * wire = buses[muxes[mux].bus].wire;
+  VL53L1XBusGuard guard(wire);
+  wire->beginTransmission(muxes[mux].address);
+  wire->write(channels);
+  return wire->endTransmission() == 0;
+}
+
+void VL53L1XEnumerator::disableMuxes(uint8_t bus)
+{
+  for (uint8_t m = 0; m < mux_count; m++)
+  {
+    if (muxes[m].bus == bus) { setMux(m, 0); }
+  }
+}
+
+void VL53L1XEnumerator::fault(uint8_t bus)
+{
+  stats.faults++;
+  buses[bus].faults++;
+
+#if VL53L1X_FEATURE_RECOVERY
+  if (buses[bus].recovery != nullptr)
+  {
+    buses[bus].recovery->clearBus();
+#if defined(WIRE_HAS_TIMEOUT)
+    buses[bus].wire->setWireTimeout(probe_limit_us, true);
+#endif
+  }
+#endif
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "VL53L1XFrameAssembler.h"
+
+#if VL53L1X_FEATURE_FRAME_ASSEMBLY
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XFrameAssembler::VL53L1XFrameAssembler(VL53L1X & sensor, Zone * zones, uint8_t count)
+  : sensor(sensor)
+  , zones(zones)
+  , count(count)
+  , current(0)
+  , synced(false)
+  , expected_stream(-1)
+  , resyncs(0)
+  , alpha_shift(1)
+  , beta_shift(3)
+  , max_gap_us(MaxGapLimit)
+  , frame_time_us(0)
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XFrameAssembler::begin()
+{
+  current = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    zones[i].tracking = false;
+    zones[i].innovation_mm = 0;
+    zones[i].frame_range_mm = NoTarget;
+    zones[i].frame_uncertainty_mm = 0;
+    zones[i].frame_offset_us = 0;
+  }
+
+  synced = !sensor.isContinuous();
+  expected_stream = -1;
+  if (count > 0) { sensor.setROICenter(zones[0].roi_center); }
+}
+
+// Take the next sample if there is one and move the ROI on to the next zone.
+// Returns true when the last zone of a pass has been read and a frame
+// assembled.
+bool VL53L1XFrameAssembler::update()
+{
+  if (count == 0 || !sensor.dataReady()) { return false; }
+
+  // timestamp as close to the read as possible
+  uint32_t now_us = micros();
+  sensor.read(false);
+
+  // after a gap in the stream count this result's zone isn't known: drop it
+  // and program the same zone again
+  uint8_t stream = sensor.getStreamCount();
+  bool in_step = synced && (expected_stream < 0 || stream == expected_stream);
+  synced = true;
+  expected_stream = VL53L1X::nextStreamCount(stream);
+  if (!in_step)
+  {
+    resyncs++;
+    if (count > 1) { sensor.setROICenter(zones[current].roi_center); }
+    return false;
+  }
+
+  uint8_t zone = current;
+  add(zone, sensor.ranging_data.range_mm, sensor.ranging_data.range_status, now_us);
+
+  if (++current >= count) { current = 0; }
+  if (count > 1) { sensor.setROICenter(zones[current].roi_center); }
+
+  if (zone != count - 1) { return false; }
+
+  assemble(now_us);
+  return true;
+}
+
+// Update a zone's alpha-beta filter with a sample
+void VL53L1XFrameAssembler::add(uint8_t index, uint16_t range_mm, uint8_t range_status, uint32_t timestamp_us)
+{
+  Zone & zone = zones[index];
+
+  if (range_status != VL53L1X::RangeValid)
+  {
+    zone.tracking = false;
+    zone.timestamp_us = timestamp_us;
+    return;
+  }
+
+  uint32_t dt_us = timestamp_us - zone.timestamp_us;
+
+  if (!zone.tracking || dt_us == 0 || dt_us > max_gap_us)
+  {
+    zone.tracking = true;
+    zone.samples = 1;
+    zone.range_mm = range_mm;
+    zone.velocity_q8 = 0;
+    zone.velocity_spread_q8 = 0;
+    // innovation_mm is kept: the zone's noise hasn't changed
+    zone.timestamp_us = timestamp_us;
+    return;
+  }
+
+  int32_t predicted = predict(zone, dt_us);
+  int32_t innovation = (int32_t)range_mm - predicted;
+  if (innovation > MaxInnovation) { innovation = MaxInnovation; }
+  if (innovation < -MaxInnovation) { innovation = -MaxInnovation; }
+  int32_t abs_innovation = (innovation < 0) ? -innovation : innovation;
+
+  int32_t range = predicted + innovation / ((int32_t)1 << alpha_shift);
+  if (range < 0) { range = 0; }
+
+  int32_t velocity = zone.velocity_q8;
+  if (zone.samples > 1)
+  {
+    // the first difference has no velocity estimate to correct yet, so it
+    // takes the measured rate directly
+    velocity += innovation * 256000 / (int32_t)dt_us / ((int32_t)1 << beta_shift);
+  }
+  else
+  {
+    velocity = innovation * 256000 / (int32_t)dt_us;
+  }
+  if (velocity > MaxVelocity) { velocity = MaxVelocity; }
+  if (velocity < -MaxVelocity) { velocity = -MaxVelocity; }
+
+  int32_t velocity_change = velocity - zone.velocity_q8;
+  if (velocity_change < 0) { velocity_change = -velocity_change; }
+
+  zone.innovation_mm += (abs_innovation - (int32_t)zone.innovation_mm) / 4;
+  zone.velocity_spread_q8 += (velocity_change - (int32_t)zone.velocity_spread_q8) / 4;
+  zone.range_mm = range;
+  zone.velocity_q8 = velocity;
+  zone.timestamp_us = timestamp_us;
+  if (zone.samples < 0xFF) { zone.samples++; }
+}
+
+// Predict every zone to frame_time_us
+void VL53L1XFrameAssembler::assemble(uint32_t frame_time_us)
+{
+  this->frame_time_us = frame_time_us;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    Zone & zone = zones[i];
+    int32_t dt_us = (int32_t)(frame_time_us - zone.timestamp_us);
+    zone.frame_offset_us = dt_us;
+
+    if (!zone.tracking)
+    {
+      zone.frame_range_mm = NoTarget;
+      zone.frame_uncertainty_mm = 0;
+      continue;
+    }
+
+    if (dt_us > (int32_t)max_gap_us) { dt_us = max_gap_us; }
+    if (dt_us < -(int32_t)max_gap_us) { dt_us = -(int32_t)max_gap_us; }
+
+    int32_t range = predict(zone, dt_us);
+    if (range < 0) { range = 0; }
+    if (range >= NoTarget) { range = NoTarget - 1; }
+
+    uint32_t abs_dt_us = (dt_us < 0) ? -dt_us : dt_us;
+    uint32_t uncertainty = zone.innovation_mm + (uint32_t)zone.velocity_spread_q8 * abs_dt_us / 256000;
+
+    zone.frame_range_mm = range;
+    zone.frame_uncertainty_mm = (uncertainty > 0xFFFF) ? 0xFFFF : uncertainty;
+  }
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+int32_t VL53L1XFrameAssembler::predict(const Zone & zone, int32_t dt_us)
+{
+  return zone.range_mm + (int32_t)zone.velocity_q8 * dt_us / 256000;
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "VL53L1XGesture.h"
+
+#if VL53L1X_FEATURE_GESTURE
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XGesture::VL53L1XGesture(VL53L1X & sensor)
+  : sensor(sensor)
+  , zone_count(0)
+  , current(0)
+  , synced(false)
+  , expected_stream(-1)
+  , resyncs(0)
+  , threshold_mm(300)
+  , hysteresis_mm(50)
+  , swipe_ms(600)
+  , hover_ms(800)
+  , state(Idle)
+  , start_ms(0)
+  , closest_mm(0)
+  , first_zone(0)
+  , last_zone(0)
+  , entered(0)
+  , event()
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+bool VL53L1XGesture::addZone(uint8_t roi_center, int8_t x, int8_t y)
+{
+  if (zone_count >= MaxZones) { return false; }
+
+  Zone & zone = zones[zone_count++];
+  zone.roi_center = roi_center;
+  zone.x = x;
+  zone.y = y;
+  zone.present = false;
+  zone.onset_ms = 0;
+  return true;
+}
+
+void VL53L1XGesture::begin()
+{
+  current = 0;
+  state = Idle;
+  for (uint8_t i = 0; i < zone_count; i++) { zones[i].present = false; }
+
+  // if the sensor is already ranging, a measurement with the old ROI may be
+  // under way
+  synced = !sensor.isContinuous();
+  expected_stream = -1;
+  if (zone_count > 0) { sensor.setROICenter(zones[0].roi_center); }
+}
+
+// Take the next sample if there is one, and move the ROI on to the next zone
+VL53L1XGesture::Gesture VL53L1XGesture::update()
+{
+  if (zone_count == 0 || !sensor.dataReady()) { return None; }
+
+  sensor.read(false);
+
+  // a gap in the stream count means the ROI written after the previous read
+  // may have missed the measurement it was meant for
+  uint8_t stream = sensor.getStreamCount();
+  bool in_step = synced && (expected_stream < 0 || stream == expected_stream);
+  synced = true;
+  expected_stream = VL53L1X::nextStreamCount(stream);
+
+  Gesture gesture = None;
+  if (in_step) { gesture = process(sensor.ranging_data.range_mm, sensor.ranging_data.range_status, millis()); }
+  else { resyncs++; }
+
+  // the measurement after the one now in progress uses this zone
+  if (zone_count > 1) { sensor.setROICenter(zones[current].roi_center); }
+
+  return gesture;
+}
+
+// Run the detector on a sample of the current zone, then advance to the next
+// zone
+VL53L1XGesture::Gesture VL53L1XGesture::process(uint16_t range_mm, uint8_t range_status, uint32_t now_ms)
+{
+  if (zone_count == 0) { return None; }
+
+  uint8_t index = current;
+  bool onset = sampleZone(zones[index], range_mm, range_status, now_ms);
+  if (++current >= zone_count) { current = 0; }
+
+  bool any = false, all = true;
+  uint32_t all_since_ms = 0; // when the last zone to become present did so
+  for (uint8_t i = 0; i < zone_count; i++)
+  {
+    if (zones[i].present)
+    {
+      if (!any || (int32_t)(zones[i].onset_ms - all_since_ms) > 0) { all_since_ms = zones[i].onset_ms; }
+      any = true;
+    }
+    else
+    {
+      all = false;
+    }
+  }
+
+  switch (state)
+  {
+    case Idle:
+      if (!onset) { return None; }
+      state = Tracking;
+      start_ms = now_ms;
+      closest_mm = range_mm;
+      first_zone = last_zone = index;
+      entered = 1 << index;
+      return None;
+
+    case Tracking:
+      if (onset && !(entered & (1 << index)))
+      {
+        last_zone = index;
+        entered |= 1 << index;
+      }
+      if (zones[index].present && range_mm < closest_mm) { closest_mm = range_mm; }
+
+      if (!any)
+      {
+        // everything has cleared: it was a swipe if it was quick enough
+        state = Idle;
+        if ((uint32_t)(now_ms - start_ms) > swipe_ms) { return None; }
+        return emit(classify(), now_ms);
+      }
+
+      if (all)
+      {
+        if ((uint32_t)(now_ms - all_since_ms) >= hover_ms)
+        {
+          state = Done;
+          return emit(Hover, now_ms);
+        }
+      }
+      else if ((uint32_t)(now_ms - start_ms) > swipe_ms)
+      {
+        // too slow for a swipe and not covering every zone: not a gesture
+        state = Done;
+      }
+      return None;
+
+    case Done:
+    default:
+      if (!any) { state = Idle; }
+      return None;
+  }
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Update a zone's presence with hysteresis; returns true on a presence onset
+bool VL53L1XGesture::sampleZone(Zone & zone, uint16_t range_mm, uint8_t range_status, uint32_t now_ms)
+{
+  // anything but a valid range means nothing is in the way
+  bool valid = (range_status == VL53L1X::RangeValid);
+
+  if (!zone.present)
+  {
+    if (valid && range_mm < threshold_mm)
+    {
+      zone.present = true;
+      zone.onset_ms = now_ms;
+      return true;
+    }
+  }
+  else if (!valid || range_mm > threshold_mm + hysteresis_mm)
+  {
+    zone.present = false;
+  }
+  return false;
+}
+
+// Direction from the first zone entered to the last one
+VL53L1XGesture::Gesture VL53L1XGesture::classify()
+{
+  if (first_zone == last_zone) { return None; }
+
+  int16_t dx = zones[last_zone].x - zones[first_zone].x;
+  int16_t dy = zones[last_zone].y - zones[first_zone].y;
+
+  if (abs(dx) >= abs(dy))
+  {
+    return (dx > 0) ? SwipeRight : SwipeLeft;
+  }
+  return (dy > 0) ? SwipeUp : SwipeDown;
+}
+
+VL53L1XGesture::Gesture VL53L1XGesture::emit(Gesture gesture, uint32_t now_ms)
+{
+  if (gesture == None) { return None; }
+
+  event.gesture = gesture;
+  event.timestamp_ms = now_ms;
+  event.duration_ms = now_ms - start_ms;
+  event.distance_mm = closest_mm;
+  return gesture;
+}
+
+#endif
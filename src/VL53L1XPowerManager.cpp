@@ -0,0 +1,200 @@
+#include "VL53L1XPowerManager.h"
+
+#if VL53L1X_FEATURE_POWER_MANAGER
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XPowerManager::VL53L1XPowerManager(VL53L1X * sensors, const uint8_t * sensor_groups, uint8_t count,
+                                         Group * groups, uint8_t group_count)
+  : sensors(sensors)
+  , sensor_groups(sensor_groups)
+  , count(count)
+  , groups(groups)
+  , group_count(group_count)
+  , restoring(NoGroup)
+{
+  for (uint8_t g = 0; g < group_count; g++)
+  {
+    groups[g] = Group();
+    groups[g].state = On;
+    groups[g].wake_ms = millis();
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XPowerManager::setSchedule(uint8_t group, uint32_t period_ms, uint32_t on_ms)
+{
+  groups[group].period_ms = period_ms;
+  groups[group].on_ms = on_ms;
+}
+
+// Start waking a group. The sensors are restored over the next few calls to
+// service(); awake() turns true once all of them have a sample ready.
+void VL53L1XPowerManager::wake(uint8_t group)
+{
+  Group & g = groups[group];
+
+  if (g.state != Off) { return; }
+
+  g.state = Restoring;
+  g.next = nextInGroup(group, 0);
+  g.sensor_on = false;
+  g.wake_ms = millis();
+  g.wake_start_us = micros();
+  g.wakes++;
+  // step_ms is left at the time the group was put to sleep, so the first
+  // sensor is only powered up once it has been off for at least PowerOffMs
+}
+
+// Put a group in shutdown. Sensors that were ranging resume when it wakes.
+void VL53L1XPowerManager::sleep(uint8_t group)
+{
+  Group & g = groups[group];
+
+  if (g.state == Off) { return; }
+  if (restoring == group) { restoring = NoGroup; }
+
+  for (uint8_t i = nextInGroup(group, 0); i < count; i = nextInGroup(group, i + 1))
+  {
+    if (gated(i)) { sensors[i].powerOff(); }
+  }
+
+  g.state = Off;
+  g.step_ms = millis();
+}
+
+void VL53L1XPowerManager::service()
+{
+  uint32_t now = millis();
+
+  for (uint8_t group = 0; group < group_count; group++)
+  {
+    Group & g = groups[group];
+
+    if (g.on_ms != 0)
+    {
+      if (g.state == Off && (now - g.wake_ms) >= g.period_ms) { wake(group); }
+      else if (g.state == On && (now - g.wake_ms) >= g.on_ms) { sleep(group); }
+    }
+
+    if (g.state == Restoring)
+    {
+      // every sensor boots at the default address, so groups take turns
+      if (restoring == NoGroup) { restoring = group; }
+      if (restoring == group) { stepRestoring(group); }
+    }
+    else if (g.state == Settling) { stepSettling(group); }
+  }
+}
+
+uint32_t VL53L1XPowerManager::getAverageLatency(uint8_t group)
+{
+  Group & g = groups[group];
+  return (g.completed_wakes == 0) ? 0 : g.total_latency_us / g.completed_wakes;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Can this sensor be power gated?
+bool VL53L1XPowerManager::gated(uint8_t index)
+{
+  VL53L1X::ConfigSnapshot * cache = sensors[index].getConfigCache();
+  return sensors[index].getXshutPin() != VL53L1X::NoPin && cache != nullptr && cache->valid;
+}
+
+// index of the first sensor at or after from that belongs to group, or count
+uint8_t VL53L1XPowerManager::nextInGroup(uint8_t group, uint8_t from)
+{
+  while (from < count && sensor_groups[from] != group) { from++; }
+  return from;
+}
+
+// Bring up one sensor at a time: every sensor boots at the default address, so
+// each one has to be moved to its own address before the next is released
+// from shutdown.
+void VL53L1XPowerManager::stepRestoring(uint8_t group)
+{
+  Group & g = groups[group];
+  uint32_t now = millis();
+
+  if (g.next >= count)
+  {
+    restoring = NoGroup;
+    g.state = Settling;
+    g.next = nextInGroup(group, 0);
+    g.step_ms = now;
+    return;
+  }
+
+  if (!gated(g.next))
+  {
+    g.next = nextInGroup(group, g.next + 1);
+    return;
+  }
+
+  VL53L1X & sensor = sensors[g.next];
+
+  if (!g.sensor_on)
+  {
+    if ((now - g.step_ms) < PowerOffMs) { return; }
+    // another sensor on the bus is booting (a VL53L1XSupervisor may be
+    // restoring one): try again on the next call
+    if (!sensor.powerOn()) { return; }
+
+    g.sensor_on = true;
+    g.step_ms = now;
+    return;
+  }
+
+  if ((now - g.step_ms) < BootMs) { return; }
+
+  g.sensor_on = false;
+  if (!sensor.restoreConfig(RestoreTimeoutMs))
+  {
+    failWake(group);
+    return;
+  }
+
+  g.next = nextInGroup(group, g.next + 1);
+}
+
+// Give up on a wake: put the whole group back in shutdown (which also takes
+// the failed sensor off the default address, where it would collide with the
+// next sensor to be woken), so awake() never reports a group with a sensor
+// missing
+void VL53L1XPowerManager::failWake(uint8_t group)
+{
+  groups[group].failed_wakes++;
+  sleep(group);
+}
+
+// Wait for each restored sensor's first sample. The sensors are checked in the
+// order they were woken, so the group is ready when the last one is.
+void VL53L1XPowerManager::stepSettling(uint8_t group)
+{
+  Group & g = groups[group];
+
+  while (g.next < count)
+  {
+    VL53L1X & sensor = sensors[g.next];
+
+    // sensors that aren't gated were never off, and sensors that aren't
+    // ranging will never have a sample
+    if (gated(g.next) && sensor.isContinuous() && !sensor.dataReady() && sensor.last_status == 0)
+    {
+      if ((uint32_t)(millis() - g.step_ms) < SettleTimeoutMs) { return; }
+    }
+
+    g.next = nextInGroup(group, g.next + 1);
+  }
+
+  g.last_latency_us = micros() - g.wake_start_us;
+  if (g.last_latency_us > g.max_latency_us) { g.max_latency_us = g.last_latency_us; }
+  g.total_latency_us += g.last_latency_us;
+  g.completed_wakes++;
+
+  g.state = On;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "VL53L1XRecovery.h"
+#include "VL53L1XBusLock.h"
+
+#if VL53L1X_FEATURE_RECOVERY
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XRecovery::VL53L1XRecovery(TwoWire * bus, uint8_t sda_pin, uint8_t scl_pin, uint32_t clock_hz)
+  : bus(bus)
+  , sda_pin(sda_pin)
+  , scl_pin(scl_pin)
+  , clock_hz(clock_hz)
+  , budget_ms(10)
+  , nack_limit(3)
+  , nack_sensor(nullptr)
+  , nack_count(0)
+  , stats()
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+// Inspect the status of the sensor's last transaction and recover if the fault
+// looks persistent. A single NACK is common while a sensor is busy booting, so
+// NACKs are only acted on after nack_limit in a row from the same sensor; any
+// other bus error is acted on immediately.
+VL53L1XRecovery::Result VL53L1XRecovery::check(VL53L1X & sensor)
+{
+  if (sensor.last_status == 0)
+  {
+    if (nack_sensor == &sensor)
+    {
+      nack_sensor = nullptr;
+      nack_count = 0;
+    }
+    return Ok;
+  }
+
+  stats.faults++;
+
+  if (sensor.last_status == StatusNackAddress || sensor.last_status == StatusNackData)
+  {
+    if (nack_sensor != &sensor)
+    {
+      nack_sensor = &sensor;
+      nack_count = 0;
+    }
+    if (++nack_count < nack_limit) { return Pending; }
+  }
+
+  return recover(sensor);
+}
+
+// Bring the bus and the sensor back, escalating from a bus clear to an XSHUT
+// power cycle with a fast configuration restore. The bus clear always runs;
+// each later step only starts if the budget isn't spent yet.
+VL53L1XRecovery::Result VL53L1XRecovery::recover(VL53L1X & sensor)
+{
+  uint16_t start_ms = millis();
+  Result result;
+
+  nack_sensor = nullptr;
+  nack_count = 0;
+
+  bool cleared = clearBus();
+  if ((uint16_t)(millis() - start_ms) >= budget_ms)
+  {
+    // the Wire restart can be slow on some cores
+    result = BudgetExceeded;
+  }
+  else if (cleared && probe(sensor))
+  {
+    result = BusCleared;
+  }
+  else if ((uint16_t)(millis() - start_ms) >= budget_ms)
+  {
+    result = BudgetExceeded;
+  }
+  else if (sensor.getConfigCache() == nullptr || !sensor.powerOff())
+  {
+    // nothing more we can do without XSHUT and a snapshot
+    result = Failed;
+  }
+  else
+  {
+    stats.power_cycles++;
+    delayMicroseconds(XshutLowUs);
+
+    uint16_t elapsed_ms = millis() - start_ms;
+    if (!sensor.powerOn())
+    {
+      // another sensor on the bus is booting at the default address
+      result = Failed;
+    }
+    else if (elapsed_ms >= budget_ms)
+    {
+      result = BudgetExceeded;
+    }
+    else if (sensor.restoreConfig(budget_ms - elapsed_ms))
+    {
+      stats.restores++;
+      result = SensorRestored;
+    }
+    else
+    {
+      result = ((uint16_t)(millis() - start_ms) >= budget_ms) ? BudgetExceeded : Failed;
+    }
+
+    // leave it in shutdown rather than at the default address, where it
+    // would collide with the next sensor powered up on the bus; the next
+    // recovery tries again
+    if (result != SensorRestored) { sensor.powerOff(); }
+  }
+
+  if (result == Failed || result == BudgetExceeded) { stats.failures++; }
+
+  uint16_t elapsed_ms = millis() - start_ms;
+  if (elapsed_ms > stats.max_recovery_ms) { stats.max_recovery_ms = elapsed_ms; }
+
+  return result;
+}
+
+// Release a stuck bus: clock SCL until any slave holding SDA low (typically one
+// that was interrupted mid-byte) lets go, then generate a STOP condition and
+// restart the Wire peripheral. Returns true if both lines are high afterwards.
+//
+// Lines are only ever driven low or released, as on a real open-drain bus.
+bool VL53L1XRecovery::clearBus()
+{
+  VL53L1XBusGuard guard(bus);
+
+  stats.bus_clears++;
+
+  bus->end();
+
+  releaseLine(sda_pin);
+  releaseLine(scl_pin);
+  delayMicroseconds(HalfPeriodUs);
+
+  if (digitalRead(sda_pin) == LOW || digitalRead(scl_pin) == LOW)
+  {
+    stats.stuck_bus++;
+  }
+
+  // nine clocks are enough for a slave to finish whatever byte (plus ACK) it
+  // was in the middle of sending
+  for (uint8_t i = 0; i < 9 && digitalRead(sda_pin) == LOW; i++)
+  {
+    driveLow(scl_pin);
+    delayMicroseconds(HalfPeriodUs);
+    releaseLine(scl_pin);
+    delayMicroseconds(HalfPeriodUs);
+  }
+
+  // STOP: SDA goes high while SCL is high
+  driveLow(scl_pin);
+  delayMicroseconds(HalfPeriodUs);
+  driveLow(sda_pin);
+  delayMicroseconds(HalfPeriodUs);
+  releaseLine(scl_pin);
+  delayMicroseconds(HalfPeriodUs);
+  releaseLine(sda_pin);
+  delayMicroseconds(HalfPeriodUs);
+
+  bool released = (digitalRead(sda_pin) == HIGH) && (digitalRead(scl_pin) == HIGH);
+
+  bus->begin();
+  bus->setClock(clock_hz);
+
+  return released;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Check that the sensor ACKs a minimal read
+bool VL53L1XRecovery::probe(VL53L1X & sensor)
+{
+  sensor.readReg(VL53L1X::FIRMWARE__SYSTEM_STATUS);
+  return sensor.last_status == 0;
+}
+
+#endif
@@ -0,0 +1,4 @@
+#include "VL53L1XRegisters.h"
+
+// definition for run-time lookups (required before C++17)
+constexpr VL53L1XRegisters::Wide VL53L1XRegisters::wide[];
@@ -0,0 +1,144 @@
+#include "VL53L1XRouter.h"
+
+#if VL53L1X_FEATURE_ROUTER
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XRouter::VL53L1XRouter(Sink * sinks, uint8_t max_sinks)
+  : sinks(sinks)
+  , max_sinks(max_sinks)
+  , sink_count(0)
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+int8_t VL53L1XRouter::addSink(Deliver deliver, void * context, Record * queue, uint8_t capacity,
+                              Policy policy, Priority priority)
+{
+  if (sink_count >= max_sinks || capacity == 0) { return -1; }
+
+  Sink & sink = sinks[sink_count];
+  sink.deliver = deliver;
+  sink.context = context;
+  sink.queue = queue;
+  sink.capacity = capacity;
+  sink.head = 0;
+  sink.length = 0;
+  sink.policy = policy;
+  sink.priority = priority;
+  sink.decimation_shift = 0;
+  sink.stats = Stats();
+  return sink_count++;
+}
+
+void VL53L1XRouter::publish(uint8_t sensor, const VL53L1XSample & sample)
+{
+  for (uint8_t i = 0; i < sink_count; i++)
+  {
+    Sink & sink = sinks[i];
+    enqueue(sink, sensor, sample);
+    if (sink.priority == Critical) { drain(sink, 0, 0); }
+  }
+}
+
+void VL53L1XRouter::service(uint16_t budget_us)
+{
+  uint32_t start_us = micros();
+
+  for (uint8_t priority = Critical; priority <= Background; priority++)
+  {
+    for (uint8_t i = 0; i < sink_count; i++)
+    {
+      Sink & sink = sinks[i];
+      if (sink.priority != priority) { continue; }
+
+      // only Background sinks are held to the budget
+      if (!drain(sink, start_us, (priority == Background) ? budget_us : 0)) { return; }
+    }
+  }
+}
+
+void VL53L1XRouter::resetStats()
+{
+  for (uint8_t i = 0; i < sink_count; i++)
+  {
+    sinks[i].stats = Stats();
+    sinks[i].stats.high_water = sinks[i].length;
+  }
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+void VL53L1XRouter::enqueue(Sink & sink, uint8_t sensor, const VL53L1XSample & sample)
+{
+  sink.stats.offered++;
+
+  if (sink.policy == Decimate && (sample.stream_count & ((1 << sink.decimation_shift) - 1)) != 0)
+  {
+    sink.stats.dropped++;
+    return;
+  }
+
+  if (sink.length == sink.capacity)
+  {
+    sink.stats.dropped++;
+    switch (sink.policy)
+    {
+      case DropOldest:
+        sink.head = (sink.head + 1 < sink.capacity) ? sink.head + 1 : 0;
+        sink.length--;
+        break;
+
+      case Decimate:
+        if (sink.decimation_shift < MaxDecimationShift) { sink.decimation_shift++; }
+        return;
+
+      case DropNewest:
+      default:
+        return;
+    }
+  }
+
+  uint16_t tail = (uint16_t)sink.head + sink.length;
+  if (tail >= sink.capacity) { tail -= sink.capacity; }
+  sink.queue[tail].sample = sample;
+  sink.queue[tail].sensor = sensor;
+  sink.length++;
+  if (sink.length > sink.stats.high_water) { sink.stats.high_water = sink.length; }
+}
+
+// Deliver a sink's queued samples until it refuses one or the queue is empty;
+// returns false if budget_us (if not 0) ran out
+bool VL53L1XRouter::drain(Sink & sink, uint32_t start_us, uint16_t budget_us)
+{
+  if (sink.length == 0) { return true; }
+
+  while (sink.length > 0)
+  {
+    uint32_t now_us = micros();
+    if (budget_us != 0 && (uint32_t)(now_us - start_us) >= budget_us) { return false; }
+
+    const Record & record = sink.queue[sink.head];
+    if (!sink.deliver(sink.context, record.sensor, record.sample))
+    {
+      sink.stats.refused++;
+      return true;
+    }
+
+    Stats & stats = sink.stats;
+    uint32_t latency_us = now_us - record.sample.timestamp_us;
+    stats.delivered++;
+    if (latency_us > stats.latency_max_us) { stats.latency_max_us = latency_us; }
+    stats.latency_avg_us += ((int32_t)latency_us - (int32_t)stats.latency_avg_us) / 16;
+
+    sink.head = (sink.head + 1 < sink.capacity) ? sink.head + 1 : 0;
+    sink.length--;
+  }
+
+  // caught up: a decimating sink can take more again
+  if (sink.decimation_shift > 0) { sink.decimation_shift--; }
+  return true;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "VL53L1XRuleEngine.h"
+
+#if VL53L1X_FEATURE_RULES
+
+// range used for samples with no target
+static const uint16_t Far = 0xFFFF;
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XRuleEngine::VL53L1XRuleEngine(Rule * rules, uint8_t max_rules, Entry * entries, uint16_t max_entries,
+                                     SensorState * states, uint8_t sensor_count)
+  : rules(rules)
+  , max_rules(max_rules)
+  , rule_count(0)
+  , entries(entries)
+  , max_entries(max_entries)
+  , states(states)
+  , sensor_count(sensor_count)
+  , sensor_groups(nullptr)
+  , alert_head(0)
+  , alert_count(0)
+  , dropped(0)
+{
+  for (uint8_t i = 0; i < sensor_count; i++)
+  {
+    states[i].first = 0;
+    states[i].length = 0;
+    states[i].seen = false;
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+bool VL53L1XRuleEngine::add(const Rule & rule)
+{
+  if (rule_count >= max_rules || !valid(rule)) { return false; }
+
+  rules[rule_count++] = rule;
+  return true;
+}
+
+bool VL53L1XRuleEngine::compile()
+{
+  // check that everything fits before touching the current tables
+  if (!fits(rule_count, nullptr, 0)) { return false; }
+
+  uint16_t next = 0;
+  for (uint8_t s = 0; s < sensor_count; s++)
+  {
+    SensorState & state = states[s];
+    state.first = next;
+
+    for (uint8_t r = 0; r < rule_count; r++)
+    {
+      const Rule & rule = rules[r];
+      if (!applies(rule, s)) { continue; }
+
+      Entry & e = entries[next++];
+      e.kind = rule.kind;
+      e.id = rule.id;
+      e.count = rule.count;
+      e.run = 0;
+      e.fired = false;
+      e.threshold = rule.threshold;
+      e.rearm = rule.rearm;
+    }
+
+    state.length = next - state.first;
+  }
+
+  return true;
+}
+
+bool VL53L1XRuleEngine::load(const Rule * added, uint8_t count, bool replace)
+{
+  uint8_t kept = replace ? 0 : rule_count;
+
+  if ((uint16_t)kept + count > max_rules) { return false; }
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!valid(added[i])) { return false; }
+  }
+  if (!fits(kept, added, count)) { return false; }
+
+  rule_count = kept;
+  for (uint8_t i = 0; i < count; i++) { rules[rule_count++] = added[i]; }
+  return compile();
+}
+
+bool VL53L1XRuleEngine::valid(const Rule & rule)
+{
+  return rule.kind >= RangeBelow && rule.kind <= ApproachFaster && rule.count != 0;
+}
+
+uint8_t VL53L1XRuleEngine::evaluate(uint8_t sensor, uint16_t range_mm, uint8_t range_status, uint32_t now_ms)
+{
+  SensorState & state = states[sensor];
+
+  // what the range rules see: a range, far for no target, or nothing for other
+  // failures
+  bool range_known = true;
+  uint16_t range = range_mm;
+  if (range_status == VL53L1X::SignalFail || range_status == VL53L1X::OutOfBoundsFail)
+  {
+    range = Far;
+  }
+  else if (range_status != VL53L1X::RangeValid)
+  {
+    range_known = false;
+  }
+
+  // closing speed in mm/s, if both this and the previous sample had a target
+  bool speed_known = false;
+  int32_t speed = 0;
+  uint32_t dt_ms = now_ms - state.last_ms;
+  if (state.seen && range_status == VL53L1X::RangeValid && state.last_range_mm != Far && dt_ms > 0)
+  {
+    speed_known = true;
+    speed = ((int32_t)state.last_range_mm - range_mm) * 1000 / (int32_t)dt_ms;
+  }
+
+  uint8_t raised = 0;
+  Entry * e = entries + state.first;
+  Entry * end = e + state.length;
+
+  for (; e < end; e++)
+  {
+    bool condition, clear;
+    uint16_t value;
+
+    switch (e->kind)
+    {
+      case RangeBelow:
+        if (!range_known) { continue; }
+        condition = range < e->threshold;
+        clear = range >= (uint32_t)e->threshold + e->rearm;
+        value = range;
+        break;
+
+      case RangeAbove:
+        if (!range_known) { continue; }
+        condition = range > e->threshold;
+        clear = (uint32_t)range + e->rearm <= e->threshold;
+        value = range;
+        break;
+
+      case StatusIs:
+        condition = range_status == e->threshold;
+        clear = !condition;
+        value = range_status;
+        break;
+
+      case StatusChanged:
+        if (!state.seen) { continue; }
+        condition = range_status != state.last_status;
+        clear = !condition;
+        value = range_status;
+        break;
+
+      case ApproachFaster:
+      default:
+        condition = speed_known && speed > (int32_t)e->threshold;
+        clear = !condition;
+        value = (speed > 0xFFFF) ? 0xFFFF : (speed < 0) ? 0 : speed;
+        break;
+    }
+
+    if (condition)
+    {
+      if (e->kind == StatusChanged)
+      {
+        // every status change is an event of its own: no run to wait for,
+        // and nothing to re-arm
+        raise(e->id, sensor, value, now_ms);
+        raised++;
+        continue;
+      }
+
+      if (e->run < 0xFF) { e->run++; }
+      if (!e->fired && e->run >= e->count)
+      {
+        e->fired = true;
+        raise(e->id, sensor, value, now_ms);
+        raised++;
+      }
+    }
+    else
+    {
+      e->run = 0;
+      if (clear) { e->fired = false; }
+    }
+  }
+
+  state.seen = true;
+  state.last_status = range_status;
+  state.last_range_mm = (range_status == VL53L1X::RangeValid) ? range_mm : Far;
+  state.last_ms = now_ms;
+
+  return raised;
+}
+
+bool VL53L1XRuleEngine::pollAlert(Alert * alert)
+{
+  if (alert_count == 0) { return false; }
+
+  *alert = alerts[alert_head];
+  alert_head = (alert_head + 1) % AlertQueueLength;
+  alert_count--;
+  return true;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Would the first kept rules plus the added ones fit in the compiled tables?
+bool VL53L1XRuleEngine::fits(uint8_t kept, const Rule * added, uint8_t added_count)
+{
+  uint16_t total = 0;
+  for (uint8_t s = 0; s < sensor_count; s++)
+  {
+    uint8_t length = 0;
+    for (uint8_t r = 0; r < kept; r++)
+    {
+      if (applies(rules[r], s)) { length++; }
+    }
+    for (uint8_t r = 0; r < added_count; r++)
+    {
+      if (applies(added[r], s)) { length++; }
+    }
+    if (length > MaxRulesPerSensor) { return false; }
+    total += length;
+  }
+  return total <= max_entries;
+}
+
+bool VL53L1XRuleEngine::applies(const Rule & rule, uint8_t sensor)
+{
+  if (rule.target == TargetAll) { return true; }
+  if (rule.target & TargetGroup)
+  {
+    return sensor_groups != nullptr && sensor_groups[sensor] == (rule.target & ~TargetGroup);
+  }
+  return rule.target == sensor;
+}
+
+void VL53L1XRuleEngine::raise(uint8_t id, uint8_t sensor, uint16_t value, uint32_t now_ms)
+{
+  if (alert_count >= AlertQueueLength)
+  {
+    // keep the oldest alerts and count the ones lost
+    dropped++;
+    return;
+  }
+
+  Alert & alert = alerts[(alert_head + alert_count++) % AlertQueueLength];
+  alert.id = id;
+  alert.sensor = sensor;
+  alert.value = value;
+  alert.timestamp_ms = now_ms;
+}
+
+#endif
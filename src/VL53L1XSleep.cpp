@@ -0,0 +1,202 @@
+#include "VL53L1XSleep.h"
+
+#if VL53L1X_FEATURE_SLEEP
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#endif
+
+volatile bool VL53L1XSleep::woken = false;
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XSleep::VL53L1XSleep(VL53L1X * sensors, Slot * slots, uint8_t count)
+  : sensors(sensors)
+  , slots(slots)
+  , count(count)
+  , stats()
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    slots[i].interrupt_pin = NoPin;
+    slots[i].ready = false;
+    slots[i].polled_early = false;
+    slots[i].period_us = 0;
+    slots[i].last_us = 0;
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XSleep::begin()
+{
+  uint32_t now_us = micros();
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    Slot & slot = slots[i];
+    VL53L1X & sensor = sensors[i];
+
+    slot.last_us = now_us;
+    slot.ready = false;
+    slot.polled_early = false;
+
+    // sensors that aren't ranging (missing ones, say) are left alone
+    if (!sensor.isContinuous()) { continue; }
+
+    // in continuous mode, a measurement takes at least the timing budget
+    // whatever the period
+    uint32_t period_us = sensor.getInterMeasurementPeriod() * 1000;
+    uint32_t budget_us = sensor.getMeasurementTimingBudget();
+    slot.period_us = (period_us > budget_us) ? period_us : budget_us;
+
+    if (slot.interrupt_pin != NoPin)
+    {
+      pinMode(slot.interrupt_pin, INPUT);
+      attachInterrupt(digitalPinToInterrupt(slot.interrupt_pin), onInterrupt, FALLING);
+    }
+  }
+
+  resetStats();
+}
+
+uint8_t VL53L1XSleep::wait(uint16_t timeout_ms)
+{
+  uint32_t start_us = micros();
+
+  for (;;)
+  {
+    // an edge from here on keeps the core from going to sleep below
+    woken = false;
+
+    uint8_t ready = collect(micros());
+    if (ready > 0)
+    {
+      stats.wakes++;
+      return ready;
+    }
+    if ((uint32_t)(micros() - start_us) >= (uint32_t)timeout_ms * 1000)
+    {
+      stats.timeouts++;
+      return 0;
+    }
+
+    uint32_t sleep_us = micros();
+    sleepUntilInterrupt();
+    stats.asleep_us += micros() - sleep_us;
+    stats.sleeps++;
+  }
+}
+
+bool VL53L1XSleep::read(uint8_t index)
+{
+  Slot & slot = slots[index];
+  if (!slot.ready) { return false; }
+
+  uint32_t start_us = micros();
+  sensors[index].read(false);
+  slot.ready = false;
+
+  // follow the sensor's actual interval (its oscillator, and the timing
+  // budget, make it differ from the nominal period), ignoring gaps
+  uint32_t interval_us = start_us - slot.last_us;
+  if (slot.interrupt_pin == NoPin && !slot.polled_early)
+  {
+    // ready at the first poll: the interval measured is just the prediction,
+    // which may be too long, so shorten it until a poll comes too early
+    slot.period_us -= slot.period_us / PeriodShrink;
+  }
+  else if (interval_us < slot.period_us * 4)
+  {
+    slot.period_us += ((int32_t)interval_us - (int32_t)slot.period_us) / 8;
+  }
+  slot.last_us = start_us;
+  slot.polled_early = false;
+
+  stats.samples++;
+  stats.service_us += micros() - start_us;
+  return true;
+}
+
+bool VL53L1XSleep::overdue(uint8_t index, uint16_t timeout_ms)
+{
+  return (uint32_t)(micros() - slots[index].last_us) > (uint32_t)timeout_ms * 1000;
+}
+
+void VL53L1XSleep::resetStats()
+{
+  stats = Stats();
+  stats.start_us = micros();
+}
+
+uint16_t VL53L1XSleep::getDutyCycle()
+{
+  uint32_t total_us = micros() - stats.start_us;
+  if (total_us == 0 || stats.asleep_us >= total_us) { return 0; }
+  return (uint64_t)(total_us - stats.asleep_us) * 1000 / total_us;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Mark the sensors that have a measurement ready; returns how many there are
+uint8_t VL53L1XSleep::collect(uint32_t now_us)
+{
+  uint8_t ready = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    Slot & slot = slots[i];
+    VL53L1X & sensor = sensors[i];
+
+    if (!slot.ready && sensor.isContinuous())
+    {
+      if (slot.interrupt_pin != NoPin)
+      {
+        // GPIO1 is active low and stays low until the interrupt is cleared
+        slot.ready = digitalRead(slot.interrupt_pin) == LOW;
+      }
+      else if ((uint32_t)(now_us - slot.last_us) >= slot.period_us)
+      {
+        slot.ready = sensor.dataReady() && sensor.last_status == 0;
+        if (!slot.ready)
+        {
+          slot.polled_early = true;
+          stats.early_polls++;
+        }
+      }
+    }
+
+    ready += slot.ready;
+  }
+
+  return ready;
+}
+
+// Sleep until the next interrupt, unless one has already set woken. Interrupts
+// are disabled around the check so that one arriving between the check and
+// the sleep still ends the sleep (it stays pending) instead of being missed.
+void VL53L1XSleep::sleepUntilInterrupt()
+{
+#if defined(__arm__)
+  __asm__ volatile ("cpsid i" ::: "memory");
+  if (!woken) { __asm__ volatile ("dsb\n\twfi" ::: "memory"); }
+  __asm__ volatile ("cpsie i" ::: "memory");
+#elif defined(__AVR__)
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  if (!woken)
+  {
+    sleep_enable();
+    sei(); // the instruction after sei is always executed: no window
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+#else
+  // no sleep instruction known for this core
+  yield();
+#endif
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include "VL53L1XSupervisor.h"
+
+#if VL53L1X_FEATURE_SUPERVISOR
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XSupervisor::VL53L1XSupervisor(VL53L1X * sensors, SensorHealth * health, uint8_t count)
+  : sensors(sensors)
+  , health(health)
+  , count(count)
+  , stale_limit(5)
+  , hw_fail_limit(5)
+  , timeout_limit(3)
+  , backoff_initial_ms(10)
+  , backoff_max_ms(5000)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    health[i] = SensorHealth();
+    health[i].state = Healthy;
+    health[i].reason = NoFault;
+    health[i].state_since_ms = millis();
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+// Record the outcome of a read() of sensor index. timed_out should be the
+// value of timeoutOccurred() right after the read.
+void VL53L1XSupervisor::sample(uint8_t index, bool timed_out)
+{
+  SensorHealth & h = health[index];
+  VL53L1X & sensor = sensors[index];
+
+  if (h.state != Healthy) { return; }
+
+  if (timed_out)
+  {
+    if (++h.timeout_count >= timeout_limit) { quarantine(index, Timeouts); }
+    return;
+  }
+  h.timeout_count = 0;
+
+  uint8_t stream_count = sensor.getStreamCount();
+  if (stream_count == h.last_stream_count)
+  {
+    if (++h.stale_count >= stale_limit) { quarantine(index, Stale); return; }
+  }
+  else
+  {
+    h.stale_count = 0;
+    h.last_stream_count = stream_count;
+  }
+
+  if (sensor.ranging_data.range_status == VL53L1X::HardwareFail)
+  {
+    if (++h.hw_fail_count >= hw_fail_limit) { quarantine(index, Hardware); }
+  }
+  else
+  {
+    h.hw_fail_count = 0;
+  }
+}
+
+// Advance the recovery of every quarantined sensor by at most one step. Each
+// step is a pin change or, once the sensor has booted, a restoreConfig() of a
+// few bursts, so this is cheap to call on every loop.
+void VL53L1XSupervisor::service()
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (health[i].state == Quarantined || health[i].state == Booting)
+    {
+      step(i);
+    }
+  }
+}
+
+uint8_t VL53L1XSupervisor::activeCount()
+{
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (health[i].state == Healthy) { n++; }
+  }
+  return n;
+}
+
+// Take a sensor out of the schedule and start recovering it
+void VL53L1XSupervisor::quarantine(uint8_t index, Reason reason)
+{
+  SensorHealth & h = health[index];
+  VL53L1X & sensor = sensors[index];
+
+  h.reason = reason;
+  h.quarantines++;
+  h.attempts = 0;
+  h.backoff_ms = backoff_initial_ms;
+
+  VL53L1X::ConfigSnapshot * cache = sensor.getConfigCache();
+  if (cache == nullptr || !cache->valid || !sensor.powerOff())
+  {
+    setState(h, Disabled);
+    return;
+  }
+
+  setState(h, Quarantined);
+}
+
+// Put a sensor back in the schedule, e.g. after reinitializing it by hand
+void VL53L1XSupervisor::rejoin(uint8_t index)
+{
+  SensorHealth & h = health[index];
+
+  resetCounters(h);
+  h.reason = NoFault;
+  setState(h, Healthy);
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+void VL53L1XSupervisor::setState(SensorHealth & h, State state)
+{
+  h.state = state;
+  h.state_since_ms = millis();
+}
+
+void VL53L1XSupervisor::resetCounters(SensorHealth & h)
+{
+  h.stale_count = 0;
+  h.hw_fail_count = 0;
+  h.timeout_count = 0;
+  h.attempts = 0;
+}
+
+void VL53L1XSupervisor::step(uint8_t index)
+{
+  SensorHealth & h = health[index];
+  VL53L1X & sensor = sensors[index];
+  uint16_t elapsed_ms = millis() - h.state_since_ms;
+
+  switch (h.state)
+  {
+    case Quarantined:
+      // powerOn() refuses while another sensor on the bus is booting (they
+      // all boot at the default address); it is tried again next time
+      if (elapsed_ms >= PowerOffMs && elapsed_ms >= h.backoff_ms && sensor.powerOn())
+      {
+        setState(h, Booting);
+      }
+      break;
+
+    case Booting:
+      if (elapsed_ms < BootMs) { break; }
+
+      if (sensor.restoreConfig(RestoreTimeoutMs))
+      {
+        resetCounters(h);
+        // getStreamCount() is still the count read before the quarantine; a
+        // first new count that happens to match it costs one stale read
+        h.last_stream_count = sensor.getStreamCount();
+        h.restores++;
+        setState(h, Healthy);
+      }
+      else
+      {
+        sensor.powerOff();
+        h.attempts++;
+        h.backoff_ms = (h.backoff_ms > backoff_max_ms / 2) ? backoff_max_ms : h.backoff_ms * 2;
+        setState(h, Quarantined);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+#endif
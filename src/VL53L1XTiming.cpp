@@ -0,0 +1,301 @@
+#include "VL53L1XTiming.h"
+
+#if VL53L1X_FEATURE_TIMING
+
+#include <math.h>
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XTiming::VL53L1XTiming(VL53L1X * sensors, uint8_t count, Result * results)
+  : sensors(sensors)
+  , count(count)
+  , results(results)
+  , pins(nullptr)
+  , configs(nullptr)
+  , config_count(0)
+  , samples(0)
+  , sensor(count) // done until begin()
+  , config(0)
+  , phase(Start)
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XTiming::begin(const Config * configs, uint8_t config_count, uint16_t samples)
+{
+  this->configs = configs;
+  this->config_count = config_count;
+  this->samples = samples;
+
+  for (uint16_t i = 0; i < (uint16_t)count * config_count; i++) { results[i] = Result(); }
+
+  sensor = (config_count > 0 && samples > 0) ? 0 : count;
+  config = 0;
+  phase = Start;
+}
+
+bool VL53L1XTiming::update()
+{
+  if (done()) { return true; }
+  if (phase == Start)
+  {
+    startRun();
+    return done();
+  }
+
+  VL53L1X & s = sensors[sensor];
+  Result & r = current();
+  uint8_t pin = (pins != nullptr) ? pins[sensor] : NoPin;
+
+  // the data became ready between the previous check and this one, so a long
+  // gap (the loop was busy elsewhere) makes the ready time imprecise
+  uint32_t poll_start_us = micros();
+  bool precise = (uint32_t)(poll_start_us - last_poll_us) <= MaxPollGapUs;
+  last_poll_us = poll_start_us;
+  bool ready;
+  if (pin != NoPin)
+  {
+    // GPIO1 is active low and stays low until the interrupt is cleared
+    ready = digitalRead(pin) == LOW;
+  }
+  else
+  {
+    ready = s.dataReady();
+    sum_poll_us += micros() - poll_start_us;
+    polls++;
+    if (s.last_status != 0)
+    {
+      fail();
+      return done();
+    }
+  }
+
+  if (!ready)
+  {
+    if ((uint32_t)(poll_start_us - wait_start_us) > 2 * r.nominal_us + DataReadyMarginMs * 1000UL) { fail(); }
+    return done();
+  }
+
+  uint32_t read_start_us = micros();
+  s.read(false);
+  uint32_t read_us = micros() - read_start_us;
+  wait_start_us = poll_start_us;
+
+  if (s.last_status != 0)
+  {
+    fail();
+    return done();
+  }
+
+  if (phase == Warmup)
+  {
+    if (--warmup == 0) { phase = Measure; }
+    last_ready_us = poll_start_us;
+    last_stream = s.getStreamCount();
+    last_precise = precise;
+    return false;
+  }
+
+  sample(poll_start_us, precise, read_us);
+  return done();
+}
+
+void VL53L1XTiming::print(Print & out)
+{
+  static const char * const modes[] = {"short", "medium", "long", "?"};
+
+  out.println("sensor\tmode\tbudget_us\tperiod_ms\tnominal_us\tactual_us\terror_ppm\tjitter_us\tmin_us\tmax_us\t"
+              "missed\tlate\tread_us\tread_max_us\tpoll_us\tbus_permille\terrors");
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    for (uint8_t c = 0; c < config_count; c++)
+    {
+      const Config & config = configs[c];
+      const Result & r = getResult(i, c);
+
+      out.print(i); out.print('\t');
+      out.print(modes[config.distance_mode]); out.print('\t');
+      out.print(config.budget_us); out.print('\t');
+      out.print(config.period_ms); out.print('\t');
+      if (r.samples == 0)
+      {
+        out.println(r.errors > 0 ? "failed" : "skipped");
+        continue;
+      }
+      out.print(r.nominal_us); out.print('\t');
+      out.print(r.period_us); out.print('\t');
+      out.print(r.error_ppm); out.print('\t');
+      out.print(r.jitter_us); out.print('\t');
+      out.print(r.min_us); out.print('\t');
+      out.print(r.max_us); out.print('\t');
+      out.print(r.missed); out.print('\t');
+      out.print(r.late); out.print('\t');
+      out.print(r.read_us); out.print('\t');
+      out.print(r.read_max_us); out.print('\t');
+      out.print(r.poll_us); out.print('\t');
+      out.print(r.busy_permille); out.print('\t');
+      out.println(r.errors);
+    }
+  }
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Apply the current configuration to the current sensor and start ranging
+void VL53L1XTiming::startRun()
+{
+  VL53L1X & s = sensors[sensor];
+
+  if (config == 0)
+  {
+    // sensors that aren't ranging (missing ones, say) are left alone
+    if (!s.isContinuous())
+    {
+      sensor++;
+      return;
+    }
+    saved_mode = s.getDistanceMode();
+    saved_budget_us = s.getMeasurementTimingBudget();
+    saved_period_ms = s.getInterMeasurementPeriod();
+  }
+
+  const Config & c = configs[config];
+  Result & r = current();
+  r.nominal_us = (c.period_ms * 1000 > c.budget_us) ? c.period_ms * 1000 : c.budget_us;
+  r.min_us = UINT32_MAX;
+
+  s.stopContinuous();
+  if (!s.setDistanceMode(c.distance_mode) || !s.setMeasurementTimingBudget(c.budget_us))
+  {
+    r.errors = MaxErrors;
+    nextRun();
+    return;
+  }
+  s.startContinuous(c.period_ms);
+
+  sum_dev = 0;
+  sum_dev2 = 0;
+  sum_read_us = 0;
+  sum_poll_us = 0;
+  polls = 0;
+  warmup = WarmupSamples;
+  phase = Warmup;
+  wait_start_us = micros();
+  last_poll_us = wait_start_us;
+}
+
+// Record one data-ready period, ending at ready_us
+void VL53L1XTiming::sample(uint32_t ready_us, bool precise, uint32_t read_us)
+{
+  Result & r = current();
+  uint8_t stream = sensors[sensor].getStreamCount();
+  uint8_t elapsed = streamGap(last_stream, stream);
+
+  // a stream count that didn't move means the data-ready check was wrong
+  if (elapsed == 0)
+  {
+    fail();
+    return;
+  }
+
+  r.missed += elapsed - 1;
+  uint32_t period_us = (ready_us - last_ready_us) / elapsed;
+  bool counted = precise && last_precise;
+  last_ready_us = ready_us;
+  last_stream = stream;
+  last_precise = precise;
+
+  if (!counted)
+  {
+    // give up on a loop that never checks often enough
+    if (++r.late >= samples)
+    {
+      finishRun();
+      nextRun();
+    }
+    return;
+  }
+
+  int32_t dev = (int32_t)(period_us - r.nominal_us);
+  sum_dev += dev;
+  sum_dev2 += (int64_t)dev * dev;
+  if (period_us < r.min_us) { r.min_us = period_us; }
+  if (period_us > r.max_us) { r.max_us = period_us; }
+
+  sum_read_us += read_us;
+  if (read_us > r.read_max_us) { r.read_max_us = read_us; }
+
+  if (++r.samples >= samples)
+  {
+    finishRun();
+    nextRun();
+  }
+}
+
+// Count an error; after too many, give up on this run with what it has
+void VL53L1XTiming::fail()
+{
+  Result & r = current();
+  r.errors++;
+  wait_start_us = micros();
+
+  if (r.errors >= MaxErrors)
+  {
+    finishRun();
+    nextRun();
+    return;
+  }
+
+  // a sample may have been lost: measure from the next one
+  phase = Warmup;
+  warmup = 1;
+}
+
+void VL53L1XTiming::finishRun()
+{
+  Result & r = current();
+  if (r.samples == 0)
+  {
+    r.min_us = 0;
+    return;
+  }
+
+  float mean_dev = (float)sum_dev / r.samples;
+  float variance = (float)sum_dev2 / r.samples - mean_dev * mean_dev;
+  r.period_us = r.nominal_us + (int32_t)lroundf(mean_dev);
+  r.jitter_us = (variance > 0) ? (uint32_t)lroundf(sqrtf(variance)) : 0;
+  r.error_ppm = (int32_t)(mean_dev * 1e6f / r.nominal_us);
+  r.read_us = sum_read_us / r.samples;
+  r.poll_us = (polls > 0) ? sum_poll_us / polls : 0;
+  uint32_t busy = (uint32_t)(r.read_us + r.poll_us) * 1000 / ((r.period_us > 0) ? r.period_us : 1);
+  r.busy_permille = (busy < 0xFFFF) ? busy : 0xFFFF;
+}
+
+// Move on to the next configuration, or to the next sensor once this one has
+// been through all of them, giving it back its own configuration
+void VL53L1XTiming::nextRun()
+{
+  phase = Start;
+  if (++config < config_count) { return; }
+
+  VL53L1X & s = sensors[sensor];
+  s.stopContinuous();
+  if (saved_mode != VL53L1X::Unknown) { s.setDistanceMode(saved_mode); }
+  s.setMeasurementTimingBudget(saved_budget_us);
+  s.startContinuous(saved_period_ms);
+
+  config = 0;
+  sensor++;
+}
+
+// measurements from stream count from to stream count to: the count runs
+// 0-255, then wraps to 128
+uint8_t VL53L1XTiming::streamGap(uint8_t from, uint8_t to)
+{
+  if (to >= from) { return to - from; }
+  return (255 - from) + (to - 128) + 1;
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include "VL53L1XTrend.h"
+
+#if VL53L1X_FEATURE_TREND
+
+#include <math.h>
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XTrend::VL53L1XTrend(Track * tracks, uint8_t count)
+  : tracks(tracks)
+  , count(count)
+  , epoch_ms(60000)
+  , learn_samples(1000)
+  , horizon(10080) // a week of one minute epochs
+  , validity_loss(0)
+  , signal_loss(0)
+  , ambient_rise(0)
+{
+  setSignalLoss(30);
+  setValidityLoss(10);
+  setAmbientRise(100);
+
+  uint32_t now_ms = millis();
+  for (uint8_t i = 0; i < count; i++)
+  {
+    tracks[i] = Track();
+    for (uint8_t b = 0; b < Bands; b++)
+    {
+      tracks[i].validity[b] = 0xFFFF;
+      tracks[i].validity_baseline[b] = 0xFFFF;
+    }
+    tracks[i].epoch_start_ms = now_ms;
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XTrend::setSignalLoss(uint8_t percent)
+{
+  if (percent >= 100) { percent = 99; }
+  signal_loss = log2f(1 - percent / 100.0f);
+}
+
+bool VL53L1XTrend::sample(uint8_t index, uint16_t range_mm, uint8_t range_status,
+                          uint16_t signal_rate_fixed, uint16_t ambient_rate_fixed)
+{
+  Track & t = tracks[index];
+  bool valid = range_status == VL53L1X::RangeValid && range_mm > 0 && signal_rate_fixed > 0;
+
+  if (valid)
+  {
+    float x = log2f(range_mm / 1000.0f);
+    float y = log2f(signal_rate_fixed / (float)(1 << 7));
+
+    t.sw += 1;
+    t.sx += x;
+    t.sy += y;
+    t.sxx += x * x;
+    t.sxy += x * y;
+
+    t.band = bandOf(range_mm);
+    if (t.samples < 0xFFFF) { t.samples++; }
+  }
+
+  // invalid readings often have no usable range, so they count against the
+  // band of the last valid one
+  uint16_t & validity = t.validity[valid ? bandOf(range_mm) : t.band];
+  validity += ((int32_t)(valid ? 0xFFFF : 0) - validity) / (1 << 8);
+
+  float ambient = ambient_rate_fixed / (float)(1 << 7);
+  t.ambient += (ambient - t.ambient) / (1 << AmbientShift);
+
+  uint32_t now_ms = millis();
+  if (now_ms - t.epoch_start_ms < epoch_ms) { return false; }
+
+  // don't try to catch up on epochs missed while not sampling
+  t.epoch_start_ms = (now_ms - t.epoch_start_ms < 2 * epoch_ms) ? t.epoch_start_ms + epoch_ms : now_ms;
+  endEpoch(t);
+
+  if (learning(index)) { return false; }
+
+  if (!t.baselined)
+  {
+    // learning just ended: the epochs so far are the baseline
+    if (t.tw == 0) { return false; }
+    t.baselined = true;
+    t.baseline = t.ty / t.tw;
+    t.ambient_baseline = t.ambient;
+    for (uint8_t b = 0; b < Bands; b++) { t.validity_baseline[b] = t.validity[b]; }
+  }
+
+  uint8_t flags = evaluate(t);
+  bool changed = flags != t.flags;
+  t.flags = flags;
+  return changed;
+}
+
+bool VL53L1XTrend::sample(uint8_t index, const VL53L1X::RangingData & data)
+{
+#if VL53L1X_FEATURE_FLOAT_RATES
+  return sample(index, data.range_mm, data.range_status,
+                data.peak_signal_count_rate_MCPS * (1 << 7), data.ambient_count_rate_MCPS * (1 << 7));
+#else
+  return sample(index, data.range_mm, data.range_status,
+                data.peak_signal_count_rate_fixed, data.ambient_count_rate_fixed);
+#endif
+}
+
+uint16_t VL53L1XTrend::getSignalPercent(uint8_t index)
+{
+  const Track & t = tracks[index];
+  if (!t.baselined) { return 100; }
+
+  float slope, level;
+  fitTrend(t, &slope, &level);
+  float percent = 100 * exp2f(level - t.baseline);
+  return (percent > 0xFFFF) ? 0xFFFF : (uint16_t)lroundf(percent);
+}
+
+float VL53L1XTrend::getTrendPercent(uint8_t index)
+{
+  float slope, level;
+  fitTrend(tracks[index], &slope, &level);
+  return 100 * (exp2f(slope) - 1);
+}
+
+uint16_t VL53L1XTrend::getEpochsToLoss(uint8_t index)
+{
+  const Track & t = tracks[index];
+  float slope, level;
+  if (!t.baselined || !fitTrend(t, &slope, &level) || slope >= 0) { return 0xFFFF; }
+
+  float epochs = (signal_loss - (level - t.baseline)) / slope;
+  if (epochs <= 0) { return 0; }
+  return (epochs >= 0xFFFF) ? 0xFFFF : (uint16_t)epochs;
+}
+
+void VL53L1XTrend::rebaseline(uint8_t index)
+{
+  Track & t = tracks[index];
+
+  // the old trend is about the old window
+  t.tw = t.tt = t.ty = t.ttt = t.tty = t.tyy = 0;
+  t.baselined = false;
+  t.samples = 0;
+  t.flags = 0;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Intercept of the signal vs range fit at 1 m (x = 0), with the slope pulled
+// towards PriorSlope by PriorWeight so it stays defined when every reading is
+// at the same range
+float VL53L1XTrend::signalAt1m(const Track & t)
+{
+  if (t.sw == 0) { return 0; }
+
+  float mean_x = t.sx / t.sw;
+  float mean_y = t.sy / t.sw;
+  float cxx = t.sxx - t.sx * mean_x;
+  float cxy = t.sxy - t.sx * mean_y;
+  float slope = (cxy + PriorWeight * PriorSlope) / (cxx + PriorWeight);
+  return mean_y - slope * mean_x;
+}
+
+// Fit the 1 m signal vs epoch; returns true if the slope is significant. level
+// is the fitted signal at the current epoch (the mean, with too few epochs for
+// a slope).
+bool VL53L1XTrend::fitTrend(const Track & t, float * slope, float * level)
+{
+  *slope = 0;
+  *level = (t.tw > 0) ? t.ty / t.tw : t.baseline;
+  if (t.tw < MinEpochs) { return false; }
+
+  float ctt = t.ttt - t.tt * t.tt / t.tw;
+  if (ctt <= 0) { return false; }
+
+  *slope = (t.tty - t.tt * t.ty / t.tw) / ctt;
+  *level = (t.ty - *slope * t.tt) / t.tw;
+
+  // residual sum of squares, from the normal equations
+  float sse = t.tyy - *level * t.ty - *slope * t.tty;
+  if (sse < 0) { sse = 0; }
+  float variance = sse / (t.tw - 2) / ctt;
+  return *slope * *slope > MinSignificance * MinSignificance * variance;
+}
+
+// Age the trend by one epoch (every t goes down by one) and add this epoch's
+// 1 m signal at t = 0, if there were enough valid readings
+void VL53L1XTrend::endEpoch(Track & t)
+{
+  const float keep = 1 - 1.0f / TrendHorizon;
+
+  t.ttt = (t.ttt - 2 * t.tt + t.tw) * keep;
+  t.tt = (t.tt - t.tw) * keep;
+  t.tty = (t.tty - t.ty) * keep;
+  t.tw *= keep;
+  t.ty *= keep;
+  t.tyy *= keep;
+
+  if (t.sw >= MinEpochSamples)
+  {
+    float y = signalAt1m(t);
+    t.tw += 1;
+    t.ty += y;
+    t.tyy += y * y;
+  }
+  t.sw = t.sx = t.sy = t.sxx = t.sxy = 0;
+}
+
+uint8_t VL53L1XTrend::evaluate(Track & t)
+{
+  uint8_t flags = 0;
+
+  float slope, level;
+  bool significant = fitTrend(t, &slope, &level);
+  if (level - t.baseline <= signal_loss) { flags |= SignalLow; }
+
+  if (significant && slope < 0)
+  {
+    float remaining = signal_loss - (level - t.baseline);
+    if (remaining < 0 && remaining / slope <= horizon) { flags |= SignalFalling; }
+  }
+
+  if (t.ambient > AmbientFloor && t.ambient > t.ambient_baseline * ambient_rise) { flags |= AmbientHigh; }
+
+  for (uint8_t b = 0; b < Bands; b++)
+  {
+    if (t.validity[b] + validity_loss < t.validity_baseline[b]) { flags |= ValidityLow; }
+  }
+
+  return flags;
+}
+
+uint8_t VL53L1XTrend::bandOf(uint16_t range_mm)
+{
+  if (range_mm < 1000) { return 0; }
+  if (range_mm < 2000) { return 1; }
+  return 2;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "VL53L1XWriteQueue.h"
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XWriteQueue::VL53L1XWriteQueue(VL53L1X & sensor)
+  : sensor(sensor)
+  , owner(sensor.queue == nullptr)
+  , count(0)
+  , transactions(0)
+{
+  if (owner) { sensor.queue = this; }
+}
+
+VL53L1XWriteQueue::~VL53L1XWriteQueue()
+{
+  if (owner)
+  {
+    flush();
+    sensor.queue = nullptr;
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XWriteQueue::write(uint16_t reg, uint32_t value)
+{
+  // goes through the sensor so it ends up in whichever queue is active
+  switch (VL53L1XRegisters::width(reg))
+  {
+    case 4:  sensor.writeReg32Bit(reg, value); break;
+    case 2:  sensor.writeReg16Bit(reg, value); break;
+    default: sensor.writeReg(reg, value); break;
+  }
+}
+
+bool VL53L1XWriteQueue::flush()
+{
+  if (!owner) { return sensor.queue->flush(); }
+
+  uint8_t i = 0;
+  while (i < count)
+  {
+    // extend the run while the registers are consecutive and in one block
+    uint8_t n = 1;
+    while (i + n < count &&
+           regs[i + n] == regs[i + n - 1] + 1 &&
+           VL53L1XRegisters::block(regs[i + n]) == VL53L1XRegisters::block(regs[i]))
+    {
+      n++;
+    }
+
+    // values[] is sorted along with regs[], so the run is already a burst
+    sensor.writeMulti(regs[i], &values[i], n);
+    transactions++;
+    if (sensor.last_status != 0)
+    {
+      // drop what was sent, keep the rest for a retry
+      count -= i + n;
+      memmove(regs, regs + i + n, count * sizeof(regs[0]));
+      memmove(values, values + i + n, count);
+      return false;
+    }
+
+    i += n;
+  }
+
+  count = 0;
+  return true;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Queue a write of width bytes (big-endian, like the sensor). Returns false if
+// the caller has to send it directly instead.
+bool VL53L1XWriteQueue::add(uint16_t reg, uint32_t value, uint8_t width)
+{
+  if (VL53L1XRegisters::access(reg) == VL53L1XRegisters::Command)
+  {
+    flush();
+    return false;
+  }
+
+  if (count + width > Capacity)
+  {
+    // a failed flush keeps what it couldn't send, so there may still be no
+    // room: send this one directly, dropping any older value of it that is
+    // still queued so that a later flush can't overwrite it
+    if (!flush() && count + width > Capacity)
+    {
+      removeBytes(reg, width);
+      return false;
+    }
+  }
+
+  for (uint8_t i = 0; i < width; i++)
+  {
+    addByte(reg + i, (uint8_t)(value >> (8 * (width - 1 - i))));
+  }
+  return true;
+}
+
+// If every byte of the register is pending, return its value in *value
+bool VL53L1XWriteQueue::pending(uint16_t reg, uint8_t width, uint32_t * value)
+{
+  uint32_t v = 0;
+
+  for (uint8_t i = 0; i < width; i++)
+  {
+    uint8_t j = 0;
+    while (j < count && regs[j] < reg + i) { j++; }
+    if (j == count || regs[j] != reg + i) { return false; }
+    v = (v << 8) | values[j];
+  }
+
+  *value = v;
+  return true;
+}
+
+// insertion into the sorted arrays, replacing any earlier value
+void VL53L1XWriteQueue::addByte(uint16_t reg, uint8_t value)
+{
+  uint8_t i = count;
+  while (i > 0 && regs[i - 1] > reg) { i--; }
+
+  if (i > 0 && regs[i - 1] == reg)
+  {
+    values[i - 1] = value;
+    return;
+  }
+
+  memmove(regs + i + 1, regs + i, (count - i) * sizeof(regs[0]));
+  memmove(values + i + 1, values + i, count - i);
+  regs[i] = reg;
+  values[i] = value;
+  count++;
+}
+
+// Drop any pending bytes of registers reg to reg + width - 1
+void VL53L1XWriteQueue::removeBytes(uint16_t reg, uint8_t width)
+{
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (regs[i] >= reg && regs[i] < reg + width) { continue; }
+    regs[kept] = regs[i];
+    values[kept] = values[i];
+    kept++;
+  }
+  count = kept;
+}
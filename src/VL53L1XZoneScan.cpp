@@ -0,0 +1,229 @@
+#include "VL53L1XZoneScan.h"
+
+#if VL53L1X_FEATURE_ZONE_SCAN
+
+#include "VL53L1XWriteQueue.h"
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+VL53L1XZoneScan::VL53L1XZoneScan(VL53L1X & sensor)
+  : sensor(sensor)
+  , refine_budget(2)
+  , max_range_mm(2000)
+  , discontinuity_mm(150)
+  , plan_length(QuadrantCount)
+  , step(0)
+  , refined(0)
+  , frame_start_ms(0)
+  , synced(false)
+  , expected_stream(-1)
+  , resyncs(0)
+  , frame()
+{
+  for (uint8_t q = 0; q < QuadrantCount; q++)
+  {
+    plan[q] = q;
+    quadrants[q].range_mm = NoTarget;
+    quadrants[q].previous_mm = NoTarget;
+    quadrants[q].waiting = 0;
+  }
+  for (uint8_t i = 0; i < CellCount; i++) { cells[i] = NoTarget; }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void VL53L1XZoneScan::begin()
+{
+  step = 0;
+  plan_length = QuadrantCount;
+  refined = 0;
+  synced = !sensor.isContinuous();
+  expected_stream = -1;
+  program();
+}
+
+// Take the next sample if there is one, and program the ROI for the one after
+bool VL53L1XZoneScan::update()
+{
+  if (!sensor.dataReady()) { return false; }
+
+  sensor.read(false);
+
+  // after a gap in the stream count, the zone of this result isn't known;
+  // program() then sets up the same zone again
+  uint8_t stream = sensor.getStreamCount();
+  bool in_step = synced && (expected_stream < 0 || stream == expected_stream);
+  synced = true;
+  expected_stream = VL53L1X::nextStreamCount(stream);
+
+  bool done = false;
+  if (in_step) { done = process(sensor.ranging_data.range_mm, sensor.ranging_data.range_status, millis()); }
+  else { resyncs++; }
+
+  program();
+  return done;
+}
+
+// Store a sample for the zone currently in the plan and move on. After the
+// coarse pass, the quadrants to refine are added to the plan.
+bool VL53L1XZoneScan::process(uint16_t range_mm, uint8_t range_status, uint32_t now_ms)
+{
+  uint8_t zone = plan[step];
+  uint16_t value = (range_status == VL53L1X::RangeValid) ? range_mm : NoTarget;
+
+  if (step == 0) { frame_start_ms = now_ms; }
+
+  if (zone < FirstCell)
+  {
+    quadrants[zone].range_mm = value;
+  }
+  else
+  {
+    cells[zone - FirstCell] = value;
+  }
+
+  if (++step == QuadrantCount && plan_length == QuadrantCount) { refine(); }
+
+  if (step < plan_length) { return false; }
+
+  finishFrame(now_ms);
+  step = 0;
+  plan_length = QuadrantCount;
+  return true;
+}
+
+// Returns the center SPAD of an ROI, following the table above
+// VL53L1X::setROICenter(). For an even size, the center is between SPADs and
+// the one in the row above and the column to the right of it is used (the
+// default 199 is the center of the whole array).
+uint8_t VL53L1XZoneScan::roiCenter(uint8_t row, uint8_t column, uint8_t width, uint8_t height)
+{
+  uint8_t x = column + width / 2;
+  uint8_t y = row + (height - 1) / 2;
+
+  if (y < 8) { return 128 + x * 8 + y; }
+  return (15 - x) * 8 + (15 - y);
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+uint8_t VL53L1XZoneScan::center(uint8_t zone)
+{
+  if (zone < FirstCell)
+  {
+    return roiCenter((zone / 2) * 8, (zone % 2) * 8, 8, 8);
+  }
+  zone -= FirstCell;
+  return roiCenter((zone / GridSize) * 4, (zone % GridSize) * 4, 4, 4);
+}
+
+uint8_t VL53L1XZoneScan::size(uint8_t zone)
+{
+  return (zone < FirstCell) ? 8 : 4;
+}
+
+// Program the ROI of the next zone in the plan; size and center are adjacent
+// registers, so this is a single transaction
+void VL53L1XZoneScan::program()
+{
+  VL53L1XWriteQueue batch(sensor);
+
+  uint8_t zone = plan[step];
+  sensor.setROISize(size(zone), size(zone));
+  sensor.setROICenter(center(zone));
+}
+
+// Pick the quadrants to refine this frame and add their cells to the plan
+void VL53L1XZoneScan::refine()
+{
+  uint32_t scores[QuadrantCount];
+
+  for (uint8_t q = 0; q < QuadrantCount; q++)
+  {
+    Quadrant & quadrant = quadrants[q];
+
+    // compare with no target counted as max range
+    uint16_t range = (quadrant.range_mm < max_range_mm) ? quadrant.range_mm : max_range_mm;
+    uint16_t previous = (quadrant.previous_mm < max_range_mm) ? quadrant.previous_mm : max_range_mm;
+    quadrant.previous_mm = quadrant.range_mm;
+
+    // the neighbours are the quadrants beside (q ^ 1) and above or below (q ^ 2).
+    // A quadrant reports its nearest target, so an edge between two quadrants
+    // lies in the nearer one: the farther one doesn't see the target at all.
+    uint16_t discontinuity = 0;
+    for (uint8_t n = 1; n <= 2; n++)
+    {
+      uint16_t other = quadrants[q ^ n].range_mm;
+      if (other > max_range_mm) { other = max_range_mm; }
+      if (other > range && other - range > discontinuity) { discontinuity = other - range; }
+    }
+
+    uint16_t change = (range > previous) ? range - previous : previous - range;
+    bool target = range < max_range_mm;
+
+    if (!target && discontinuity <= discontinuity_mm && change <= discontinuity_mm)
+    {
+      scores[q] = 0;
+      quadrant.waiting = 0;
+      continue;
+    }
+
+    // changes and edges first; candidates passed over before catch up
+    scores[q] = 1 + change + discontinuity + (uint32_t)quadrant.waiting * discontinuity_mm;
+  }
+
+  for (uint8_t n = 0; n < refine_budget; n++)
+  {
+    uint8_t best = 0;
+    for (uint8_t q = 1; q < QuadrantCount; q++)
+    {
+      if (scores[q] > scores[best]) { best = q; }
+    }
+    if (scores[best] == 0) { break; }
+    scores[best] = 0;
+
+    refined |= 1 << best;
+    quadrants[best].waiting = 0;
+
+    uint8_t row = (best / 2) * 2;
+    uint8_t column = (best % 2) * 2;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      plan[plan_length++] = FirstCell + (row + i / 2) * GridSize + column + i % 2;
+    }
+  }
+
+  for (uint8_t q = 0; q < QuadrantCount; q++)
+  {
+    if (scores[q] != 0 && quadrants[q].waiting < 0xFFFF) { quadrants[q].waiting++; }
+  }
+}
+
+void VL53L1XZoneScan::finishFrame(uint32_t now_ms)
+{
+  for (uint8_t i = 0; i < CellCount; i++)
+  {
+    uint8_t row = i / GridSize;
+    uint8_t column = i % GridSize;
+    uint8_t q = (row / 2) * 2 + column / 2;
+
+    if (refined & (1 << q))
+    {
+      frame.range_mm[i] = cells[i];
+      frame.level[i] = 2;
+    }
+    else
+    {
+      frame.range_mm[i] = quadrants[q].range_mm;
+      frame.level[i] = 1;
+    }
+  }
+
+  frame.timestamp_ms = now_ms;
+  frame.duration_ms = now_ms - frame_start_ms;
+  frame.measurements = plan_length;
+  frame.refined = refined;
+  refined = 0;
+}
+
+#endif
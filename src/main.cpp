@@ -1,5 +1,15 @@
 #include <Wire.h>
 #include <VL53L1X.h>
+#include <VL53L1XRecovery.h>
+#include <VL53L1XSupervisor.h>
+#include <VL53L1XControl.h>
+#include <VL53L1XRuleEngine.h>
+#include <VL53L1XEnumerator.h>
+#include <VL53L1XSleep.h>
+#include <VL53L1XTrend.h>
+#include <VL53L1XBusClock.h>
+#include <VL53L1XTiming.h>
+#include <VL53L1XRouter.h>
 
 
 const uint8_t sensorCount = 1;
@@ -8,6 +18,98 @@ const uint8_t sensorCount = 1;
 const uint8_t xshutPins[sensorCount] = {33};
 
 VL53L1X sensors[sensorCount];
+bool sensorPresent[sensorCount];
+
+#if VL53L1X_FEATURE_RESTORE
+VL53L1X::ConfigSnapshot sensorConfigs[sensorCount];
+#endif
+
+#if VL53L1X_FEATURE_SUPERVISOR
+VL53L1XSupervisor::SensorHealth sensorHealth[sensorCount];
+VL53L1XSupervisor supervisor(sensors, sensorHealth, sensorCount);
+#endif
+
+#if VL53L1X_FEATURE_RECOVERY
+// Wire on the Teensy 4.1 uses pins 18 (SDA) and 19 (SCL).
+VL53L1XRecovery recovery(&Wire, 18, 19, 400000);
+#endif
+
+#if VL53L1X_FEATURE_BUS_CLOCK
+// I2C rates for Wire, fastest first: once the sensors are up, the bus runs at
+// 1 MHz (Fast-mode Plus) when the wiring allows and falls back if transactions
+// start failing.
+const uint32_t wireRates[] = {1000000, 400000, 100000};
+VL53L1XBusClock busClock;
+#endif
+
+#if VL53L1X_FEATURE_RULES
+// Alert rules; more can be pushed over the control plane.
+VL53L1XRuleEngine::Rule alertRules[8];
+VL53L1XRuleEngine::Entry ruleEntries[8 * sensorCount];
+VL53L1XRuleEngine::SensorState ruleStates[sensorCount];
+VL53L1XRuleEngine rules(alertRules, 8, ruleEntries, 8 * sensorCount, ruleStates, sensorCount);
+#endif
+
+#if VL53L1X_FEATURE_ENUMERATION
+// What is on the bus, for diagnosing missing sensors at boot.
+VL53L1XEnumerator::Device inventory[16];
+VL53L1XEnumerator enumerator(inventory, 16);
+#endif
+
+#if VL53L1X_FEATURE_SLEEP
+// Sleep between measurements instead of spinning in read(). Connect each
+// sensor's GPIO1 to a pin and pass it to setInterruptPin() to wake exactly when
+// data is ready; without it, the sensor is polled when its next measurement is
+// due.
+VL53L1XSleep::Slot sleepSlots[sensorCount];
+VL53L1XSleep sleeper(sensors, sleepSlots, sensorCount);
+#endif
+
+#if VL53L1X_FEATURE_TREND
+// Watches each sensor's signal rate for a dirty or fogged cover glass.
+VL53L1XTrend::Track trendTracks[sensorCount];
+VL53L1XTrend trend(trendTracks, sensorCount);
+#endif
+
+// Build with -D CHARACTERIZE_TIMING=1 to measure the period, jitter and bus
+// load each sensor actually achieves in a few configurations at boot, for
+// sizing arrays. It takes about 3 s per sensor.
+#ifndef CHARACTERIZE_TIMING
+#define CHARACTERIZE_TIMING 0
+#endif
+
+#if VL53L1X_FEATURE_TIMING && CHARACTERIZE_TIMING
+const VL53L1XTiming::Config timingConfigs[] = {
+  {VL53L1X::Long, 50000, 50},
+  {VL53L1X::Medium, 33000, 33},
+  {VL53L1X::Short, 20000, 20},
+};
+const uint8_t timingConfigCount = sizeof(timingConfigs) / sizeof(timingConfigs[0]);
+VL53L1XTiming::Result timingResults[timingConfigCount * sensorCount];
+VL53L1XTiming timing(sensors, sensorCount, timingResults);
+#endif
+
+#if VL53L1X_FEATURE_ROUTER
+// The text output goes through a queue, so a full serial transmit buffer drops
+// the oldest lines instead of stalling the ranging loop.
+VL53L1XRouter::Sink routerSinks[1];
+VL53L1XRouter::Record serialQueue[16];
+VL53L1XRouter router(routerSinks, 1);
+
+bool printSample(void *, uint8_t sensor, const VL53L1XSample & sample)
+{
+  if (Serial.availableForWrite() < 40) { return false; }
+  Serial.print("BUH=");Serial.print(sensor);
+  Serial.print(" Distance: ");Serial.print(sample.range_mm);Serial.println(" mm");
+  return true;
+}
+#endif
+
+#if VL53L1X_FEATURE_CONTROL
+// Host commands arrive as binary frames on the same serial port as the text
+// output; the frame parser skips the text.
+VL53L1XControl control(Serial, sensors, sensorCount);
+#endif
 
 void setup()
 {
@@ -15,7 +117,18 @@ void setup()
 
   Serial.println("Start");
   Wire.begin();
+#if VL53L1X_FEATURE_BUS_CLOCK
+#if VL53L1X_FEATURE_RECOVERY
+  busClock.addBus(&Wire, wireRates, 3, &recovery);
+#else
+  busClock.addBus(&Wire, wireRates, 3);
+#endif
+  // bring the sensors up at the slowest rate, so a harness that can't take
+  // the fastest one doesn't lose them for good
+  Wire.setClock(wireRates[2]);
+#else
   Wire.setClock(400000); // use 400 kHz I2C
+#endif
 
   for (uint8_t i = 0; i < sensorCount; i++)
   {
@@ -32,14 +145,26 @@ void setup()
     pinMode(xshutPins[i], INPUT);
     delay(10);
 
+#if VL53L1X_FEATURE_RESTORE
+    sensors[i].setXshutPin(xshutPins[i]);
+    sensors[i].setConfigCache(&sensorConfigs[i]);
+#endif
     sensors[i].setTimeout(500);
     int res = sensors[i].init();
     if (res != 0)
     {
-      Serial.print("Failed to detect and initialize sensor. res=");Serial.println(res, HEX);
-      Serial.println(i);
-      while (1);
+      // carry on without it; the inventory below shows what is there
+      Serial.print("Failed to detect and initialize sensor ");Serial.print(i);
+      if (res < 0) { Serial.println(": no answer"); }
+      else { Serial.print(". res=");Serial.println(res, HEX); }
+      // hold it in shutdown: if it answered, it is still at the default
+      // address, where it would collide with the next sensor
+      pinMode(xshutPins[i], OUTPUT);
+      digitalWrite(xshutPins[i], LOW);
+      sensorPresent[i] = false;
+      continue;
     }
+    sensorPresent[i] = true;
 
     // Each sensor must have its address changed to a unique value other than
     // the default of 0x29 (except for the last one, which could be left at
@@ -47,20 +172,143 @@ void setup()
     sensors[i].setAddress(0x2A + i);
 
     sensors[i].startContinuous(2);
+
+#if VL53L1X_FEATURE_RESTORE
+    // keep a copy of the configuration for fast recovery
+    sensors[i].saveConfig();
+#endif
+  }
+
+#if VL53L1X_FEATURE_ENUMERATION
+#if VL53L1X_FEATURE_RECOVERY
+  enumerator.addBus(&Wire, &recovery);
+#else
+  enumerator.addBus(&Wire);
+#endif
+  enumerator.enumerate();
+  for (uint8_t d = 0; d < enumerator.getCount(); d++)
+  {
+    const VL53L1XEnumerator::Device & device = enumerator.getDevice(d);
+    Serial.print("I2C 0x");Serial.print(device.address, HEX);
+    Serial.println(device.sensor ? " VL53L1X" : " other device");
   }
+  for (uint8_t i = 0; i < sensorCount; i++)
+  {
+    if (enumerator.find(0, 0x2A + i) < 0) { Serial.print("Missing sensor ");Serial.println(i); }
+  }
+#endif
+
+#if VL53L1X_FEATURE_BUS_CLOCK
+  // from here on, failures step the clock back down
+  busClock.begin();
+#endif
+
+#if VL53L1X_FEATURE_RULES
+  // something closer than 500 mm
+  rules.add({1, VL53L1XRuleEngine::RangeBelow, VL53L1XRuleEngine::TargetAll, 1, 500, 50});
+  rules.compile();
+#endif
+
+#if VL53L1X_FEATURE_TIMING && CHARACTERIZE_TIMING
+  timing.begin(timingConfigs, timingConfigCount, 20);
+  while (!timing.update()) {}
+  timing.print(Serial);
+#endif
+
+#if VL53L1X_FEATURE_ROUTER
+  router.addSink(printSample, nullptr, serialQueue, 16, VL53L1XRouter::DropOldest, VL53L1XRouter::Normal);
+#endif
+
+#if VL53L1X_FEATURE_SLEEP
+  sleeper.begin();
+#endif
+
+#if VL53L1X_FEATURE_CONTROL
+#if VL53L1X_FEATURE_SUPERVISOR
+  control.setSupervisor(&supervisor);
+#endif
+#if VL53L1X_FEATURE_RECOVERY
+  control.setRecovery(&recovery);
+#endif
+#if VL53L1X_FEATURE_RULES
+  control.setRules(&rules);
+#endif
+#endif
 }
 
 void loop()
 {
+#if VL53L1X_FEATURE_SUPERVISOR
+  // bring back any quarantined sensors in the background
+  supervisor.service();
+#endif
+
+#if VL53L1X_FEATURE_CONTROL
+  control.poll();
+#endif
+
+#if VL53L1X_FEATURE_SLEEP
+  sleeper.wait(500);
+#endif
+
   for (uint8_t i = 0; i < sensorCount; i++)
   {
+    if (!sensorPresent[i]) { continue; }
+#if VL53L1X_FEATURE_SUPERVISOR
+    if (!supervisor.active(i)) { continue; }
+#endif
+
+#if VL53L1X_FEATURE_SLEEP
+    uint16_t distance = 0;
+    bool timedOut = false;
+    if (sleeper.read(i)) { distance = sensors[i].ranging_data.range_mm; }
+    else if (sleeper.overdue(i, 500)) { timedOut = true; }
+    else { continue; }
+#else
     const auto distance = sensors[i].read();
-    if (sensors[i].timeoutOccurred()) { 
+    const bool timedOut = sensors[i].timeoutOccurred();
+#endif
+    if (timedOut) { 
       Serial.println("TIMEOUT"); 
     }
+#if VL53L1X_FEATURE_SUPERVISOR
+    supervisor.sample(i, timedOut);
+#endif
+#if VL53L1X_FEATURE_BUS_CLOCK
+    busClock.record(0, sensors[i].last_status, timedOut);
+#endif
+#if VL53L1X_FEATURE_RULES
+    // a timed-out read leaves the previous sample in ranging_data
+    if (!timedOut) { rules.evaluate(i, sensors[i].ranging_data, millis()); }
+#endif
+#if VL53L1X_FEATURE_TREND
+    if (!timedOut && trend.sample(i, sensors[i].ranging_data) && trend.getFlags(i) != 0) {
+      Serial.print("Sensor ");Serial.print(i);
+      Serial.print(" optics degraded, flags ");Serial.print(trend.getFlags(i), HEX);
+      Serial.print(", signal at ");Serial.print(trend.getSignalPercent(i));Serial.println("%");
+    }
+#endif
+#if VL53L1X_FEATURE_RECOVERY
+    if (recovery.check(sensors[i]) > VL53L1XRecovery::Pending) {
+      Serial.print("Bus fault, sensor ");Serial.println(i);
+      continue;
+    }
+#endif
+#if VL53L1X_FEATURE_ROUTER
+    if (!timedOut && distance < 500) {
+      VL53L1XSample sample;
+      sample.capture(sensors[i], micros());
+      router.publish(i, sample);
+    }
+#else
     if (distance < 500) {
       Serial.print("BUH=");Serial.print(i);
       Serial.print(" Distance: ");Serial.print(distance);Serial.println(" mm");
     }
+#endif
   }
+
+#if VL53L1X_FEATURE_ROUTER
+  router.service(2000);
+#endif
 }
\ No newline at end of file
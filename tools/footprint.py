@@ -0,0 +1,157 @@
+"""Per-feature flash and RAM report for the VL53L1X library.
+
+Used as a PlatformIO extra script (see platformio.ini), it adds a "footprint"
+target that reads the firmware's symbol table and adds up symbol sizes by
+feature:
+
+    pio run -e teensy41 -t footprint
+
+It can also be run directly on an ELF file:
+
+    python tools/footprint.py .pio/build/teensy41/firmware.elf [nm]
+
+Symbols are assigned to the first feature in FEATURES whose pattern matches
+their demangled name. Compare the totals of two environments (for example
+teensy41 and teensylc_minimal) to see what compiling a feature out saves.
+
+The report ends with the RAM each sensor costs: the per-sensor arrays of the
+sketch (PER_SENSOR) divided by the number of sensors, which is the size of
+sensorPresent (one bool per sensor). That is what limits the size of an array
+of sensors.
+"""
+
+import re
+import subprocess
+import sys
+
+# (feature, pattern) pairs, checked in order; keep in sync with the switches in
+# include/VL53L1XConfig.h
+FEATURES = [
+    ("status strings", r"VL53L1X::rangeStatusToString"),
+    ("restore", r"VL53L1X::(saveConfig|restoreConfig|powerOff|powerOn)\b|sensorConfigs"),
+    ("recovery", r"VL53L1XRecovery|\brecovery\b"),
+    ("supervisor", r"VL53L1XSupervisor|\bsupervisor\b|sensorHealth"),
+    ("power manager", r"VL53L1XPowerManager"),
+    ("control plane", r"VL53L1XControl|VL53L1XFrameParser|VL53L1XProtocol"),
+    ("gesture", r"VL53L1XGesture"),
+    ("background model", r"VL53L1XBackground"),
+    ("zone scan", r"VL53L1XZoneScan"),
+    ("frame assembly", r"VL53L1XFrameAssembler"),
+    ("resampler", r"VL53L1XResampler"),
+    ("array calibration", r"VL53L1XArrayCalibration"),
+    ("rule engine", r"VL53L1XRuleEngine|\balertRules\b|\brules\b|\bruleEntries\b|\bruleStates\b"),
+    ("enumeration", r"VL53L1XEnumerator|\benumerator\b|\binventory\b"),
+    ("sleep", r"VL53L1XSleep|\bsleeper\b|\bsleepSlots\b"),
+    ("trend", r"VL53L1XTrend|\btrend\b|\btrendTracks\b"),
+    ("bus clock", r"VL53L1XBusClock|\bbusClock\b|\bwireRates\b"),
+    ("bus lock", r"VL53L1XBusLock"),
+    ("timing characterization", r"VL53L1XTiming|\btiming\b|\btimingConfigs\b|\btimingResults\b"),
+    ("output router", r"VL53L1XRouter|\brouter\b|\bserialQueue\b|\brouterSinks\b"),
+    ("register metadata, write queue", r"VL53L1XRegisters|VL53L1XWriteQueue"),
+    ("core driver", r"VL53L1X::|\bsensors\b"),
+    ("float support", r"^__aeabi_[fd]|^__(add|sub|mul|div|float|fix|cmp|eq|ne|lt|le|gt|ge|unord)[a-z]*[sd]f"),
+]
+
+# (what, symbol) of the sketch's arrays with one element per sensor
+PER_SENSOR = [
+    ("driver (VL53L1X)", "sensors"),
+    ("presence", "sensorPresent"),
+    ("config snapshot", "sensorConfigs"),
+    ("health", "sensorHealth"),
+    ("rule entries", "ruleEntries"),
+    ("rule state", "ruleStates"),
+    ("sleep slot", "sleepSlots"),
+    ("trend track", "trendTracks"),
+    ("timing results", "timingResults"),
+]
+SENSOR_COUNT_SYMBOL = "sensorPresent"
+
+FLASH_TYPES = set("tTrRwWvV")
+DATA_TYPES = set("dD")  # in RAM, with initializers in flash
+BSS_TYPES = set("bB")
+
+
+def read_symbols(elf, nm):
+    out = subprocess.check_output([nm, "--print-size", "--size-sort", "-C", elf],
+                                  universal_newlines=True)
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4:
+            continue  # symbols without a size
+        yield int(parts[1], 16), parts[2], parts[3]
+
+
+def classify(name):
+    for feature, pattern in FEATURES:
+        if re.search(pattern, name):
+            return feature
+    return "other (framework, application)"
+
+
+def report(elf, nm):
+    totals = {}
+    symbols = list(read_symbols(elf, nm))
+    for size, kind, name in symbols:
+        flash, ram = 0, 0
+        if kind in FLASH_TYPES:
+            flash = size
+        elif kind in DATA_TYPES:
+            flash, ram = size, size
+        elif kind in BSS_TYPES:
+            ram = size
+        else:
+            continue
+        entry = totals.setdefault(classify(name), [0, 0])
+        entry[0] += flash
+        entry[1] += ram
+
+    order = [f for f, _ in FEATURES] + ["other (framework, application)"]
+    print("%-32s %10s %10s" % ("feature", "flash", "RAM"))
+    for feature in order:
+        if feature in totals:
+            flash, ram = totals[feature]
+            print("%-32s %10d %10d" % (feature, flash, ram))
+    print("%-32s %10d %10d" % ("total",
+                               sum(v[0] for v in totals.values()),
+                               sum(v[1] for v in totals.values())))
+
+    report_per_sensor(symbols)
+
+
+def report_per_sensor(symbols):
+    sizes = dict((name, size) for size, kind, name in symbols
+                 if kind in DATA_TYPES or kind in BSS_TYPES)
+    sensors = sizes.get(SENSOR_COUNT_SYMBOL)
+    if not sensors:
+        return
+
+    print()
+    print("RAM per sensor (%d sensors)" % sensors)
+    total = 0
+    for what, symbol in PER_SENSOR:
+        if symbol in sizes:
+            per_sensor = sizes[symbol] / float(sensors)
+            total += per_sensor
+            print("%-32s %21.1f" % (what, per_sensor))
+    print("%-32s %21.1f" % ("total", total))
+
+
+def footprint_action(source, target, env):
+    cc = env.subst("$CC")
+    nm = cc[:-3] + "nm" if cc.endswith("gcc") else "nm"
+    report(str(source[0]), nm)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit("usage: footprint.py firmware.elf [nm]")
+    report(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else "nm")
+else:
+    Import("env")  # noqa: F821 (provided by PlatformIO)
+
+    env.AddCustomTarget(  # noqa: F821
+        name="footprint",
+        dependencies="$BUILD_DIR/${PROGNAME}.elf",
+        actions=footprint_action,
+        title="Footprint",
+        description="Per-feature flash and RAM usage of the VL53L1X library")
@@ -0,0 +1,44 @@
+#pragma once
+
+// Just enough of the Arduino core to build the VL53L1X driver on a host, for
+// the host tools that exercise it (see ../README.md). Time is real time unless
+// a tool replaying recorded data sets it with setHostMicros(); pins go nowhere.
+
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+inline std::atomic<bool> host_time_set{false};
+inline std::atomic<uint64_t> host_time_us{0};
+
+inline void setHostMicros(uint64_t us)
+{
+  host_time_us.store(us, std::memory_order_relaxed);
+  host_time_set.store(true, std::memory_order_relaxed);
+}
+
+inline unsigned long micros()
+{
+  if (host_time_set.load(std::memory_order_relaxed)) { return host_time_us.load(std::memory_order_relaxed); }
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis() { return micros() / 1000; }
+
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() { std::this_thread::yield(); }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
@@ -0,0 +1,183 @@
+#pragma once
+
+// Simulated I2C bus with the TwoWire interface, for running the VL53L1X driver
+// on a host (see ../README.md).
+//
+// Devices are objects attached to the bus. Each transfer keeps the bus busy
+// for as long as it would take at the bus clock (9 clocks per byte, plus the
+// address byte), during which the calling thread sleeps, so transfers on
+// different buses overlap in time the way they would on hardware.
+//
+// Like a real Wire library, a TwoWire is not meant to be used by several
+// threads at once; its calls are made atomic here only so that misuse shows up
+// as wrong data instead of undefined behaviour. It also counts calls made by a
+// thread while another thread's transaction is still open (getInterleaved()).
+// A transaction is open from beginTransmission() to endTransmission(), and
+// after a write of just a 16-bit register address (the VL53L1X read protocol)
+// until the bytes requested next have all been read.
+
+#include "Arduino.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+class TwoWire
+{
+  public:
+
+    static const uint8_t MaxDevices = 16;
+    static const uint8_t BufferLength = 32;
+
+    class Device
+    {
+      public:
+        virtual ~Device() {}
+        virtual bool answers(uint8_t address) = 0;
+        virtual void write(const uint8_t * data, uint8_t length) = 0;
+        virtual void read(uint8_t * data, uint8_t length) = 0;
+    };
+
+    void attach(Device * device) { if (device_count < MaxDevices) { devices[device_count++] = device; } }
+
+    void begin() {}
+    void end() {}
+    void setClock(uint32_t clock_hz) { this->clock_hz = clock_hz; }
+
+    void beginTransmission(uint8_t address)
+    {
+      std::lock_guard<std::mutex> hold(mutex);
+      check();
+      owner = std::this_thread::get_id();
+      tx_address = address;
+      tx_length = 0;
+    }
+
+    size_t write(uint8_t value)
+    {
+      std::lock_guard<std::mutex> hold(mutex);
+      check();
+      if (tx_length >= BufferLength) { return 0; }
+      tx[tx_length++] = value;
+      return 1;
+    }
+
+    size_t write(const uint8_t * data, size_t length)
+    {
+      size_t written = 0;
+      while (written < length && write(data[written])) { written++; }
+      return written;
+    }
+
+    // status as in the Wire library: 0 success, 2 address NACK
+    uint8_t endTransmission(bool stop = true)
+    {
+      (void)stop;
+      std::lock_guard<std::mutex> hold(mutex);
+      check();
+
+      transfer(tx_length);
+      Device * device = find(tx_address);
+      if (device != nullptr) { device->write(tx, tx_length); }
+
+      // a bare register address is followed by a read
+      if (device == nullptr || tx_length != 2) { owner = std::thread::id(); }
+      return (device != nullptr) ? 0 : 2;
+    }
+
+    uint8_t requestFrom(uint8_t address, uint8_t length, uint8_t stop = 1)
+    {
+      (void)stop;
+      std::lock_guard<std::mutex> hold(mutex);
+      check();
+
+      if (length > BufferLength) { length = BufferLength; }
+      transfer(length);
+      rx_length = rx_index = 0;
+      Device * device = find(address);
+      if (device != nullptr)
+      {
+        device->read(rx, length);
+        rx_length = length;
+      }
+
+      owner = (rx_length > 0) ? std::this_thread::get_id() : std::thread::id();
+      return rx_length;
+    }
+
+    uint8_t requestFrom(int address, int length) { return requestFrom((uint8_t)address, (uint8_t)length); }
+
+    int available()
+    {
+      std::lock_guard<std::mutex> hold(mutex);
+      return rx_length - rx_index;
+    }
+
+    int read()
+    {
+      std::lock_guard<std::mutex> hold(mutex);
+      check();
+      if (rx_index >= rx_length) { return -1; }
+      int value = rx[rx_index++];
+      if (rx_index == rx_length) { owner = std::thread::id(); }
+      return value;
+    }
+
+    uint64_t getInterleaved() { return interleaved; }
+    uint64_t getTransfers() { return transfers; }
+
+    // most transfers in progress at once, on all buses together
+    static int getMaxConcurrent() { return max_concurrent; }
+
+  private:
+
+    std::mutex mutex;
+    Device * devices[MaxDevices] = {};
+    uint8_t device_count = 0;
+    uint32_t clock_hz = 100000;
+
+    std::thread::id owner;
+    uint8_t tx_address = 0;
+    uint8_t tx[BufferLength];
+    uint8_t tx_length = 0;
+    uint8_t rx[BufferLength];
+    uint8_t rx_length = 0;
+    uint8_t rx_index = 0;
+
+    std::atomic<uint64_t> interleaved{0};
+    std::atomic<uint64_t> transfers{0};
+
+    static inline std::atomic<int> concurrent{0};
+    static inline std::atomic<int> max_concurrent{0};
+
+    // count a call from another thread than the open transaction's; a thread
+    // starting a new transaction over its own open one is fine (a read that
+    // was cut short)
+    void check()
+    {
+      if (owner != std::thread::id() && owner != std::this_thread::get_id()) { interleaved++; }
+    }
+
+    Device * find(uint8_t address)
+    {
+      for (uint8_t i = 0; i < device_count; i++)
+      {
+        if (devices[i]->answers(address)) { return devices[i]; }
+      }
+      return nullptr;
+    }
+
+    // keep the bus busy for the address byte, the data and their ACKs
+    void transfer(uint8_t bytes)
+    {
+      transfers++;
+      int now = ++concurrent;
+      int seen = max_concurrent;
+      while (now > seen && !max_concurrent.compare_exchange_weak(seen, now)) {}
+
+      std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)(bytes + 1) * 9 * 1000000 / clock_hz));
+      concurrent--;
+    }
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,285 @@
+// Stress test of the VL53L1X driver's per-bus locks (VL53L1XBusLock) under
+// std::thread.
+//
+// The driver itself is compiled for the host against the simulated bus in
+// arduino/Wire.h. Several buses each carry several simulated sensors, and
+// several threads per bus share the bus, each owning some of its sensors, as
+// RTOS tasks would. Every thread loops over its sensors until time is up:
+//
+// - reads the model ID, which must be 0xEACC;
+// - writes a value of its own to a scratch register and reads it back;
+// - reads a measurement, which must have the range and stream count its
+//   simulated sensor produced.
+//
+// Any interleaving of transactions on a bus corrupts one of these (the sensors
+// share nothing but the bus), and the simulated bus also counts calls made in
+// the middle of another thread's transaction. With the locks attached, both
+// must stay at zero while the buses run in parallel; --no-lock shows what
+// happens without them.
+//
+// Build and usage: see README.md.
+
+#include <VL53L1X.h>
+#include <VL53L1XBusLock.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !VL53L1X_FEATURE_BUS_LOCK
+#error "build with -DVL53L1X_FEATURE_BUS_LOCK=1"
+#endif
+
+struct Options
+{
+  unsigned buses = 4;
+  unsigned sensors = 4;   // per bus
+  unsigned threads = 2;   // per bus
+  double seconds = 5;
+  uint32_t clock_hz = 1000000;
+  bool lock = true;
+};
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: bus_lock_stress [options]\n"
+    "  --buses N      buses, 1-%u (default 4)\n"
+    "  --sensors N    sensors per bus, 1-16 (default 4)\n"
+    "  --threads N    threads per bus, each owning some of its sensors (default 2)\n"
+    "  --seconds S    how long to run (default 5)\n"
+    "  --clock HZ     simulated bus clock (default 1000000)\n"
+    "  --no-lock      don't attach the bus locks\n",
+    (unsigned)VL53L1XBusLock::MaxBuses);
+  exit(2);
+}
+
+static Options parse(int argc, char ** argv)
+{
+  Options o;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    if (a == "--no-lock") { o.lock = false; continue; }
+    if (i + 1 >= argc) { usage(); }
+    const char * v = argv[++i];
+
+    if (a == "--buses") { o.buses = atoi(v); }
+    else if (a == "--sensors") { o.sensors = atoi(v); }
+    else if (a == "--threads") { o.threads = atoi(v); }
+    else if (a == "--seconds") { o.seconds = atof(v); }
+    else if (a == "--clock") { o.clock_hz = atoi(v); }
+    else { usage(); }
+  }
+
+  if (o.buses < 1 || o.buses > VL53L1XBusLock::MaxBuses || o.sensors < 1 || o.sensors > 16 ||
+      o.threads < 1 || o.threads > o.sensors || o.seconds <= 0 || o.clock_hz < 10000)
+  {
+    usage();
+  }
+  return o;
+}
+
+// The registers of a VL53L1X that init(), startContinuous() and read() use,
+// always with a measurement ready. Clearing the interrupt starts a new
+// measurement with the next stream count.
+class SimSensor : public TwoWire::Device
+{
+  public:
+
+    explicit SimSensor(uint16_t range_mm) : memory(0x10000, 0), range_mm(range_mm)
+    {
+      put16(VL53L1X::IDENTIFICATION__MODEL_ID, 0xEACC);
+      memory[VL53L1X::FIRMWARE__SYSTEM_STATUS] = 0x01;  // booted
+      put16(VL53L1X::OSC_MEASURED__FAST_OSC__FREQUENCY, 0xB000);
+      put16(VL53L1X::RESULT__OSC_CALIBRATE_VAL, 0x0400);
+      memory[VL53L1X::GPIO__TIO_HV_STATUS] = 0x02;      // data ready (active low)
+      measure();
+    }
+
+    void enable() { enabled = true; }
+
+    bool answers(uint8_t a) override { return enabled && a == address; }
+
+    void write(const uint8_t * data, uint8_t length) override
+    {
+      if (length < 2) { return; }
+      pointer = (uint16_t)data[0] << 8 | data[1];
+      for (uint8_t i = 2; i < length; i++)
+      {
+        uint16_t reg = pointer++;
+        memory[reg] = data[i];
+        if (reg == VL53L1X::I2C_SLAVE__DEVICE_ADDRESS) { address = data[i] & 0x7F; }
+        if (reg == VL53L1X::SYSTEM__INTERRUPT_CLEAR) { measure(); }
+      }
+    }
+
+    void read(uint8_t * data, uint8_t length) override
+    {
+      for (uint8_t i = 0; i < length; i++) { data[i] = memory[pointer++]; }
+    }
+
+    uint8_t getStreamCount() { return memory[VL53L1X::RESULT__STREAM_COUNT]; }
+
+  private:
+
+    std::vector<uint8_t> memory;
+    uint16_t pointer = 0;
+    uint8_t address = 0x29;
+    bool enabled = false;
+    uint16_t range_mm;
+
+    void put16(uint16_t reg, uint16_t value)
+    {
+      memory[reg] = value >> 8;
+      memory[reg + 1] = value;
+    }
+
+    void measure()
+    {
+      uint8_t & stream = memory[VL53L1X::RESULT__STREAM_COUNT];
+      stream = (stream == 255) ? 128 : stream + 1;
+      memory[VL53L1X::RESULT__RANGE_STATUS] = 9; // range valid
+      put16(VL53L1X::RESULT__DSS_ACTUAL_EFFECTIVE_SPADS_SD0, 0x2000);
+      put16(VL53L1X::RESULT__AMBIENT_COUNT_RATE_MCPS_SD0, 0x0040);
+      put16(VL53L1X::RESULT__FINAL_CROSSTALK_CORRECTED_RANGE_MM_SD0, range_mm);
+      put16(VL53L1X::RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0, 0x0A00);
+    }
+};
+
+struct Counts
+{
+  std::atomic<uint64_t> cycles{0};
+  std::atomic<uint64_t> id_errors{0};
+  std::atomic<uint64_t> scratch_errors{0};
+  std::atomic<uint64_t> range_errors{0};
+  std::atomic<uint64_t> status_errors{0};
+};
+
+// the range the driver reports for a raw range register value
+static uint16_t reported(uint16_t raw) { return ((uint32_t)raw * 2011 + 0x0400) / 0x0800; }
+
+int main(int argc, char ** argv)
+{
+  Options o = parse(argc, argv);
+
+  std::vector<std::unique_ptr<TwoWire>> buses;
+  std::vector<std::unique_ptr<SimSensor>> sims;
+  std::vector<std::unique_ptr<VL53L1X>> sensors;
+  std::vector<uint16_t> raw_range;
+
+  // bring the sensors up one at a time, as the example sketch does with XSHUT
+  for (unsigned b = 0; b < o.buses; b++)
+  {
+    buses.emplace_back(new TwoWire());
+    TwoWire * bus = buses.back().get();
+    bus->setClock(o.clock_hz);
+
+    for (unsigned s = 0; s < o.sensors; s++)
+    {
+      uint16_t raw = 100 + 37 * (b * o.sensors + s);
+      sims.emplace_back(new SimSensor(raw));
+      raw_range.push_back(raw);
+      bus->attach(sims.back().get());
+      sims.back()->enable();
+
+      sensors.emplace_back(new VL53L1X());
+      VL53L1X & sensor = *sensors.back();
+      sensor.setBus(bus);
+      sensor.setTimeout(100);
+      if (sensor.init() != 0)
+      {
+        fprintf(stderr, "bus %u sensor %u: init failed\n", b, s);
+        return 1;
+      }
+      sensor.setAddress(0x2A + s);
+      sensor.startContinuous(20);
+    }
+
+    if (o.lock && !VL53L1XBusLock::attach(bus))
+    {
+      fprintf(stderr, "bus %u: no lock\n", b);
+      return 1;
+    }
+  }
+
+  std::vector<Counts> counts(o.buses);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+
+  for (unsigned b = 0; b < o.buses; b++)
+  {
+    for (unsigned t = 0; t < o.threads; t++)
+    {
+      threads.emplace_back([&, b, t]() {
+        Counts & c = counts[b];
+        uint16_t value = t * 1000;
+
+        while (!stop)
+        {
+          // this thread owns every threads-th sensor of the bus
+          for (unsigned s = t; s < o.sensors; s += o.threads)
+          {
+            unsigned i = b * o.sensors + s;
+            VL53L1X & sensor = *sensors[i];
+
+            if (sensor.readReg16Bit(VL53L1X::IDENTIFICATION__MODEL_ID) != 0xEACC) { c.id_errors++; }
+
+            value++;
+            sensor.writeReg16Bit(VL53L1X::ALGO__CROSSTALK_COMPENSATION_PLANE_OFFSET_KCPS, value);
+            if (sensor.readReg16Bit(VL53L1X::ALGO__CROSSTALK_COMPENSATION_PLANE_OFFSET_KCPS) != value) { c.scratch_errors++; }
+
+            // the driver reads this measurement and then clears it, starting the next
+            uint8_t stream = sims[i]->getStreamCount();
+            uint16_t range = sensor.read();
+            if (range != reported(raw_range[i]) || sensor.ranging_data.range_status != VL53L1X::RangeValid ||
+                sensor.getStreamCount() != stream)
+            {
+              c.range_errors++;
+            }
+            if (sensor.last_status != 0 || sensor.timeoutOccurred()) { c.status_errors++; }
+            c.cycles++;
+          }
+        }
+      });
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(o.seconds));
+  stop = true;
+  for (std::thread & thread : threads) { thread.join(); }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%u buses x %u sensors, %u threads per bus, %u kHz, locks %s\n",
+         o.buses, o.sensors, o.threads, (unsigned)(o.clock_hz / 1000), o.lock ? "on" : "off");
+  printf("bus   cycles/s  transfers/s  interleaved  id  scratch  range  status\n");
+
+  uint64_t errors = 0;
+  double transfers = 0;
+  for (unsigned b = 0; b < o.buses; b++)
+  {
+    Counts & c = counts[b];
+    uint64_t interleaved = buses[b]->getInterleaved();
+    uint64_t bus_errors = interleaved + c.id_errors + c.scratch_errors + c.range_errors + c.status_errors;
+    errors += bus_errors;
+    transfers += buses[b]->getTransfers() / elapsed;
+
+    printf("%3u %10.0f %12.0f %12llu %3llu %8llu %6llu %7llu\n",
+           b, c.cycles / elapsed, buses[b]->getTransfers() / elapsed, (unsigned long long)interleaved,
+           (unsigned long long)c.id_errors.load(), (unsigned long long)c.scratch_errors.load(),
+           (unsigned long long)c.range_errors.load(), (unsigned long long)c.status_errors.load());
+  }
+  printf("total %0.f transfers/s, up to %d buses busy at once\n", transfers, TwoWire::getMaxConcurrent());
+
+  if (!o.lock)
+  {
+    printf("%s\n", errors > 0 ? "corruption detected, as expected without locks" : "no corruption seen");
+    return 0;
+  }
+  if (errors > 0) { printf("FAILED\n"); }
+  return errors > 0 ? 1 : 0;
+}
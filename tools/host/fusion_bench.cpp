@@ -0,0 +1,273 @@
+// Scaling benchmark for FusionRuntime.
+//
+// Generates a recording of Sample streams from a ring of sensors looking in at
+// a few moving objects (several links, each carrying many sensors), then runs
+// the whole recording through FusionRuntime as fast as it will go with each
+// thread count given, reporting samples per second, speedup and efficiency
+// relative to the first count. Every run must produce exactly the same frames,
+// and every sensor's outputs in the order they were sent; the benchmark checks
+// both and fails if they differ.
+//
+// Build and usage: see README.md.
+
+#include "fusion_runtime.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+typedef VL53L1XProtocol P;
+
+struct Chunk
+{
+  uint64_t received_us;
+  unsigned link;
+  std::vector<uint8_t> bytes;
+};
+
+struct Options
+{
+  unsigned links = 16;
+  unsigned sensors = 32;        // per link
+  double rate_hz = 50;
+  double seconds = 10;          // length of the recording
+  uint32_t chunk_us = 2000;     // how often a link delivers what it has
+  std::vector<unsigned> threads = { 1, 2, 4, 8, 16, 32 };
+};
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: fusion_bench [options]\n"
+    "  --links N       links (default 16)\n"
+    "  --sensors N     sensors per link, 1-128 (default 32)\n"
+    "  --rate HZ       readings per second per sensor (default 50)\n"
+    "  --seconds S     length of the recording (default 10)\n"
+    "  --chunk-us US   delivery interval per link (default 2000)\n"
+    "  --threads LIST  comma-separated thread counts (default 1,2,4,8,16,32)\n");
+  exit(2);
+}
+
+static Options parse(int argc, char ** argv)
+{
+  Options o;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    if (i + 1 >= argc) { usage(); }
+    const char * v = argv[++i];
+
+    if (a == "--links") { o.links = atoi(v); }
+    else if (a == "--sensors") { o.sensors = atoi(v); }
+    else if (a == "--rate") { o.rate_hz = atof(v); }
+    else if (a == "--seconds") { o.seconds = atof(v); }
+    else if (a == "--chunk-us") { o.chunk_us = atoi(v); }
+    else if (a == "--threads")
+    {
+      o.threads.clear();
+      for (const char * p = v; *p; )
+      {
+        o.threads.push_back(strtoul(p, const_cast<char **>(&p), 10));
+        if (*p == ',') { p++; }
+        else if (*p) { usage(); }
+      }
+    }
+    else { usage(); }
+  }
+
+  if (o.links < 1 || o.sensors < 1 || o.sensors > 128 || o.rate_hz <= 0 || o.seconds <= 0 ||
+      o.chunk_us == 0 || o.threads.empty())
+  {
+    usage();
+  }
+  for (unsigned t : o.threads) { if (t < 1) { usage(); } }
+  return o;
+}
+
+// sensors on a circle around the middle of the grid, facing in
+static FusionConfig makeConfig(const Options & o)
+{
+  FusionConfig c;
+  c.links = o.links;
+  c.sensors_per_link = o.sensors;
+
+  double middle = c.grid_cells * c.cell_mm / 2.0;
+  unsigned count = o.links * o.sensors;
+  for (unsigned i = 0; i < count; i++)
+  {
+    double a = 2 * M_PI * i / count;
+    FusionConfig::Pose pose;
+    pose.x_mm = middle + std::cos(a) * middle * 0.95;
+    pose.y_mm = middle + std::sin(a) * middle * 0.95;
+    pose.heading_rad = a + M_PI;
+    c.poses.push_back(pose);
+  }
+  return c;
+}
+
+// distance along a ray to the nearest of some moving discs, if within range
+static bool trace(const FusionConfig::Pose & pose, double t_s, double * range_mm)
+{
+  static const int Discs = 3;
+  double best = 1e9;
+  for (int d = 0; d < Discs; d++)
+  {
+    double cx = 2560 + 1200 * std::cos(0.4 * t_s * (d + 1) + d * 2.1);
+    double cy = 2560 + 1200 * std::sin(0.3 * t_s * (d + 1) + d * 1.3);
+    double radius = 250;
+
+    double dx = std::cos(pose.heading_rad), dy = std::sin(pose.heading_rad);
+    double fx = pose.x_mm - cx, fy = pose.y_mm - cy;
+    double b = fx * dx + fy * dy;
+    double c = fx * fx + fy * fy - radius * radius;
+    double disc = b * b - c;
+    if (disc < 0) { continue; }
+    double t = -b - std::sqrt(disc);
+    if (t > 0 && t < best) { best = t; }
+  }
+  *range_mm = best;
+  return best < 4000;
+}
+
+static std::vector<Chunk> record(const Options & o, const FusionConfig & config)
+{
+  std::mt19937 random(1);
+  std::normal_distribution<double> noise(0, 1);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  unsigned count = o.links * o.sensors;
+  std::vector<double> period_us(count), next_us(count);
+  std::vector<uint8_t> stream(count, 0), seq(o.links, 0);
+  for (unsigned i = 0; i < count; i++)
+  {
+    period_us[i] = 1e6 / (o.rate_hz * (1 + 0.1 * (unit(random) - 0.5)));
+    next_us[i] = period_us[i] * unit(random);
+  }
+
+  std::vector<Chunk> chunks;
+  uint64_t end_us = (uint64_t)(o.seconds * 1e6);
+  for (uint64_t t = o.chunk_us; t <= end_us; t += o.chunk_us)
+  {
+    for (unsigned link = 0; link < o.links; link++)
+    {
+      Chunk chunk;
+      chunk.received_us = t;
+      chunk.link = link;
+
+      for (unsigned target = 0; target < o.sensors; target++)
+      {
+        unsigned s = link * o.sensors + target;
+        while (next_us[s] < t)
+        {
+          double range;
+          bool hit = trace(config.poses[s], next_us[s] * 1e-6, &range);
+
+          P::Frame f;
+          f.seq = seq[link]++;
+          f.type = P::Sample;
+          f.target = target;
+          f.length = P::SampleLength;
+          P::put32(f.payload, (uint32_t)next_us[s]);
+          P::put16(f.payload + 4, hit ? (uint16_t)std::max(0.0, range + 3 * noise(random)) : 0);
+          P::put16(f.payload + 6, hit ? 20 * 128 : 0);
+          P::put16(f.payload + 8, 64);
+          f.payload[10] = hit ? 0 : 2;
+          f.payload[11] = stream[s];
+          stream[s] = (stream[s] == 255) ? 128 : stream[s] + 1;
+
+          uint8_t buffer[P::MaxFrame];
+          uint8_t length = P::encode(f, buffer);
+          chunk.bytes.insert(chunk.bytes.end(), buffer, buffer + length);
+          next_us[s] += period_us[s];
+        }
+      }
+
+      if (!chunk.bytes.empty()) { chunks.push_back(std::move(chunk)); }
+    }
+  }
+  return chunks;
+}
+
+struct Result
+{
+  double seconds;
+  uint64_t samples;
+  uint64_t frames;
+  uint64_t frame_hash;
+  uint64_t sensor_hash;
+  uint64_t out_of_order;
+};
+
+static Result run(const FusionConfig & config, const std::vector<Chunk> & chunks, unsigned threads)
+{
+  Result r = {};
+  unsigned count = config.links * config.sensors_per_link;
+  std::vector<uint64_t> sensor_hash(count, 0);
+  std::vector<int> last_count(count, -1);
+  std::vector<uint64_t> sensor_samples(count, 0);
+  std::atomic<uint64_t> out_of_order(0);
+
+  {
+    FusionRuntime runtime(config, threads);
+
+    // each sensor's callback runs on its strand, so its slots need no lock
+    runtime.setSensorCallback([&](const FusionRuntime::SensorOutput & out) {
+      unsigned s = out.sensor;
+      int expected = (last_count[s] < 0) ? out.stream_count : (last_count[s] == 255) ? 128 : last_count[s] + 1;
+      if (out.stream_count != expected) { out_of_order++; }
+      last_count[s] = out.stream_count;
+      sensor_hash[s] = sensor_hash[s] * 1000003 + out.range_mm * 31 + out.stream_count;
+      sensor_samples[s]++;
+    });
+    runtime.setFrameCallback([&](const FusionRuntime::FrameOutput & out) {
+      r.frames++;
+      r.frame_hash = r.frame_hash * 1000003 + out.checksum + out.occupied * 7 + out.free * 13 + out.samples;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Chunk & c : chunks) { runtime.ingest(c.link, c.bytes.data(), c.bytes.size(), c.received_us); }
+    runtime.finish();
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  for (unsigned s = 0; s < count; s++)
+  {
+    r.sensor_hash = r.sensor_hash * 1000003 + sensor_hash[s];
+    r.samples += sensor_samples[s];
+  }
+  r.out_of_order = out_of_order;
+  return r;
+}
+
+int main(int argc, char ** argv)
+{
+  Options o = parse(argc, argv);
+  FusionConfig config = makeConfig(o);
+
+  std::vector<Chunk> chunks = record(o, config);
+  printf("%u links x %u sensors at %g Hz, %g s recorded, %u hardware threads\n",
+         o.links, o.sensors, o.rate_hz, o.seconds, std::thread::hardware_concurrency());
+  printf("threads   seconds   samples/s   frames/s   speedup   efficiency   output\n");
+
+  Result first = {};
+  bool ok = true;
+  for (size_t i = 0; i < o.threads.size(); i++)
+  {
+    Result r = run(config, chunks, o.threads[i]);
+    if (i == 0) { first = r; }
+
+    bool same = r.frame_hash == first.frame_hash && r.sensor_hash == first.sensor_hash &&
+                r.frames == first.frames && r.samples == first.samples && r.out_of_order == 0;
+    ok &= same;
+
+    double speedup = first.seconds / r.seconds;
+    printf("%7u %9.3f %11.0f %10.0f %9.2f %11.0f%%   %s\n",
+           o.threads[i], r.seconds, r.samples / r.seconds, r.frames / r.seconds,
+           speedup, 100 * speedup * o.threads[0] / o.threads[i], same ? "same" : "DIFFERENT");
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,472 @@
+#pragma once
+
+// Parallel host-side fusion of Sample streams from many links.
+//
+// Work is split into tasks on a WorkStealingPool along the two axes that are
+// independent:
+//
+// - by link: each link's bytes are decoded by a task on that link's strand
+//   (the frame parser has state, so a link's chunks must go in order);
+// - by sensor: each sample is filtered (median of three, then smoothed) and
+//   projected into world coordinates by a task on its sensor's strand, so a
+//   sensor's outputs come out in the order its samples were sent, whatever the
+//   thread count;
+// - by frame and tile: samples are binned into fusion frames of frame_us by
+//   the time their chunk was received. Once every link has moved past a frame
+//   and all of its samples are projected, the frame's occupancy grid is built
+//   from scratch by one task per grid tile, each casting every ray of the
+//   frame that crosses its tile. Frames don't depend on each other, so several
+//   can be fused at once; they are delivered in order.
+//
+// Within a tile, rays are applied in sensor order and, per sensor, in sample
+// order, so outputs are identical for any number of threads.
+//
+// ingest() must be called from one thread, with non-decreasing receive times
+// across all links: a chunk received at t tells the runtime that every link
+// has delivered everything before t. It blocks (back-pressure) when the
+// caller gets more than frame_window frames ahead of delivery.
+
+#include "VL53L1XProtocol.h"
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+struct FusionConfig
+{
+  struct Pose
+  {
+    double x_mm;
+    double y_mm;
+    double heading_rad;
+  };
+
+  unsigned links = 1;
+  unsigned sensors_per_link = 1;  // sensor = link * sensors_per_link + target
+  std::vector<Pose> poses;        // one per sensor
+
+  uint32_t frame_us = 20000;
+  unsigned frame_window = 32;     // frames in flight
+  unsigned max_per_frame = 4;     // samples per sensor per frame
+
+  int grid_cells = 256;           // the grid is grid_cells square, origin at 0,0
+  int cell_mm = 20;
+  int tile_cells = 64;
+  int rays = 5;                   // rays cast across the field of view
+  double fov_rad = 27 * M_PI / 180;
+  uint16_t max_range_mm = 4000;   // free space cast for no-target samples
+};
+
+class FusionRuntime
+{
+  public:
+
+    struct SensorOutput
+    {
+      unsigned sensor;
+      uint64_t frame;
+      uint32_t timestamp_us;      // the sensor's own clock
+      uint8_t stream_count;
+      uint8_t range_status;
+      uint16_t range_mm;          // filtered
+      double x_mm;                // projected target, if hit
+      double y_mm;
+      bool hit;
+    };
+
+    struct FrameOutput
+    {
+      uint64_t frame;
+      uint32_t samples;
+      uint32_t overflows;         // samples beyond max_per_frame, left out
+      uint32_t occupied;          // cells with more hits than misses
+      uint32_t free;
+      uint64_t checksum;          // of the grid
+      const int8_t * grid;        // grid_cells * grid_cells log odds, row-major
+    };
+
+    typedef std::function<void(const SensorOutput &)> SensorCallback;
+    typedef std::function<void(const FrameOutput &)> FrameCallback;
+
+    FusionRuntime(const FusionConfig & config, unsigned threads)
+      : config(config), pool(threads), started(false), first_frame(0), last_frame(0), sealed(0), next_emit(0)
+    {
+      unsigned sensor_count = config.links * config.sensors_per_link;
+      tiles_per_side = (config.grid_cells + config.tile_cells - 1) / config.tile_cells;
+
+      for (unsigned i = 0; i < config.links; i++) { links.emplace_back(new LinkState(pool)); }
+      for (unsigned i = 0; i < sensor_count; i++)
+      {
+        SensorState * s = new SensorState(pool);
+        const FusionConfig::Pose & pose = config.poses[i];
+        for (int r = 0; r < config.rays; r++)
+        {
+          double a = pose.heading_rad + config.fov_rad * ((config.rays > 1) ? (double)r / (config.rays - 1) - 0.5 : 0);
+          s->dx.push_back(std::cos(a));
+          s->dy.push_back(std::sin(a));
+        }
+        sensors.emplace_back(s);
+      }
+
+      for (unsigned i = 0; i < config.frame_window; i++)
+      {
+        FrameSlot * slot = new FrameSlot();
+        slot->rays.resize(sensor_count * config.max_per_frame);
+        slot->counts.resize(sensor_count);
+        slot->grid.resize(config.grid_cells * config.grid_cells);
+        reset(*slot, i);
+        slots.emplace_back(slot);
+      }
+    }
+
+    ~FusionRuntime() { pool.wait(); }
+
+    // called on worker threads; per sensor, in sample order
+    void setSensorCallback(SensorCallback callback) { sensor_callback = callback; }
+    // called on worker threads, in frame order
+    void setFrameCallback(FrameCallback callback) { frame_callback = callback; }
+
+    void ingest(unsigned link, const uint8_t * data, size_t length, uint64_t received_us)
+    {
+      uint64_t f = received_us / config.frame_us;
+      if (!started)
+      {
+        started = true;
+        first_frame = f;
+      }
+      f = (f > first_frame) ? f - first_frame : 0;
+      if (f > last_frame) { last_frame = f; }
+
+      advance(f);
+      waitForSlot(f);
+
+      std::shared_ptr<std::vector<uint8_t>> chunk(new std::vector<uint8_t>(data, data + length));
+      links[link]->strand.post([this, link, chunk, f]() { decode(link, *chunk, f); });
+    }
+
+    // deliver everything ingested so far and wait for it
+    void finish()
+    {
+      if (started) { advance(last_frame + 1); }
+      pool.wait();
+    }
+
+    unsigned threads() const { return pool.size(); }
+
+  private:
+
+    struct Ray
+    {
+      uint16_t range_mm;
+      bool hit;
+    };
+
+    struct LinkState
+    {
+      Strand strand;
+      VL53L1XFrameParser parser;
+      explicit LinkState(WorkStealingPool & pool) : strand(pool) {}
+    };
+
+    struct SensorState
+    {
+      Strand strand;
+      std::vector<double> dx, dy;   // ray directions
+      uint16_t last[3] = { 0, 0, 0 };
+      uint8_t seen = 0;
+      double smoothed = 0;
+      explicit SensorState(WorkStealingPool & pool) : strand(pool) {}
+    };
+
+    struct FrameSlot
+    {
+      uint64_t frame;
+      std::atomic<int> pending;     // link seals and samples not yet projected
+      std::atomic<int> tiles_left;
+      std::atomic<uint32_t> samples;
+      std::atomic<uint32_t> overflows;
+      std::atomic<uint32_t> occupied;
+      std::atomic<uint32_t> free;
+      std::atomic<uint64_t> checksum;
+      std::vector<Ray> rays;        // [sensor][max_per_frame]
+      std::vector<uint8_t> counts;  // per sensor; written only on its strand
+      std::vector<int8_t> grid;
+      bool done;
+    };
+
+    FusionConfig config;
+    WorkStealingPool pool;
+    std::vector<std::unique_ptr<LinkState>> links;
+    std::vector<std::unique_ptr<SensorState>> sensors;
+    std::vector<std::unique_ptr<FrameSlot>> slots;
+    int tiles_per_side;
+
+    SensorCallback sensor_callback;
+    FrameCallback frame_callback;
+
+    // ingest() side
+    bool started;
+    uint64_t first_frame;
+    uint64_t last_frame;
+    uint64_t sealed;                // frames below this are sealed on every link
+
+    std::mutex emit_mutex;
+    std::condition_variable emit_cv;
+    uint64_t next_emit;
+
+    FrameSlot & slot(uint64_t f) { return *slots[f % config.frame_window]; }
+
+    void reset(FrameSlot & s, uint64_t f)
+    {
+      s.frame = f;
+      s.pending = config.links;
+      s.samples = 0;
+      s.overflows = 0;
+      s.occupied = 0;
+      s.free = 0;
+      s.checksum = 0;
+      std::fill(s.counts.begin(), s.counts.end(), 0);
+      s.done = false;
+    }
+
+    // back-pressure: wait until frame f has a slot, that is until the frame
+    // frame_window before it has been delivered
+    void waitForSlot(uint64_t f)
+    {
+      std::unique_lock<std::mutex> lock(emit_mutex);
+      emit_cv.wait(lock, [this, f]() { return f < next_emit + config.frame_window; });
+    }
+
+    // seal the frames below f on every link, after the chunks already posted
+    void advance(uint64_t f)
+    {
+      for (; sealed < f; sealed++)
+      {
+        uint64_t s = sealed;
+        waitForSlot(s);
+        for (auto & link : links) { link->strand.post([this, s]() { release(s); }); }
+      }
+    }
+
+    void release(uint64_t f)
+    {
+      if (--slot(f).pending == 0) { fuse(f); }
+    }
+
+    void decode(unsigned link, const std::vector<uint8_t> & chunk, uint64_t f)
+    {
+      typedef VL53L1XProtocol P;
+      LinkState & l = *links[link];
+
+      for (uint8_t b : chunk)
+      {
+        if (!l.parser.feed(b)) { continue; }
+        const P::Frame & frame = l.parser.frame();
+        if (frame.type != P::Sample || frame.length != P::SampleLength || frame.target >= config.sensors_per_link)
+        {
+          continue;
+        }
+
+        unsigned sensor = link * config.sensors_per_link + frame.target;
+        uint8_t payload[P::SampleLength];
+        memcpy(payload, frame.payload, sizeof(payload));
+
+        slot(f).pending++;
+        SensorOutput out;
+        out.sensor = sensor;
+        out.frame = f;
+        out.timestamp_us = P::get32(payload);
+        out.range_mm = P::get16(payload + 4);
+        out.range_status = payload[10];
+        out.stream_count = payload[11];
+        sensors[sensor]->strand.post([this, out]() { project(out); });
+      }
+    }
+
+    void project(SensorOutput out)
+    {
+      SensorState & s = *sensors[out.sensor];
+      const FusionConfig::Pose & pose = config.poses[out.sensor];
+      FrameSlot & frame = slot(out.frame);
+
+      Ray ray;
+      bool cast = true;
+      if (out.range_status == 0)
+      {
+        // median of the last three, then exponential smoothing
+        s.last[0] = s.last[1];
+        s.last[1] = s.last[2];
+        s.last[2] = out.range_mm;
+        if (s.seen < 3) { s.seen++; }
+        uint16_t median = out.range_mm;
+        if (s.seen == 3)
+        {
+          uint16_t a = s.last[0], b = s.last[1], c = s.last[2];
+          median = std::max(std::min(a, b), std::min(std::max(a, b), c));
+        }
+        s.smoothed = (s.seen == 1) ? median : s.smoothed + 0.5 * (median - s.smoothed);
+
+        out.range_mm = (uint16_t)std::lround(s.smoothed);
+        out.hit = true;
+        ray.range_mm = out.range_mm;
+        ray.hit = true;
+      }
+      else if (out.range_status == 2 || out.range_status == 4)
+      {
+        // no target: free space as far as the sensor sees
+        out.hit = false;
+        ray.range_mm = config.max_range_mm;
+        ray.hit = false;
+      }
+      else
+      {
+        out.hit = false;
+        cast = false;
+      }
+
+      double heading_x = std::cos(pose.heading_rad), heading_y = std::sin(pose.heading_rad);
+      out.x_mm = out.hit ? pose.x_mm + heading_x * out.range_mm : 0;
+      out.y_mm = out.hit ? pose.y_mm + heading_y * out.range_mm : 0;
+
+      if (cast)
+      {
+        uint8_t & n = frame.counts[out.sensor];
+        if (n < config.max_per_frame) { frame.rays[out.sensor * config.max_per_frame + n++] = ray; }
+        else { frame.overflows++; }
+      }
+      frame.samples++;
+
+      if (sensor_callback) { sensor_callback(out); }
+      release(out.frame);
+    }
+
+    void fuse(uint64_t f)
+    {
+      FrameSlot & s = slot(f);
+      int tiles = tiles_per_side * tiles_per_side;
+      s.tiles_left = tiles;
+      for (int t = 0; t < tiles; t++)
+      {
+        pool.submit([this, f, t]() {
+          castTile(f, t);
+          if (--slot(f).tiles_left == 0) { complete(f); }
+        });
+      }
+    }
+
+    void castTile(uint64_t f, int tile)
+    {
+      FrameSlot & s = slot(f);
+      int n = config.grid_cells;
+      int x0 = (tile % tiles_per_side) * config.tile_cells, x1 = std::min(n, x0 + config.tile_cells);
+      int y0 = (tile / tiles_per_side) * config.tile_cells, y1 = std::min(n, y0 + config.tile_cells);
+
+      for (int y = y0; y < y1; y++) { memset(&s.grid[y * n + x0], 0, x1 - x0); }
+
+      for (unsigned sensor = 0; sensor < sensors.size(); sensor++)
+      {
+        const SensorState & state = *sensors[sensor];
+        const FusionConfig::Pose & pose = config.poses[sensor];
+        double ox = pose.x_mm / config.cell_mm, oy = pose.y_mm / config.cell_mm;
+
+        for (unsigned k = 0; k < s.counts[sensor]; k++)
+        {
+          const Ray & ray = s.rays[sensor * config.max_per_frame + k];
+          double length = (double)ray.range_mm / config.cell_mm;
+          for (int r = 0; r < config.rays; r++)
+          {
+            castRay(s.grid.data(), n, ox, oy, state.dx[r] * length, state.dy[r] * length, ray.hit, x0, y0, x1, y1);
+          }
+        }
+      }
+
+      uint32_t occupied = 0, free = 0;
+      uint64_t checksum = 0;
+      for (int y = y0; y < y1; y++)
+      {
+        for (int x = x0; x < x1; x++)
+        {
+          int8_t v = s.grid[y * n + x];
+          occupied += v > 0;
+          free += v < 0;
+          checksum += (uint64_t)(uint8_t)v * (uint64_t)(y * n + x + 1);
+        }
+      }
+      s.occupied += occupied;
+      s.free += free;
+      s.checksum += checksum;
+    }
+
+    // Walk the segment from (ox, oy), clipped to the tile, half a cell at a
+    // time: cells passed through lose evidence, the end cell gains some if the
+    // ray hit something there.
+    static void castRay(int8_t * grid, int n, double ox, double oy, double dx, double dy, bool hit,
+                        int x0, int y0, int x1, int y1)
+    {
+      // Liang-Barsky clipping to the tile
+      double t0 = 0, t1 = 1;
+      double p[4] = { -dx, dx, -dy, dy };
+      double q[4] = { ox - x0, x1 - ox, oy - y0, y1 - oy };
+      for (int i = 0; i < 4; i++)
+      {
+        if (p[i] == 0)
+        {
+          if (q[i] < 0) { return; }
+          continue;
+        }
+        double t = q[i] / p[i];
+        if (p[i] < 0) { t0 = std::max(t0, t); }
+        else { t1 = std::min(t1, t); }
+      }
+      if (t0 >= t1) { return; }
+
+      double length = std::sqrt(dx * dx + dy * dy);
+      int steps = (int)std::ceil((t1 - t0) * length * 2) + 1;
+      int end_x = (int)std::floor(ox + dx), end_y = (int)std::floor(oy + dy);
+      int last = -1;
+
+      for (int i = 0; i <= steps; i++)
+      {
+        double t = t0 + (t1 - t0) * i / steps;
+        int cx = std::min(x1 - 1, std::max(x0, (int)std::floor(ox + dx * t)));
+        int cy = std::min(y1 - 1, std::max(y0, (int)std::floor(oy + dy * t)));
+        int cell = cy * n + cx;
+        if (cell == last) { continue; }
+        last = cell;
+
+        int8_t & v = grid[cell];
+        if (hit && cx == end_x && cy == end_y) { v = (int8_t)std::min(127, v + 4); }
+        else { v = (int8_t)std::max(-127, v - 1); }
+      }
+    }
+
+    void complete(uint64_t f)
+    {
+      std::unique_lock<std::mutex> lock(emit_mutex);
+      slot(f).done = true;
+
+      // deliver in order; frames are rarely ready out of order, and then
+      // the earlier frame's completion delivers them
+      while (slot(next_emit).done && slot(next_emit).frame == next_emit)
+      {
+        FrameSlot & s = slot(next_emit);
+        if (frame_callback)
+        {
+          FrameOutput out;
+          out.frame = s.frame;
+          out.samples = s.samples;
+          out.overflows = s.overflows;
+          out.occupied = s.occupied;
+          out.free = s.free;
+          out.checksum = s.checksum;
+          out.grid = s.grid.data();
+          frame_callback(out);
+        }
+        reset(s, next_emit + config.frame_window);
+        next_emit++;
+      }
+      emit_cv.notify_all();
+    }
+};
@@ -0,0 +1,674 @@
+// Virtual sensor array load generator.
+//
+// Simulates a number of nodes (devices on their own serial link), each with a
+// number of sensors, producing Sample frames exactly as VL53L1XControl sends
+// them (see VL53L1XProtocol.h), and feeds them to a reference host pipeline:
+// one reader per link, decoding frames with VL53L1XFrameParser and checking
+// every stream. Reports throughput, end-to-end latency percentiles (from when
+// a reading was taken to when its frame was decoded), losses and how far the
+// generator slipped behind schedule when the links pushed back.
+//
+// Streams are made realistic enough to exercise the pipeline:
+//
+// - each sensor has its own rate (--rate, spread by --rate-spread) and its
+//   own clock error (up to --drift ppm), so timestamps drift apart;
+// - ranges follow a moving target, with noise and occasional no-target
+//   samples, and signal rates that fall with distance;
+// - --drop loses single samples on the device (the stream count still
+//   advances, so the reader sees a gap);
+// - --bursts stalls a node for --burst-ms now and then (a busy device, a USB
+//   serial adapter holding data) and then sends everything held at once;
+// - --link-bps limits each link to a serial line rate (10 bits per byte).
+//
+// Links are either in-process byte channels (--transport channel, the
+// default) or pseudo-terminals (--transport pty), so the same stream can be
+// read through the kernel tty layer like a real serial port. With --external,
+// the pty names are printed and nothing reads them: point the real host
+// pipeline at them instead (latency is then not measured here).
+//
+// Build and usage: see README.md.
+
+#include "VL53L1XProtocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef VL53L1XProtocol P;
+typedef std::chrono::steady_clock Clock;
+
+// range status values, as in VL53L1X::RangeStatus
+static const uint8_t RangeValid = 0;
+static const uint8_t SignalFail = 2;
+
+struct Options
+{
+  int nodes = 8;
+  int sensors = 16;             // per node, at most 128
+  double rate_hz = 50;          // per sensor
+  double rate_spread = 0.1;     // +- fraction
+  double drift_ppm = 50;
+  double drop = 0.001;          // probability per sample
+  double bursts = 0.5;          // stalls per node per second
+  double burst_ms = 20;
+  double link_bps = 0;          // 0: unlimited
+  double duration_s = 10;
+  size_t channel_bytes = 65536;
+  bool pty = false;
+  bool external = false;
+  bool csv = false;
+  unsigned seed = 1;
+};
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void sleepUntilUs(uint64_t t_us)
+{
+  std::this_thread::sleep_until(Clock::time_point(std::chrono::microseconds(t_us)));
+}
+
+// Links ///////////////////////////////////////////////////////////////////////
+
+class Link
+{
+  public:
+    virtual ~Link() {}
+    // blocks until everything is written (back-pressure)
+    virtual void write(const uint8_t * data, size_t length) = 0;
+    // blocks until something is available; returns 0 once closed and empty
+    virtual size_t read(uint8_t * data, size_t length) = 0;
+    virtual void close() = 0;
+};
+
+// single producer, single consumer byte ring
+class ChannelLink : public Link
+{
+  public:
+    explicit ChannelLink(size_t capacity) : buffer(capacity), head(0), tail(0), closed(false) {}
+
+    void write(const uint8_t * data, size_t length) override
+    {
+      while (length > 0)
+      {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t space = buffer.size() - (h - tail.load(std::memory_order_acquire));
+        if (space == 0) { std::this_thread::yield(); continue; }
+
+        size_t n = std::min(length, space);
+        for (size_t i = 0; i < n; i++) { buffer[(h + i) % buffer.size()] = data[i]; }
+        head.store(h + n, std::memory_order_release);
+        data += n;
+        length -= n;
+      }
+    }
+
+    size_t read(uint8_t * data, size_t length) override
+    {
+      for (;;)
+      {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t available = head.load(std::memory_order_acquire) - t;
+        if (available == 0)
+        {
+          if (closed.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == t) { return 0; }
+          std::this_thread::yield();
+          continue;
+        }
+
+        size_t n = std::min(length, available);
+        for (size_t i = 0; i < n; i++) { data[i] = buffer[(t + i) % buffer.size()]; }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+      }
+    }
+
+    void close() override { closed.store(true, std::memory_order_release); }
+
+  private:
+    std::vector<uint8_t> buffer;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<bool> closed;
+};
+
+// pseudo-terminal: the generator writes to the master side, the reader (or an
+// external program) reads the slave side, in raw mode
+class PtyLink : public Link
+{
+  public:
+    PtyLink() : master(-1), slave(-1)
+    {
+      master = posix_openpt(O_RDWR | O_NOCTTY);
+      if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+      {
+        perror("posix_openpt");
+        exit(1);
+      }
+      name = ptsname(master);
+
+      slave = open(name.c_str(), O_RDWR | O_NOCTTY);
+      if (slave < 0) { perror(name.c_str()); exit(1); }
+
+      struct termios tio;
+      tcgetattr(slave, &tio);
+      cfmakeraw(&tio);
+      tcsetattr(slave, TCSANOW, &tio);
+    }
+
+    ~PtyLink() override
+    {
+      if (slave >= 0) { ::close(slave); }
+      if (master >= 0) { ::close(master); }
+    }
+
+    void write(const uint8_t * data, size_t length) override
+    {
+      while (length > 0)
+      {
+        ssize_t n = ::write(master, data, length);
+        if (n <= 0) { return; }
+        data += n;
+        length -= n;
+      }
+    }
+
+    size_t read(uint8_t * data, size_t length) override
+    {
+      ssize_t n = ::read(slave, data, length);
+      return (n > 0) ? n : 0;
+    }
+
+    // closing the master side makes reads on the slave side fail, so let the
+    // reader catch up first (for at most a second, in case nobody reads)
+    void close() override
+    {
+      for (int i = 0; i < 1000; i++)
+      {
+        int pending = 0;
+        if (ioctl(slave, FIONREAD, &pending) != 0 || pending == 0) { break; }
+        usleep(1000);
+      }
+      ::close(master);
+      master = -1;
+    }
+
+    const std::string & getName() { return name; }
+
+  private:
+    int master;
+    int slave;
+    std::string name;
+};
+
+// Generator ///////////////////////////////////////////////////////////////////
+
+struct VirtualSensor
+{
+  double period_us;
+  double drift;             // clock error, as a fraction
+  uint32_t clock_offset_us; // the sensor clock's reading at time 0
+  uint64_t next_us;         // true time of the next reading
+  uint8_t stream_count;
+
+  // moving target
+  double range_mm;
+  double velocity_mm_s;
+  double ambient;           // MCPS
+};
+
+// the sensor's stream count runs 0-255, then wraps to 128
+static uint8_t nextStreamCount(uint8_t c) { return (c == 255) ? 128 : c + 1; }
+
+static int streamGap(uint8_t from, uint8_t to)
+{
+  if (to > from) { return to - from - 1; }
+  return (255 - from) + (to - 128);
+}
+
+struct NodeStats
+{
+  uint64_t generated = 0;
+  uint64_t dropped = 0;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  uint64_t stalls = 0;
+  uint64_t max_late_us = 0;
+};
+
+// Emission times of a node's frames, by frame count, for latency: the ring is
+// far larger than what a link can hold, so a reader never sees a slot reused.
+struct EmitTimes
+{
+  static const size_t Size = 1 << 16;
+  std::vector<std::atomic<uint64_t>> times;
+  EmitTimes() : times(Size) {}
+};
+
+class Node
+{
+  public:
+    Node(const Options & options, int index, Link & link, EmitTimes & emitted)
+      : options(options), link(link), emitted(emitted), random(options.seed * 7919 + index), sensors(options.sensors)
+    {
+      std::uniform_real_distribution<double> unit(-1, 1);
+
+      for (VirtualSensor & s : sensors)
+      {
+        s.period_us = 1e6 / (options.rate_hz * (1 + options.rate_spread * unit(random)));
+        s.drift = options.drift_ppm * 1e-6 * unit(random);
+        s.clock_offset_us = random();
+        s.next_us = 0;
+        s.stream_count = 0;
+        s.range_mm = 1000 + 900 * unit(random);
+        s.velocity_mm_s = 300 * unit(random);
+        s.ambient = 0.5 + 0.4 * unit(random);
+      }
+    }
+
+    void run(uint64_t start_us, uint64_t end_us)
+    {
+      std::uniform_real_distribution<double> unit(0, 1);
+      typedef std::pair<uint64_t, int> Due;
+      std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due;
+
+      // sensors don't start in step
+      for (int i = 0; i < (int)sensors.size(); i++)
+      {
+        sensors[i].next_us = start_us + (uint64_t)(sensors[i].period_us * unit(random));
+        due.push(Due(sensors[i].next_us, i));
+      }
+
+      uint64_t stall_until = 0;
+      uint64_t next_stall = start_us + nextStallIn(unit);
+      uint64_t link_free = start_us;
+      std::vector<uint8_t> held;
+
+      while (!due.empty())
+      {
+        uint64_t t = due.top().first;
+        if (!held.empty() && stall_until < t) { t = stall_until; }
+        if (t >= end_us) { break; }
+        sleepUntilUs(t);
+
+        uint64_t now = nowUs();
+        if (now > t && now - t > stats.max_late_us) { stats.max_late_us = now - t; }
+
+        if (now >= next_stall && options.bursts > 0)
+        {
+          stall_until = now + (uint64_t)(options.burst_ms * 1000);
+          next_stall = stall_until + nextStallIn(unit);
+          stats.stalls++;
+        }
+
+        std::vector<uint8_t> out;
+        out.swap(held);
+
+        while (!due.empty() && due.top().first <= now)
+        {
+          int i = due.top().second;
+          due.pop();
+          VirtualSensor & s = sensors[i];
+          uint64_t taken_us = s.next_us;
+          s.next_us += (uint64_t)s.period_us;
+          due.push(Due(s.next_us, i));
+
+          uint8_t payload[P::SampleLength];
+          measure(s, taken_us, payload);
+          stats.generated++;
+
+          if (unit(random) < options.drop)
+          {
+            stats.dropped++;
+            continue;
+          }
+          frame(i, taken_us, payload, out);
+        }
+
+        if (now < stall_until)
+        {
+          held.swap(out);
+          continue;
+        }
+        if (out.empty()) { continue; }
+
+        if (options.link_bps > 0)
+        {
+          if (link_free > now) { sleepUntilUs(link_free); }
+          link_free = std::max(now, link_free) + (uint64_t)(out.size() * 10 * 1e6 / options.link_bps);
+        }
+        link.write(out.data(), out.size());
+        stats.bytes += out.size();
+      }
+
+      if (!held.empty())
+      {
+        link.write(held.data(), held.size());
+        stats.bytes += held.size();
+      }
+      link.close();
+    }
+
+    const NodeStats & getStats() { return stats; }
+
+  private:
+    const Options & options;
+    Link & link;
+    EmitTimes & emitted;
+    std::mt19937 random;
+    std::vector<VirtualSensor> sensors;
+    NodeStats stats;
+
+    uint64_t nextStallIn(std::uniform_real_distribution<double> & unit)
+    {
+      if (options.bursts <= 0) { return UINT64_MAX / 2; }
+      return (uint64_t)(-std::log(1 - unit(random)) / options.bursts * 1e6);
+    }
+
+    void measure(VirtualSensor & s, uint64_t taken_us, uint8_t * payload)
+    {
+      std::normal_distribution<double> noise(0, 1);
+      double dt = s.period_us * 1e-6;
+
+      s.velocity_mm_s += 50 * noise(random);
+      s.velocity_mm_s = std::max(-800.0, std::min(800.0, s.velocity_mm_s));
+      s.range_mm += s.velocity_mm_s * dt;
+      if (s.range_mm < 50) { s.range_mm = 50; s.velocity_mm_s = -s.velocity_mm_s; }
+      if (s.range_mm > 3600) { s.range_mm = 3600; s.velocity_mm_s = -s.velocity_mm_s; }
+
+      // the signal falls with the square of the distance; far targets are
+      // sometimes lost
+      double signal = 40.0 / ((s.range_mm / 1000) * (s.range_mm / 1000) + 0.05);
+      bool lost = std::uniform_real_distribution<double>(0, 1)(random) < 0.02 + 0.1 * (s.range_mm > 3000);
+      double range = s.range_mm + (2 + s.range_mm * 0.005) * noise(random);
+      double ambient = std::max(0.0, s.ambient + 0.05 * noise(random));
+
+      uint32_t device_us = s.clock_offset_us + (uint32_t)(uint64_t)((double)taken_us * (1 + s.drift));
+      uint16_t range_mm = lost ? 0 : (uint16_t)std::max(0.0, range);
+      uint16_t signal_fixed = lost ? 0 : (uint16_t)std::min(65535.0, signal * 128);
+      uint16_t ambient_fixed = (uint16_t)std::min(65535.0, ambient * 128);
+
+      P::put32(payload, device_us);
+      P::put16(payload + 4, range_mm);
+      P::put16(payload + 6, signal_fixed);
+      P::put16(payload + 8, ambient_fixed);
+      payload[10] = lost ? SignalFail : RangeValid;
+      payload[11] = s.stream_count;
+      s.stream_count = nextStreamCount(s.stream_count);
+    }
+
+    void frame(int index, uint64_t taken_us, const uint8_t * payload, std::vector<uint8_t> & out)
+    {
+      P::Frame f;
+      f.seq = (uint8_t)stats.frames;
+      f.type = P::Sample;
+      f.target = index;
+      f.length = P::SampleLength;
+      memcpy(f.payload, payload, P::SampleLength);
+
+      emitted.times[stats.frames % EmitTimes::Size].store(taken_us, std::memory_order_relaxed);
+      stats.frames++;
+
+      uint8_t buffer[P::MaxFrame];
+      uint8_t length = P::encode(f, buffer);
+      out.insert(out.end(), buffer, buffer + length);
+    }
+};
+
+// Reference pipeline //////////////////////////////////////////////////////////
+
+struct ReaderStats
+{
+  uint64_t samples = 0;
+  uint64_t gaps = 0;            // samples missing according to stream counts
+  uint64_t seq_errors = 0;      // frames missing according to frame sequence
+  uint64_t backwards = 0;       // timestamps going backwards
+  uint64_t crc_errors = 0;
+  std::vector<uint32_t> latency_us;
+};
+
+static void readLink(Link & link, const EmitTimes & emitted, int sensor_count, ReaderStats & stats)
+{
+  VL53L1XFrameParser parser;
+  std::vector<int> last_count(sensor_count, -1);
+  std::vector<uint32_t> last_time(sensor_count, 0);
+  uint64_t frames = 0;
+  uint8_t buffer[4096];
+
+  for (;;)
+  {
+    size_t n = link.read(buffer, sizeof(buffer));
+    if (n == 0) { break; }
+    uint64_t now = nowUs();
+
+    for (size_t i = 0; i < n; i++)
+    {
+      if (!parser.feed(buffer[i])) { continue; }
+      const P::Frame & f = parser.frame();
+      if (f.type != P::Sample || f.length != P::SampleLength || f.target >= sensor_count) { continue; }
+
+      if (f.seq != (uint8_t)frames)
+      {
+        stats.seq_errors++;
+        frames += (uint8_t)(f.seq - (uint8_t)frames);
+      }
+      uint64_t taken_us = emitted.times[frames % EmitTimes::Size].load(std::memory_order_relaxed);
+      frames++;
+      stats.latency_us.push_back((uint32_t)std::min<uint64_t>(now - taken_us, UINT32_MAX));
+
+      uint32_t timestamp_us = P::get32(f.payload);
+      uint8_t count = f.payload[11];
+      int s = f.target;
+      if (last_count[s] >= 0)
+      {
+        stats.gaps += streamGap(last_count[s], count);
+        if ((int32_t)(timestamp_us - last_time[s]) <= 0) { stats.backwards++; }
+      }
+      last_count[s] = count;
+      last_time[s] = timestamp_us;
+      stats.samples++;
+    }
+  }
+
+  stats.crc_errors = parser.crcErrors() + parser.overrunErrors();
+}
+
+// Main ////////////////////////////////////////////////////////////////////////
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: loadgen [options]\n"
+    "  --nodes N          links (default 8)\n"
+    "  --sensors N        sensors per link, 1-128 (default 16)\n"
+    "  --rate HZ          readings per second per sensor (default 50)\n"
+    "  --rate-spread F    per-sensor rate spread, +-fraction (default 0.1)\n"
+    "  --drift PPM        maximum clock error per sensor (default 50)\n"
+    "  --drop P           probability of losing a sample (default 0.001)\n"
+    "  --bursts R         stalls per link per second (default 0.5)\n"
+    "  --burst-ms MS      length of a stall (default 20)\n"
+    "  --link-bps BPS     serial line rate per link, 0 for none (default 0)\n"
+    "  --duration S       run time in seconds (default 10)\n"
+    "  --channel-bytes N  in-process channel capacity (default 65536)\n"
+    "  --transport T      channel or pty (default channel)\n"
+    "  --external         pty only: print the pty names, don't read them\n"
+    "  --csv              print one summary line of comma-separated values\n"
+    "  --seed N           random seed (default 1)\n");
+  exit(2);
+}
+
+static Options parse(int argc, char ** argv)
+{
+  Options o;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    auto value = [&]() -> const char * { if (i + 1 >= argc) { usage(); } return argv[++i]; };
+
+    if (a == "--nodes") { o.nodes = atoi(value()); }
+    else if (a == "--sensors") { o.sensors = atoi(value()); }
+    else if (a == "--rate") { o.rate_hz = atof(value()); }
+    else if (a == "--rate-spread") { o.rate_spread = atof(value()); }
+    else if (a == "--drift") { o.drift_ppm = atof(value()); }
+    else if (a == "--drop") { o.drop = atof(value()); }
+    else if (a == "--bursts") { o.bursts = atof(value()); }
+    else if (a == "--burst-ms") { o.burst_ms = atof(value()); }
+    else if (a == "--link-bps") { o.link_bps = atof(value()); }
+    else if (a == "--duration") { o.duration_s = atof(value()); }
+    else if (a == "--channel-bytes") { o.channel_bytes = strtoul(value(), nullptr, 0); }
+    else if (a == "--transport")
+    {
+      std::string t = value();
+      if (t == "pty") { o.pty = true; }
+      else if (t != "channel") { usage(); }
+    }
+    else if (a == "--external") { o.external = true; }
+    else if (a == "--csv") { o.csv = true; }
+    else if (a == "--seed") { o.seed = atoi(value()); }
+    else { usage(); }
+  }
+
+  if (o.nodes < 1 || o.sensors < 1 || o.sensors > 128 || o.rate_hz <= 0 || o.rate_spread < 0 ||
+      o.rate_spread >= 1 || o.duration_s <= 0 || o.channel_bytes < P::MaxFrame || (o.external && !o.pty))
+  {
+    usage();
+  }
+
+  // frames a link can have in flight must fit the emission time ring
+  double in_flight = o.channel_bytes / (double)(P::HeaderLength + P::SampleLength + 1) +
+                     o.burst_ms * 1e-3 * o.rate_hz * (1 + o.rate_spread) * o.sensors;
+  if (in_flight > EmitTimes::Size / 2)
+  {
+    fprintf(stderr, "loadgen: channel or stalls too large to track latency\n");
+    exit(2);
+  }
+  return o;
+}
+
+static uint32_t percentile(const std::vector<uint32_t> & sorted, double p)
+{
+  if (sorted.empty()) { return 0; }
+  size_t i = (size_t)std::ceil(p * sorted.size());
+  return sorted[std::min(sorted.size() - 1, i > 0 ? i - 1 : 0)];
+}
+
+int main(int argc, char ** argv)
+{
+  Options o = parse(argc, argv);
+
+  std::vector<std::unique_ptr<Link>> links;
+  std::vector<std::unique_ptr<EmitTimes>> emitted;
+  std::vector<std::unique_ptr<Node>> nodes;
+  std::vector<ReaderStats> readers(o.nodes);
+
+  for (int i = 0; i < o.nodes; i++)
+  {
+    if (o.pty)
+    {
+      PtyLink * pty = new PtyLink();
+      if (o.external) { printf("%s\n", pty->getName().c_str()); }
+      links.emplace_back(pty);
+    }
+    else
+    {
+      links.emplace_back(new ChannelLink(o.channel_bytes));
+    }
+    emitted.emplace_back(new EmitTimes());
+    nodes.emplace_back(new Node(o, i, *links[i], *emitted[i]));
+  }
+  fflush(stdout);
+
+  uint64_t start_us = nowUs() + 100000;
+  uint64_t end_us = start_us + (uint64_t)(o.duration_s * 1e6);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < o.nodes; i++)
+  {
+    threads.emplace_back([&, i]() { nodes[i]->run(start_us, end_us); });
+    if (!o.external)
+    {
+      threads.emplace_back([&, i]() { readLink(*links[i], *emitted[i], o.sensors, readers[i]); });
+    }
+  }
+  for (std::thread & t : threads) { t.join(); }
+  double elapsed_s = (nowUs() - start_us) * 1e-6;
+
+  NodeStats total;
+  for (auto & node : nodes)
+  {
+    const NodeStats & s = node->getStats();
+    total.generated += s.generated;
+    total.dropped += s.dropped;
+    total.frames += s.frames;
+    total.bytes += s.bytes;
+    total.stalls += s.stalls;
+    total.max_late_us = std::max(total.max_late_us, s.max_late_us);
+  }
+
+  ReaderStats read;
+  for (ReaderStats & r : readers)
+  {
+    read.samples += r.samples;
+    read.gaps += r.gaps;
+    read.seq_errors += r.seq_errors;
+    read.backwards += r.backwards;
+    read.crc_errors += r.crc_errors;
+    read.latency_us.insert(read.latency_us.end(), r.latency_us.begin(), r.latency_us.end());
+  }
+  std::sort(read.latency_us.begin(), read.latency_us.end());
+  uint32_t p50 = percentile(read.latency_us, 0.50);
+  uint32_t p90 = percentile(read.latency_us, 0.90);
+  uint32_t p99 = percentile(read.latency_us, 0.99);
+  uint32_t p999 = percentile(read.latency_us, 0.999);
+  uint32_t max = read.latency_us.empty() ? 0 : read.latency_us.back();
+
+  if (o.csv)
+  {
+    printf("nodes,sensors,rate_hz,transport,generated,dropped,received,gaps,seq_errors,crc_errors,"
+           "samples_per_s,bytes_per_s,p50_us,p90_us,p99_us,p999_us,max_us,max_late_us\n");
+    printf("%d,%d,%g,%s,%llu,%llu,%llu,%llu,%llu,%llu,%.0f,%.0f,%u,%u,%u,%u,%u,%llu\n",
+           o.nodes, o.sensors, o.rate_hz, o.pty ? "pty" : "channel",
+           (unsigned long long)total.generated, (unsigned long long)total.dropped,
+           (unsigned long long)read.samples, (unsigned long long)read.gaps,
+           (unsigned long long)read.seq_errors, (unsigned long long)read.crc_errors,
+           read.samples / elapsed_s, total.bytes / elapsed_s, p50, p90, p99, p999, max,
+           (unsigned long long)total.max_late_us);
+    return 0;
+  }
+
+  printf("%d links x %d sensors at %g Hz over %s, %.1f s\n",
+         o.nodes, o.sensors, o.rate_hz, o.pty ? "pty" : "channel", elapsed_s);
+  printf("generated  %llu samples, %llu dropped on the device, %llu stalls\n",
+         (unsigned long long)total.generated, (unsigned long long)total.dropped, (unsigned long long)total.stalls);
+  printf("sent       %llu frames, %llu bytes (%.0f bytes/s)\n",
+         (unsigned long long)total.frames, (unsigned long long)total.bytes, total.bytes / elapsed_s);
+  printf("schedule   max %llu us late\n", (unsigned long long)total.max_late_us);
+  if (o.external) { return 0; }
+
+  printf("received   %llu samples (%.0f samples/s)\n", (unsigned long long)read.samples, read.samples / elapsed_s);
+  printf("checks     %llu stream gaps, %llu sequence errors, %llu CRC errors, %llu timestamps backwards\n",
+         (unsigned long long)read.gaps, (unsigned long long)read.seq_errors,
+         (unsigned long long)read.crc_errors, (unsigned long long)read.backwards);
+  printf("latency    p50 %u us, p90 %u us, p99 %u us, p99.9 %u us, max %u us\n", p50, p90, p99, p999, max);
+
+  // every sample lost on the device shows up as a gap, except ones lost at the
+  // very start or end of a stream; nothing else should
+  return (read.gaps <= total.dropped && read.seq_errors == 0 && read.crc_errors == 0) ? 0 : 1;
+}
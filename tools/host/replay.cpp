@@ -0,0 +1,859 @@
+// Offline replay of recorded sample logs through a chain of processing stages.
+//
+// A log is a capture of a device's serial stream (the bytes VL53L1XControl
+// sends, as read from the port); its Sample frames are decoded with
+// VL53L1XFrameParser and everything else is skipped. The samples are run, in
+// recorded order and on the log's own timeline (the device timestamps), through
+// the stages given with --stage, in that order:
+//
+// - median, smooth: the per-sensor range filter of the fusion runtime (median
+//   of three, exponential smoothing), applied to valid samples;
+// - background: VL53L1XBackground, detecting foreground onsets;
+// - rules: VL53L1XRuleEngine with the rules given by --rule, detecting alerts;
+// - trend: VL53L1XTrend, detecting sensors becoming flagged;
+// - resample: VL53L1XResampler onto a common timebase, measuring how old each
+//   sensor's output is when its frame is produced.
+//
+// The device stages are the library's own code, built for the host, so what is
+// measured is what would run on the device (on a faster CPU). Filters change
+// the ranges seen by the stages after them.
+//
+// The tool reports each stage's CPU time per sample and, given annotations
+// (--truth), its accuracy: range errors against annotated true ranges after
+// every filter, and for detecting stages the fraction of annotated events
+// detected, false detections and the latency from the start of an event to its
+// detection. Samples are processed in blocks, each stage over a whole block at
+// a time, so the timing costs nothing per sample and a log of hours replays in
+// seconds.
+//
+// Build and usage: see README.md.
+
+#include <VL53L1XBackground.h>
+#include <VL53L1XProtocol.h>
+#include <VL53L1XResampler.h>
+#include <VL53L1XRuleEngine.h>
+#include <VL53L1XTrend.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef VL53L1XProtocol P;
+typedef std::chrono::steady_clock Clock;
+
+// sensors are frame targets 0-0x7F
+static const int MaxSensors = 128;
+static const size_t BlockSamples = 4096;
+static const uint16_t NoTruth = 0xFFFF;
+
+struct Sample
+{
+  uint64_t time_us;       // since the first sample of the log
+  uint8_t sensor;
+  uint8_t range_status;
+  uint16_t range_mm;      // changed by filters
+  uint16_t signal_fixed;
+  uint16_t ambient_fixed;
+  uint16_t truth_mm;      // annotated true range, or NoTruth
+};
+
+struct Detection
+{
+  uint64_t time_us;
+  uint8_t sensor;
+};
+
+static double msOf(uint64_t us) { return us / 1000.0; }
+
+static double percentile(std::vector<double> values, double p)
+{
+  if (values.empty()) { return 0; }
+  std::sort(values.begin(), values.end());
+  size_t i = (size_t)std::min<double>(values.size() - 1, p * values.size());
+  return values[i];
+}
+
+// Options /////////////////////////////////////////////////////////////////////
+
+typedef std::map<std::string, std::string> Params;
+
+struct StageSpec
+{
+  std::string name;
+  Params params;
+};
+
+struct Options
+{
+  std::string log;
+  std::string truth;
+  std::vector<StageSpec> stages;
+  std::vector<VL53L1XRuleEngine::Rule> rules;
+  double tolerance_ms = 1000;
+  bool csv = false;
+};
+
+[[noreturn]] static void usage()
+{
+  fprintf(stderr,
+    "usage: replay [options] LOG\n"
+    "  --stage NAME[:KEY=VALUE,...]   add a stage to the chain, in order:\n"
+    "      median\n"
+    "      smooth        alpha (0.5)\n"
+    "      background    rate_shift (5), train (32), multiple_q2 (16), margin_mm (60),\n"
+    "                    absorb (3000)\n"
+    "      rules         the rules given by --rule\n"
+    "      trend         epoch_s (60), learn (1000), loss (30), horizon (10080),\n"
+    "                    validity_loss (10), ambient_rise (100)\n"
+    "      resample      sensors (16), period_ms (20), delay_ms (20), extrapolation_ms (100)\n"
+    "  --rule KIND:THRESHOLD[:COUNT[:REARM[:SENSOR]]]\n"
+    "                    a rule for the rules stage; KIND is below, above, status,\n"
+    "                    changed or approach (see VL53L1XRuleEngine)\n"
+    "  --truth FILE      annotations to measure accuracy against\n"
+    "  --tolerance-ms MS detections up to this long after an annotated event\n"
+    "                    still count for it (default 1000)\n"
+    "  --csv             one line per stage, for sweeps\n");
+  exit(2);
+}
+
+static double param(const StageSpec & spec, const char * key, double fallback)
+{
+  Params::const_iterator i = spec.params.find(key);
+  return (i != spec.params.end()) ? atof(i->second.c_str()) : fallback;
+}
+
+static StageSpec parseStage(const std::string & text)
+{
+  StageSpec spec;
+  size_t colon = text.find(':');
+  spec.name = text.substr(0, colon);
+  if (colon == std::string::npos) { return spec; }
+
+  std::string rest = text.substr(colon + 1);
+  size_t start = 0;
+  while (start <= rest.size())
+  {
+    size_t comma = rest.find(',', start);
+    if (comma == std::string::npos) { comma = rest.size(); }
+    std::string item = rest.substr(start, comma - start);
+    size_t equals = item.find('=');
+    if (equals == std::string::npos)
+    {
+      fprintf(stderr, "stage %s: expected KEY=VALUE, got '%s'\n", spec.name.c_str(), item.c_str());
+      exit(2);
+    }
+    spec.params[item.substr(0, equals)] = item.substr(equals + 1);
+    start = comma + 1;
+  }
+  return spec;
+}
+
+static VL53L1XRuleEngine::Rule parseRule(const std::string & text, uint8_t id)
+{
+  static const struct { const char * name; VL53L1XRuleEngine::Kind kind; } kinds[] = {
+    {"below", VL53L1XRuleEngine::RangeBelow},
+    {"above", VL53L1XRuleEngine::RangeAbove},
+    {"status", VL53L1XRuleEngine::StatusIs},
+    {"changed", VL53L1XRuleEngine::StatusChanged},
+    {"approach", VL53L1XRuleEngine::ApproachFaster},
+  };
+
+  std::vector<std::string> fields;
+  size_t start = 0;
+  while (start <= text.size())
+  {
+    size_t colon = text.find(':', start);
+    if (colon == std::string::npos) { colon = text.size(); }
+    fields.push_back(text.substr(start, colon - start));
+    start = colon + 1;
+  }
+
+  VL53L1XRuleEngine::Rule rule = {id, (VL53L1XRuleEngine::Kind)0, VL53L1XRuleEngine::TargetAll, 1, 0, 0};
+  for (const auto & k : kinds)
+  {
+    if (fields[0] == k.name) { rule.kind = k.kind; }
+  }
+  if (rule.kind == 0 || fields.size() < 2 || fields.size() > 5)
+  {
+    fprintf(stderr, "bad rule '%s'\n", text.c_str());
+    exit(2);
+  }
+  rule.threshold = atoi(fields[1].c_str());
+  if (fields.size() > 2) { rule.count = atoi(fields[2].c_str()); }
+  if (fields.size() > 3) { rule.rearm = atoi(fields[3].c_str()); }
+  if (fields.size() > 4) { rule.target = atoi(fields[4].c_str()); }
+  return rule;
+}
+
+static Options parse(int argc, char ** argv)
+{
+  Options o;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    if (a == "--csv") { o.csv = true; continue; }
+    if (a == "--help" || a == "-h") { usage(); }
+    if (a.compare(0, 2, "--") != 0)
+    {
+      if (!o.log.empty()) { usage(); }
+      o.log = a;
+      continue;
+    }
+    if (i + 1 >= argc) { usage(); }
+    std::string v = argv[++i];
+
+    if (a == "--stage") { o.stages.push_back(parseStage(v)); }
+    else if (a == "--rule") { o.rules.push_back(parseRule(v, o.rules.size() + 1)); }
+    else if (a == "--truth") { o.truth = v; }
+    else if (a == "--tolerance-ms") { o.tolerance_ms = atof(v.c_str()); }
+    else { usage(); }
+  }
+  if (o.log.empty() || o.stages.empty()) { usage(); }
+  return o;
+}
+
+// Annotations /////////////////////////////////////////////////////////////////
+
+// One line per annotation, times in ms on the log's timeline (from its first
+// sample):
+//
+//   range,SENSOR,START_MS,END_MS,RANGE_MM    the true range over the interval
+//   event,SENSOR,START_MS,END_MS             something to detect (e.g. a person)
+//
+// Blank lines and lines starting with # are ignored.
+struct Interval
+{
+  uint64_t start_us;
+  uint64_t end_us;
+  uint16_t range_mm;
+};
+
+struct Truth
+{
+  std::vector<Interval> ranges[MaxSensors];
+  std::vector<Interval> events[MaxSensors];
+  size_t cursor[MaxSensors] = {};
+  bool any_ranges = false;
+  bool any_events = false;
+
+  bool load(const std::string & path)
+  {
+    FILE * f = fopen(path.c_str(), "r");
+    if (f == nullptr) { perror(path.c_str()); return false; }
+
+    char line[256];
+    int number = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+      number++;
+      char kind[16];
+      unsigned sensor;
+      double start_ms, end_ms;
+      unsigned range_mm = 0;
+      if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) { continue; }
+
+      int fields = sscanf(line, "%15[a-z],%u,%lf,%lf,%u", kind, &sensor, &start_ms, &end_ms, &range_mm);
+      bool is_range = fields == 5 && strcmp(kind, "range") == 0;
+      bool is_event = fields == 4 && strcmp(kind, "event") == 0;
+      if ((!is_range && !is_event) || sensor >= MaxSensors || end_ms < start_ms)
+      {
+        fprintf(stderr, "%s:%d: bad annotation\n", path.c_str(), number);
+        fclose(f);
+        return false;
+      }
+
+      Interval interval = {(uint64_t)(start_ms * 1000), (uint64_t)(end_ms * 1000), (uint16_t)range_mm};
+      (is_range ? ranges : events)[sensor].push_back(interval);
+      (is_range ? any_ranges : any_events) = true;
+    }
+    fclose(f);
+
+    for (int s = 0; s < MaxSensors; s++)
+    {
+      auto by_start = [](const Interval & a, const Interval & b) { return a.start_us < b.start_us; };
+      std::sort(ranges[s].begin(), ranges[s].end(), by_start);
+      std::sort(events[s].begin(), events[s].end(), by_start);
+    }
+    return true;
+  }
+
+  // true range of a sensor at t; samples of a sensor come in time order
+  uint16_t rangeAt(uint8_t sensor, uint64_t t_us)
+  {
+    const std::vector<Interval> & list = ranges[sensor];
+    size_t & i = cursor[sensor];
+    while (i < list.size() && list[i].end_us < t_us) { i++; }
+    return (i < list.size() && list[i].start_us <= t_us) ? list[i].range_mm : NoTruth;
+  }
+};
+
+// Stages //////////////////////////////////////////////////////////////////////
+
+class Stage
+{
+  public:
+    explicit Stage(const std::string & name) : name(name) {}
+    virtual ~Stage() {}
+
+    virtual void process(Sample * samples, size_t count) = 0;
+
+    // filters change ranges; detectors produce detections
+    virtual bool filters() { return false; }
+    virtual bool detects() { return false; }
+    // anything else worth reporting
+    virtual void report(FILE *) {}
+
+    std::string name;
+    std::vector<Detection> detections;
+};
+
+// the per-sensor range filter of FusionRuntime, split in its two steps
+class MedianStage : public Stage
+{
+  public:
+    MedianStage() : Stage("median") {}
+    bool filters() override { return true; }
+
+    void process(Sample * samples, size_t count) override
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        Sample & s = samples[i];
+        if (s.range_status != VL53L1X::RangeValid) { continue; }
+        State & st = states[s.sensor];
+        st.last[0] = st.last[1];
+        st.last[1] = st.last[2];
+        st.last[2] = s.range_mm;
+        if (st.seen < 3) { st.seen++; }
+        if (st.seen == 3)
+        {
+          uint16_t a = st.last[0], b = st.last[1], c = st.last[2];
+          s.range_mm = std::max(std::min(a, b), std::min(std::max(a, b), c));
+        }
+      }
+    }
+
+  private:
+    struct State { uint16_t last[3]; uint8_t seen; };
+    State states[MaxSensors] = {};
+};
+
+class SmoothStage : public Stage
+{
+  public:
+    explicit SmoothStage(const StageSpec & spec) : Stage("smooth"), alpha(param(spec, "alpha", 0.5))
+    {
+      std::fill(states, states + MaxSensors, -1.0);
+    }
+    bool filters() override { return true; }
+
+    void process(Sample * samples, size_t count) override
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        Sample & s = samples[i];
+        if (s.range_status != VL53L1X::RangeValid) { continue; }
+        double & smoothed = states[s.sensor];
+        smoothed = (smoothed < 0) ? s.range_mm : smoothed + alpha * (s.range_mm - smoothed);
+        s.range_mm = (uint16_t)std::lround(smoothed);
+      }
+    }
+
+  private:
+    double alpha;
+    double states[MaxSensors]; // smoothed range, or -1 before the first sample
+};
+
+class BackgroundStage : public Stage
+{
+  public:
+    explicit BackgroundStage(const StageSpec & spec) : Stage("background"), model(cells, MaxSensors, 1)
+    {
+      model.setLearning(param(spec, "rate_shift", 5), param(spec, "train", 32));
+      model.setThreshold(param(spec, "multiple_q2", 16), param(spec, "margin_mm", 60));
+      model.setAbsorb(param(spec, "absorb", 3000));
+    }
+    bool detects() override { return true; }
+
+    void process(Sample * samples, size_t count) override
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        const Sample & s = samples[i];
+        VL53L1XBackground::Result result = model.classify(s.sensor, 0, s.range_mm, s.range_status);
+        if (result == VL53L1XBackground::Ignored) { continue; }
+
+        bool now = result == VL53L1XBackground::Foreground;
+        if (now && !foreground[s.sensor]) { detections.push_back({s.time_us, s.sensor}); }
+        foreground[s.sensor] = now;
+      }
+    }
+
+  private:
+    VL53L1XBackground::Cell cells[MaxSensors];
+    VL53L1XBackground model;
+    bool foreground[MaxSensors] = {};
+};
+
+class RulesStage : public Stage
+{
+  public:
+    explicit RulesStage(const std::vector<VL53L1XRuleEngine::Rule> & source)
+      : Stage("rules"), rules(max_rules), entries(max_rules * MaxSensors), states(MaxSensors),
+        engine(rules.data(), max_rules, entries.data(), entries.size(), states.data(), MaxSensors)
+    {
+      for (const VL53L1XRuleEngine::Rule & rule : source)
+      {
+        if (!engine.add(rule)) { fprintf(stderr, "rule %u rejected\n", rule.id); exit(2); }
+      }
+      if (!engine.compile()) { fprintf(stderr, "rules don't compile (too many per sensor?)\n"); exit(2); }
+    }
+    bool detects() override { return true; }
+
+    void process(Sample * samples, size_t count) override
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        const Sample & s = samples[i];
+        if (engine.evaluate(s.sensor, s.range_mm, s.range_status, s.time_us / 1000) == 0) { continue; }
+
+        VL53L1XRuleEngine::Alert alert;
+        while (engine.pollAlert(&alert)) { detections.push_back({s.time_us, alert.sensor}); }
+      }
+    }
+
+    void report(FILE * out) override
+    {
+      if (engine.getDroppedAlerts() > 0) { fprintf(out, "  rules: %u alerts dropped\n", engine.getDroppedAlerts()); }
+    }
+
+  private:
+    static const uint8_t max_rules = VL53L1XRuleEngine::MaxRulesPerSensor;
+    std::vector<VL53L1XRuleEngine::Rule> rules;
+    std::vector<VL53L1XRuleEngine::Entry> entries;
+    std::vector<VL53L1XRuleEngine::SensorState> states;
+    VL53L1XRuleEngine engine;
+};
+
+// VL53L1XTrend reads millis(), so the host clock follows the log
+class TrendStage : public Stage
+{
+  public:
+    explicit TrendStage(const StageSpec & spec) : Stage("trend"), trend(tracks, MaxSensors)
+    {
+      trend.setEpoch(param(spec, "epoch_s", 60) * 1000);
+      trend.setLearnSamples(param(spec, "learn", 1000));
+      trend.setSignalLoss(param(spec, "loss", 30));
+      trend.setHorizon(param(spec, "horizon", 10080));
+      trend.setValidityLoss(param(spec, "validity_loss", 10));
+      trend.setAmbientRise(param(spec, "ambient_rise", 100));
+    }
+    bool detects() override { return true; }
+
+    void process(Sample * samples, size_t count) override
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        const Sample & s = samples[i];
+        setHostMicros(s.time_us);
+        uint8_t before = trend.getFlags(s.sensor);
+        if (trend.sample(s.sensor, s.range_mm, s.range_status, s.signal_fixed, s.ambient_fixed) &&
+            before == 0 && trend.getFlags(s.sensor) != 0)
+        {
+          detections.push_back({s.time_us, s.sensor});
+        }
+      }
+    }
+
+  private:
+    VL53L1XTrend::Track tracks[MaxSensors];
+    VL53L1XTrend trend;
+};
+
+// Output latency of the resampled stream: how long after a sample was taken
+// a frame carrying it (interpolated or extrapolated) is produced. The
+// resampler's work per frame grows with its sensor count N, so it is built for
+// the array's size (the sensors parameter) rather than for MaxSensors.
+template <uint8_t N>
+class ResampleStage : public Stage
+{
+  public:
+    explicit ResampleStage(const StageSpec & spec)
+      : Stage("resample"),
+        resampler(new Resampler(param(spec, "period_ms", 20) * 1000, param(spec, "delay_ms", 20) * 1000,
+                                param(spec, "extrapolation_ms", 100) * 1000)),
+        latency_bins(LatencyBins, 0)
+    {
+      resampler->start(0);
+    }
+
+    void process(Sample * samples, size_t count) override
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        const Sample & s = samples[i];
+        if (s.sensor >= N)
+        {
+          skipped++;
+          continue;
+        }
+        seen[s.sensor] = true;
+        resampler->push(s.sensor, s.range_mm, s.range_status, (uint32_t)s.time_us);
+
+        while (resampler->update((uint32_t)s.time_us, &frame))
+        {
+          frames++;
+          uint32_t produced_after_tick = (uint32_t)s.time_us - frame.time_us;
+          for (uint8_t k = 0; k < N; k++)
+          {
+            if (!seen[k]) { continue; }
+            modes[frame.mode[k]]++;
+            if (frame.mode[k] == Resampler::Missing) { continue; }
+            uint32_t bin = (produced_after_tick + frame.age_us[k]) / 100;
+            latency_bins[std::min<uint32_t>(bin, LatencyBins - 1)]++;
+          }
+        }
+      }
+    }
+
+    void report(FILE * out) override
+    {
+      uint64_t outputs = 0;
+      for (uint64_t n : latency_bins) { outputs += n; }
+      fprintf(out, "  resample: %llu frames; sensor outputs: %llu interpolated, %llu extrapolated, %llu held, "
+              "%llu stale, %llu missing\n", (unsigned long long)frames,
+              (unsigned long long)modes[Resampler::Interpolated], (unsigned long long)modes[Resampler::Extrapolated],
+              (unsigned long long)modes[Resampler::Held], (unsigned long long)modes[Resampler::Stale],
+              (unsigned long long)modes[Resampler::Missing]);
+      if (skipped > 0) { fprintf(out, "  resample: %llu samples of sensors %u and up skipped\n", (unsigned long long)skipped, N); }
+      if (outputs == 0) { return; }
+      fprintf(out, "  resample: output latency p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n",
+              binPercentile(outputs, 0.50), binPercentile(outputs, 0.95), binPercentile(outputs, 0.99));
+    }
+
+  private:
+    typedef VL53L1XResampler<N> Resampler;
+    // 0.1 ms bins up to 10 s
+    static const uint32_t LatencyBins = 100000;
+
+    std::unique_ptr<Resampler> resampler;
+    typename Resampler::Frame frame;
+    bool seen[N] = {};
+    uint64_t frames = 0;
+    uint64_t skipped = 0;
+    uint64_t modes[Resampler::Stale + 1] = {};
+    std::vector<uint64_t> latency_bins;
+
+    double binPercentile(uint64_t total, double p)
+    {
+      uint64_t target = (uint64_t)(p * total), sum = 0;
+      for (uint32_t b = 0; b < LatencyBins; b++)
+      {
+        sum += latency_bins[b];
+        if (sum > target) { return b / 10.0; }
+      }
+      return LatencyBins / 10.0;
+    }
+};
+
+static Stage * makeResampleStage(const StageSpec & spec)
+{
+  int sensors = param(spec, "sensors", 16);
+  if (sensors <= 8) { return new ResampleStage<8>(spec); }
+  if (sensors <= 16) { return new ResampleStage<16>(spec); }
+  if (sensors <= 32) { return new ResampleStage<32>(spec); }
+  if (sensors <= 64) { return new ResampleStage<64>(spec); }
+  return new ResampleStage<MaxSensors>(spec);
+}
+
+static Stage * makeStage(const StageSpec & spec, const Options & o)
+{
+  if (spec.name == "median") { return new MedianStage(); }
+  if (spec.name == "smooth") { return new SmoothStage(spec); }
+  if (spec.name == "background") { return new BackgroundStage(spec); }
+  if (spec.name == "rules")
+  {
+    if (o.rules.empty()) { fprintf(stderr, "the rules stage needs --rule\n"); exit(2); }
+    return new RulesStage(o.rules);
+  }
+  if (spec.name == "trend") { return new TrendStage(spec); }
+  if (spec.name == "resample") { return makeResampleStage(spec); }
+
+  fprintf(stderr, "unknown stage '%s'\n", spec.name.c_str());
+  exit(2);
+}
+
+// Metrics /////////////////////////////////////////////////////////////////////
+
+// errors of valid samples with an annotated true range
+struct RangeErrors
+{
+  static const uint16_t MaxError = 4096;
+
+  uint64_t annotated = 0;
+  uint64_t valid = 0;
+  double sum = 0, sum_abs = 0, sum_sq = 0;
+  std::vector<uint64_t> abs_errors = std::vector<uint64_t>(MaxError + 1, 0); // by mm, saturating
+
+  void add(const Sample * samples, size_t count)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      const Sample & s = samples[i];
+      if (s.truth_mm == NoTruth) { continue; }
+      annotated++;
+      if (s.range_status != VL53L1X::RangeValid) { continue; }
+      double e = (double)s.range_mm - s.truth_mm;
+      valid++;
+      sum += e;
+      sum_abs += std::fabs(e);
+      sum_sq += e * e;
+      abs_errors[std::min<uint32_t>(std::fabs(e), MaxError)]++;
+    }
+  }
+
+  double percentile(double p) const
+  {
+    uint64_t target = (uint64_t)(p * valid), below = 0;
+    for (uint16_t e = 0; e < MaxError; e++)
+    {
+      below += abs_errors[e];
+      if (below > target) { return e; }
+    }
+    return MaxError;
+  }
+};
+
+struct EventScore
+{
+  uint64_t events = 0;
+  uint64_t detected = 0;
+  uint64_t false_detections = 0;
+  std::vector<double> latency_ms;
+};
+
+static EventScore score(const std::vector<Detection> & detections, Truth & truth, uint64_t tolerance_us)
+{
+  EventScore score;
+  std::vector<uint64_t> by_sensor[MaxSensors];
+  for (const Detection & d : detections) { by_sensor[d.sensor].push_back(d.time_us); }
+
+  for (int s = 0; s < MaxSensors; s++)
+  {
+    const std::vector<uint64_t> & times = by_sensor[s];
+    const std::vector<Interval> & events = truth.events[s];
+    std::vector<bool> matched(times.size(), false);
+
+    for (const Interval & e : events)
+    {
+      score.events++;
+      auto first = std::lower_bound(times.begin(), times.end(), e.start_us);
+      auto last = std::upper_bound(times.begin(), times.end(), e.end_us + tolerance_us);
+      if (first == last) { continue; }
+      score.detected++;
+      score.latency_ms.push_back(msOf(*first - e.start_us));
+      for (auto i = first; i != last; i++) { matched[i - times.begin()] = true; }
+    }
+    for (bool m : matched) { score.false_detections += !m; }
+  }
+  return score;
+}
+
+// Log /////////////////////////////////////////////////////////////////////////
+
+// Decodes a log's Sample frames into samples on the log's timeline: device
+// timestamps are 32-bit micros() values, unwrapped against the previous
+// sample, and counted from the first sample.
+class LogReader
+{
+  public:
+    explicit LogReader(FILE * file) : file(file) {}
+
+    size_t read(Sample * out, size_t max)
+    {
+      size_t count = 0;
+      while (count < max)
+      {
+        if (position == length)
+        {
+          length = fread(buffer, 1, sizeof(buffer), file);
+          position = 0;
+          if (length == 0) { break; }
+        }
+        bytes++;
+        if (!parser.feed(buffer[position++])) { continue; }
+
+        const P::Frame & f = parser.frame();
+        if (f.type != P::Sample || f.length != P::SampleLength || f.target >= MaxSensors)
+        {
+          other_frames++;
+          continue;
+        }
+
+        uint32_t timestamp = P::get32(f.payload);
+        if (samples == 0) { last_timestamp = timestamp; }
+        time_us += (int32_t)(timestamp - last_timestamp);
+        last_timestamp = timestamp;
+        samples++;
+
+        Sample & s = out[count++];
+        s.time_us = time_us > 0 ? time_us : 0;
+        s.sensor = f.target;
+        s.range_mm = P::get16(f.payload + 4);
+        s.signal_fixed = P::get16(f.payload + 6);
+        s.ambient_fixed = P::get16(f.payload + 8);
+        s.range_status = f.payload[10];
+        s.truth_mm = NoTruth;
+      }
+      return count;
+    }
+
+    uint64_t bytes = 0;
+    uint64_t samples = 0;
+    uint64_t other_frames = 0;
+    uint16_t crcErrors() { return parser.crcErrors(); }
+
+  private:
+    FILE * file;
+    VL53L1XFrameParser parser;
+    uint8_t buffer[1 << 16];
+    size_t length = 0, position = 0;
+    uint32_t last_timestamp = 0;
+    int64_t time_us = 0;
+};
+
+// Main ////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char ** argv)
+{
+  Options o = parse(argc, argv);
+
+  Truth truth;
+  if (!o.truth.empty() && !truth.load(o.truth)) { return 1; }
+
+  FILE * file = fopen(o.log.c_str(), "rb");
+  if (file == nullptr) { perror(o.log.c_str()); return 1; }
+  std::unique_ptr<LogReader> reader(new LogReader(file));
+
+  setHostMicros(0);
+  std::vector<std::unique_ptr<Stage>> stages;
+  for (const StageSpec & spec : o.stages) { stages.emplace_back(makeStage(spec, o)); }
+
+  // range errors of the input and after each stage that filters
+  RangeErrors input_errors;
+  std::vector<RangeErrors> stage_errors(stages.size());
+  std::vector<double> stage_ns(stages.size(), 0);
+  double decode_ns = 0;
+  uint64_t last_time_us = 0;
+
+  std::vector<Sample> block(BlockSamples);
+  Clock::time_point wall_start = Clock::now();
+
+  while (true)
+  {
+    Clock::time_point t0 = Clock::now();
+    size_t count = reader->read(block.data(), block.size());
+    decode_ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    if (count == 0) { break; }
+    last_time_us = block[count - 1].time_us;
+
+    if (truth.any_ranges)
+    {
+      for (size_t i = 0; i < count; i++) { block[i].truth_mm = truth.rangeAt(block[i].sensor, block[i].time_us); }
+      input_errors.add(block.data(), count);
+    }
+
+    for (size_t k = 0; k < stages.size(); k++)
+    {
+      Clock::time_point start = Clock::now();
+      stages[k]->process(block.data(), count);
+      stage_ns[k] += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+      if (truth.any_ranges && stages[k]->filters()) { stage_errors[k].add(block.data(), count); }
+    }
+  }
+  fclose(file);
+
+  double wall_s = std::chrono::duration<double>(Clock::now() - wall_start).count();
+  double log_s = last_time_us / 1e6;
+  uint64_t samples = reader->samples;
+  double per = samples > 0 ? 1.0 / samples : 0;
+
+  if (!o.csv)
+  {
+    printf("%s: %llu samples over %.1f s (%llu bytes, %llu other frames, %u CRC errors)\n",
+           o.log.c_str(), (unsigned long long)samples, log_s, (unsigned long long)reader->bytes,
+           (unsigned long long)reader->other_frames, reader->crcErrors());
+    printf("replayed in %.2f s, %.0fx real time\n\n", wall_s, wall_s > 0 ? log_s / wall_s : 0);
+
+    printf("stage          ns/sample  detections\n");
+    printf("%-12s %11.1f\n", "(decode)", decode_ns * per);
+    for (size_t k = 0; k < stages.size(); k++)
+    {
+      printf("%-12s %11.1f", stages[k]->name.c_str(), stage_ns[k] * per);
+      if (stages[k]->detects()) { printf(" %11zu", stages[k]->detections.size()); }
+      printf("\n");
+    }
+    for (auto & stage : stages) { stage->report(stdout); }
+  }
+  else
+  {
+    printf("stage,ns_per_sample,detections,range_mae_mm,range_rmse_mm,range_p95_mm,"
+           "events,detected,false_per_hour,latency_p50_ms,latency_p95_ms\n");
+  }
+
+  auto rangeRow = [&](const char * name, const RangeErrors & e) {
+    double n = e.valid > 0 ? e.valid : 1;
+    printf("%-12s %9llu %8.1f%% %9.1f %9.1f %9.1f %9.1f\n", name, (unsigned long long)e.annotated,
+           e.annotated > 0 ? 100.0 * e.valid / e.annotated : 0.0, e.sum / n, e.sum_abs / n,
+           std::sqrt(e.sum_sq / n), e.percentile(0.95));
+  };
+
+  if (truth.any_ranges && !o.csv)
+  {
+    printf("\nrange accuracy  samples     valid   bias_mm    mae_mm   rmse_mm    p95_mm\n");
+    rangeRow("(input)", input_errors);
+    for (size_t k = 0; k < stages.size(); k++)
+    {
+      if (stages[k]->filters()) { rangeRow(stages[k]->name.c_str(), stage_errors[k]); }
+    }
+  }
+
+  if (truth.any_events && !o.csv)
+  {
+    printf("\nevents        events  detected  false/h  latency_p50_ms  latency_p95_ms  latency_max_ms\n");
+  }
+
+  const RangeErrors * filtered = &input_errors;
+  for (size_t k = 0; k < stages.size(); k++)
+  {
+    Stage & stage = *stages[k];
+    if (stage.filters()) { filtered = &stage_errors[k]; }
+
+    EventScore s;
+    if (truth.any_events && stage.detects()) { s = score(stage.detections, truth, (uint64_t)(o.tolerance_ms * 1000)); }
+    double false_per_hour = log_s > 0 ? s.false_detections * 3600 / log_s : 0;
+
+    if (o.csv)
+    {
+      double n = filtered->valid > 0 ? filtered->valid : 1;
+      printf("%s,%.1f,%zu,%.2f,%.2f,%.1f,%llu,%llu,%.2f,%.1f,%.1f\n", stage.name.c_str(), stage_ns[k] * per,
+             stage.detections.size(), filtered->sum_abs / n, std::sqrt(filtered->sum_sq / n),
+             filtered->percentile(0.95), (unsigned long long)s.events, (unsigned long long)s.detected,
+             false_per_hour, percentile(s.latency_ms, 0.5), percentile(s.latency_ms, 0.95));
+    }
+    else if (truth.any_events && stage.detects())
+    {
+      printf("%-12s %7llu %9llu %8.1f %15.1f %15.1f %15.1f\n", stage.name.c_str(), (unsigned long long)s.events,
+             (unsigned long long)s.detected, false_per_hour, percentile(s.latency_ms, 0.5),
+             percentile(s.latency_ms, 0.95), percentile(s.latency_ms, 1.0));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+// Work-stealing thread pool and strands, for host-side tools.
+//
+// Each worker has its own deque of tasks. Tasks submitted from a worker go on
+// that worker's deque, which it works through newest first (the data they
+// touch is still in its cache); an idle worker first takes tasks submitted
+// from outside the pool, then steals the oldest task from another worker.
+// Workers with nothing to do sleep until something is submitted.
+//
+// A Strand runs the tasks posted to it one at a time, in the order they were
+// posted, on whichever worker is free: it gives per-object ordering (a sensor's
+// samples, a link's bytes) without dedicating a thread to each object.
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool
+{
+  public:
+
+    typedef std::function<void()> Task;
+
+    explicit WorkStealingPool(unsigned threads)
+      : queues(threads), pending(0), active(0), sleeping(0), stopping(false)
+    {
+      for (unsigned i = 0; i < threads; i++)
+      {
+        workers.emplace_back([this, i]() { run(i); });
+      }
+    }
+
+    ~WorkStealingPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+      }
+      sleep_cv.notify_all();
+      for (std::thread & t : workers) { t.join(); }
+    }
+
+    unsigned size() const { return workers.size(); }
+
+    void submit(Task task)
+    {
+      pending++;
+      active++;
+      if (current_pool == this) { queues[current_worker].pushBack(std::move(task)); }
+      else { injector.pushBack(std::move(task)); }
+
+      if (sleeping.load() > 0)
+      {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_cv.notify_one();
+      }
+    }
+
+    // wait until every submitted task, and every task those submitted, has run
+    void wait()
+    {
+      std::unique_lock<std::mutex> lock(idle_mutex);
+      idle_cv.wait(lock, [this]() { return active.load() == 0; });
+    }
+
+  private:
+
+    class Queue
+    {
+      public:
+        void pushBack(Task task)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          tasks.push_back(std::move(task));
+        }
+
+        bool popBack(Task & task)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (tasks.empty()) { return false; }
+          task = std::move(tasks.back());
+          tasks.pop_back();
+          return true;
+        }
+
+        bool popFront(Task & task)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (tasks.empty()) { return false; }
+          task = std::move(tasks.front());
+          tasks.pop_front();
+          return true;
+        }
+
+      private:
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues;
+    Queue injector;
+    std::vector<std::thread> workers;
+
+    std::atomic<int> pending;   // tasks queued and not yet taken
+    std::atomic<int> active;    // tasks queued or running
+    std::atomic<int> sleeping;
+    bool stopping;
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+
+    static thread_local WorkStealingPool * current_pool;
+    static thread_local unsigned current_worker;
+
+    bool take(unsigned self, std::minstd_rand & random, Task & task)
+    {
+      if (queues[self].popBack(task) || injector.popFront(task)) { return true; }
+
+      unsigned n = queues.size();
+      unsigned start = random() % n;
+      for (unsigned k = 0; k < n; k++)
+      {
+        unsigned victim = (start + k) % n;
+        if (victim != self && queues[victim].popFront(task)) { return true; }
+      }
+      return false;
+    }
+
+    void run(unsigned self)
+    {
+      current_pool = this;
+      current_worker = self;
+      std::minstd_rand random(self + 1);
+
+      for (;;)
+      {
+        Task task;
+        if (take(self, random, task))
+        {
+          pending--;
+          task();
+          task = nullptr;
+          if (--active == 0)
+          {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            idle_cv.notify_all();
+          }
+          continue;
+        }
+
+        // sleeping is raised before pending is checked, so a submit() either
+        // is seen here or sees the sleeper and wakes it
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleeping++;
+        sleep_cv.wait(lock, [this]() { return pending.load() > 0 || stopping; });
+        sleeping--;
+        if (stopping && pending.load() == 0) { return; }
+      }
+    }
+};
+
+inline thread_local WorkStealingPool * WorkStealingPool::current_pool = nullptr;
+inline thread_local unsigned WorkStealingPool::current_worker = 0;
+
+class Strand
+{
+  public:
+
+    explicit Strand(WorkStealingPool & pool) : pool(&pool), scheduled(false) {}
+    Strand(const Strand &) = delete;
+    Strand & operator=(const Strand &) = delete;
+
+    void post(WorkStealingPool::Task task)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+      if (!scheduled)
+      {
+        scheduled = true;
+        pool->submit([this]() { drain(); });
+      }
+    }
+
+  private:
+
+    // tasks run per turn before the strand gives its worker up to others
+    static const int Batch = 32;
+
+    WorkStealingPool * pool;
+    std::mutex mutex;
+    std::deque<WorkStealingPool::Task> tasks;
+    bool scheduled;
+
+    void drain()
+    {
+      for (int n = 0; n < Batch; n++)
+      {
+        WorkStealingPool::Task task;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (tasks.empty())
+          {
+            scheduled = false;
+            return;
+          }
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+        task();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (tasks.empty()) { scheduled = false; }
+      else { pool->submit([this]() { drain(); }); }
+    }
+};